@@ -140,48 +140,26 @@ void my_adcReadyCallback(uint16_t raw) {
 }
 #endif
 
-void start_intervalClock(void) {
-    //TA2CTL &= ~(TAIFG); // reset interrupt? might introduce timing related issues (i.e. calling this function while an interrupt is pending)
-    TA2CCTL0 |= (CCIE); // enable interrupt
-    TA2CCR0 += Transmission_Timer_Period; // periodic interrupt
-
-    __bis_SR_register(GIE); // global interrupt enable
-}
-
-void start_timeoutClock(void) {
-    //TA2CTL &= ~(TAIFG); // reset interrupt? might introduce timing related issues (i.e. calling this function while an interrupt is pending)
-    TA2CCTL1 |= (CCIE); // enable interrupt
-    TA2CCR1 += Window_Timer_Period; // periodic interrupt
-
-    __bis_SR_register(GIE); // global interrupt enable
-}
-
-void stop_intervalClock(void) {
-    TA2CCTL0 &= ~(CCIE); // disable interrupt
-}
-
-void stop_timeoutClock(void) {
-    TA2CCTL1 &= ~(CCIE); // disable interrupt
-}
-
-void init_clocks(void) {
-    // better safe than...
-    stop_intervalClock();
-    stop_timeoutClock();
-
-    // ACLK(=REFO), upmode, clear TAR
-    TA2CTL = (TASSEL__ACLK | MC__CONTINUOUS | TACLR);
-}
+Timer_alarm_t intervalAlarm;
+Timer_alarm_t timeoutAlarm;
 
 volatile uint16_t go = 0; // use counter instead of on/off to detect overrun/overflow
 
-#pragma vector=TIMER2_A0_VECTOR // Interval
-__interrupt
-void INT_Timer2A0(void) {
-    static uint8_t rand_idx = 0;
-
-    TA2CCR0 += Transmission_Timer_Period;
+#if UseBLE && UseUART
+/**
+ * UART ISR callback, the BLE message is on the line
+ */
+void bleSentCallback(void) {
+    BITCLR(P3OUT, PIN_AUX1); // RTS
+}
+#endif // UseBLE && UseUART
 
+/**
+ * Interval alarm, runs from Timer_dispatch() in the main loop every
+ *  Transmission_Timer_Period. It waits for CTS and for the previous UART
+ *  transfer, which must not happen inside the timer ISR.
+ */
+void intervalCallback(void) {
 #if UseSENSOR
     sensor += 1; // next tick for improvised sensor
 #endif // UseSENSOR
@@ -236,12 +214,13 @@ void INT_Timer2A0(void) {
 #endif // UseACK
 
 #if UseBLE && UseUART
+    // Static, the DMA reads it after this callback has returned
 #if UseSENSOR && UseADC
-    uint8_t m[] = "00000";
+    static uint8_t m[] = "00000";
 #elif UseSENSOR || UseADC
-    uint8_t m[] = "000";
+    static uint8_t m[] = "000";
 #else
-    uint8_t m[] = "0";
+    static uint8_t m[] = "0";
 #endif
     uint8_t m_idx = 0;
 #endif // UseBLE && UseUART
@@ -267,15 +246,11 @@ void INT_Timer2A0(void) {
 
 #if UseBACKOFF
         if (n_skip == 0) {
-            // Pick number from static random number table
-            uint8_t rand = *((uint8_t*) (INFO_WISP_RAND_TBL + rand_idx));
+            uint8_t rand = (uint8_t) RAND_next16();
             rand = (rand & 0x3) + (rand & 0x31);
             rand = rand % Backoff_Maximum_Period;
 
             n_skip = rand;
-
-            rand_idx =
-                    (++rand_idx < (NUM_RN16_2_STORE << 1)) ?: 0;
         }
 #endif // UseBACKOFF
 
@@ -308,37 +283,22 @@ void INT_Timer2A0(void) {
         while (!(P3IN & PIN_AUX2))
             ; // CTS
 
-        UART_critSend(m, sizeof(m));
-
-        BITCLR(P3OUT, PIN_AUX1);
+        UART_dmaSend(m, sizeof(m), &bleSentCallback); // releases RTS
     }
 
 #endif // UseBLE && UseUART
 
 #endif // UseBLE || UseBACKOFF
 
-    go = 1;
-
-    LPM4_EXIT;
+    go = 1; // the main loop's wait ends after this alarm
 }
 
 #if 0
-#pragma vector=TIMER2_A1_VECTOR // Timeout
-__interrupt
-void INT_Timer2A1(void) {
-    switch (__even_in_range(TA2IV, TA2IV_TAIFG)) {
-        case TA2IV_NONE:
-        break;
-        case TA2IV_TACCR1:
-        // Wakeup Timeout Interrupt
-        TA2CCR1 += Window_Timer_Period;
-
-        shiftWindow();
-
-        break;
-        case TA2IV_TAIFG:
-        break;
-    }
+/**
+ * Timeout alarm, runs from the timer ISR every Window_Timer_Period
+ */
+void timeoutCallback(void) {
+    shiftWindow();
 }
 #endif
 
@@ -410,8 +370,30 @@ void main(void) {
     BITCLR(P3OUT, PIN_AUX2);//     -- low
 #endif // UseBLE && UseGPIO
 
-    init_clocks();
-    start_intervalClock();
+    Timer_initAlarm(&intervalAlarm, &intervalCallback, TIMER_ALARM_DEFERRED);
+    Timer_startAlarm(&intervalAlarm, Transmission_Timer_Period,
+            Transmission_Timer_Period);
+
+#if 0
+    Timer_initAlarm(&timeoutAlarm, &timeoutCallback, TIMER_ALARM_ISR);
+    Timer_startAlarm(&timeoutAlarm, Window_Timer_Period, Window_Timer_Period);
+#endif
+
+    // Keep link statistics and sensor state across power failures
+    CKPT_addRegion((void*) ackwindow, sizeof(ackwindow));
+    CKPT_addRegion((void*) rnwindow, sizeof(rnwindow));
+    CKPT_addRegion((void*) &window_index, sizeof(window_index));
+    CKPT_addRegion((void*) &n_skip, sizeof(n_skip));
+    CKPT_addRegion((void*) &use_wisp, sizeof(use_wisp));
+#if UseSENSOR
+    CKPT_addRegion((void*) &sensor, sizeof(sensor));
+#endif // UseSENSOR
+#if UseADC
+    CKPT_addRegion((void*) &temperature, sizeof(temperature));
+#endif // UseADC
+
+    // Everything is set up; continue from the last checkpoint, if any
+    CKPT_restore();
 
     int i = 0;
 
@@ -435,15 +417,20 @@ void main(void) {
             while (ADC_isBusy())
                 ; // let ADC finish
 
-            TA2CCTL0 |= (CCIE); // enable interrupt
-            __bis_SR_register(GIE); // global interrupt enable
+#if UseBLE && UseUART
+            UART_waitForTx(); // SMCLK is gated off below
+#endif // UseBLE && UseUART
 
             CSCTL6 &= ~(MODCLKREQEN + SMCLKREQEN + MCLKREQEN);
-            LPM4; // LPM3 ?
+            Timer_waitForEvent();
             CSCTL6 |= (MODCLKREQEN + SMCLKREQEN + MCLKREQEN);
+
+            Timer_dispatch(); // runs intervalCallback()
         }
         go = 0;
 
+        CKPT_checkpoint(); // once per transmission period
+
         // enable WISP
         //if (((i++) % (1 + n_skip)) == 0) {
         if (0 == n_skip) {
@@ -1,8 +1,9 @@
 /**
  * @file main.c
  *
- * An example of a WISP application. Takes an accelerometer measurement and
- * modulates EPC to transfer the measurement in response to a reader ACK.
+ * An example of a WISP application. Streams accelerometer samples through the
+ * ADXL362 FIFO and modulates EPC to transfer the newest one in response to a
+ * reader ACK.
  *
  * @author	Aaron Parks, UW Sensor Systems Lab
  *
@@ -15,6 +16,11 @@
 WISP_dataStructInterface_t wispData;
 threeAxis_t_8 accelOut;
 
+#define ACCEL_SAMPLES	32		// Power of two
+#define ACCEL_WATERMARK	10		// XYZ sets per FIFO burst, 100ms at 100Hz
+threeAxis_t_12 accelSamples[ACCEL_SAMPLES];	// Filled by the FIFO bursts
+threeAxis_t_12 accelLatest;
+
 uint8_t counter = 5;
 
 /**
@@ -50,6 +56,33 @@ void my_blockWriteCallback  (void) {
 
 
 
+/**
+ * Accelerometer bring-up. Deferred until the reader has seen our EPC once, so
+ *  it doesn't delay the first reply after power-up. Runs inside WISP_doRFID()
+ *  (here: on its return after the ACK abort), so no sleeping; the main loop
+ *  polls for the first sample.
+ */
+void my_deferredInit (void) {
+	// Accelerometer power up sequence
+	BITSET(PDIR_ACCEL_EN , PIN_ACCEL_EN);
+	BITCLR(POUT_ACCEL_EN , PIN_ACCEL_EN);
+	__delay_cycles(100);
+	BITSET(POUT_ACCEL_EN , PIN_ACCEL_EN);
+
+	BITSET(P2SEL1 , PIN_ACCEL_SCLK | PIN_ACCEL_MISO | PIN_ACCEL_MOSI);
+	BITCLR(P2SEL0 , PIN_ACCEL_SCLK | PIN_ACCEL_MISO | PIN_ACCEL_MOSI);
+	__delay_cycles(5);
+	SPI_initialize();
+	__delay_cycles(5);
+//	ACCEL_reset();
+//	__delay_cycles(50);
+	ACCEL_range();
+	__delay_cycles(5);
+	ACCEL_startStream(accelSamples, ACCEL_SAMPLES, ACCEL_WATERMARK);
+}
+
+
+
 /** @fcn        void main(void)
  *  @brief      This implements the user application and should never return
  *
@@ -59,20 +92,8 @@ void my_blockWriteCallback  (void) {
 void main(void) {
 
 	WISP_init();
-	BITSET(PDIR_ACCEL_EN , PIN_ACCEL_EN);
-	// Accelerometer power up sequence
-	BITCLR(POUT_ACCEL_EN , PIN_ACCEL_EN);
-    CSCTL0_H = 0xA5;
-    CSCTL1 = DCOFSEL_0; //1MHz
-    CSCTL2 = SELA__VLOCLK + SELS_3 + SELM_3;
-    CSCTL3 = DIVA_0 + DIVS_0 + DIVM_0;
-	BITCLR(CSCTL6 , (MODCLKREQEN|SMCLKREQEN|MCLKREQEN));
-	BITSET(CSCTL6 , ACLKREQEN);
-
-
-	__delay_cycles(100);
-
-	BITSET(POUT_ACCEL_EN , PIN_ACCEL_EN);
+	BITCLR(CSCTL6 , MODCLKREQEN);
+	BITSET(CSCTL6 , (ACLKREQEN|SMCLKREQEN|MCLKREQEN)); // FIFO bursts run while the CPU sleeps
 
     // Register callback functions with WISP base routines
     WISP_registerCallback_ACK(&my_ackCallback);
@@ -90,24 +111,15 @@ void main(void) {
     // Set abort conditions: Exits WISP_doRFID() when the following events happen:
     WISP_setAbortConditions(CMD_ID_READ | CMD_ID_WRITE | CMD_ID_ACK);
 
+    // Bring up the accelerometer after the first inventory round
+    WISP_deferInit(&my_deferredInit);
+
 	accelOut.x = 1;
 	accelOut.y = 1;
 	accelOut.z = 1;
-	BITSET(P2SEL1 , PIN_ACCEL_SCLK | PIN_ACCEL_MISO | PIN_ACCEL_MOSI);
-	BITCLR(P2SEL0 , PIN_ACCEL_SCLK | PIN_ACCEL_MISO | PIN_ACCEL_MOSI);
-	__delay_cycles(5);
-	SPI_initialize();
-	__delay_cycles(5);
-//	ACCEL_reset();
-//	__delay_cycles(50);
-	ACCEL_range();
-	__delay_cycles(5);
-	ACCEL_initialize();
-	__delay_cycles(5);
 
-	__delay_cycles(5);
-
-    // Set up EPC, copy in sensor data
+    // Set up EPC. The sensor fields keep the last reading from before the
+    //  reset (WISP_saveEPC() below) until a new sample is in.
 	wispData.epcBuf[0] = 0x0B; // Tag type: Accelerometer
 //	wispData.epcBuf[1] = 0;			// Y value MSB
 //	wispData.epcBuf[2] = ((uint8_t)accelOut.y);// Y value LSB
@@ -121,54 +133,31 @@ void main(void) {
 	wispData.epcBuf[10] = *((uint8_t*)INFO_WISP_TAGID+1); // WISP ID MSB: Pull from INFO seg
 	wispData.epcBuf[11] = *((uint8_t*)INFO_WISP_TAGID); // WISP ID LSB: Pull from INFO seg
 
-	ACCEL_singleSample(&accelOut);
-
-    BITSET(TA2CCTL0 , CCIE);
-    TA2CCR0 = 1000;
-    BITSET(TA2CTL , (TASSEL_1 | MC_1 | TACLR));
-    __bis_SR_register(LPM4_bits | GIE);       // Enter LPM4 w/ interrupt
-	__delay_cycles(1);
-    BITCLR(TA2CCTL0 , CCIE);
-    BITCLR(TA2CCR0 , 1000);
-    BITCLR(TA2CTL , (TASSEL_1 | MC_1 | TACLR));
-	ACCEL_readStat(&accelOut);
-	while((((uint8_t)accelOut.x) & 193) != 0x41){
-		ACCEL_readStat(&accelOut);
-		__delay_cycles(10);
-	}
-
-//	ACCEL_singleSample(&accelOut);
-	__delay_cycles(10);
-	ACCEL_singleSample(&accelOut);
-	wispData.epcBuf[1] = 0;			// Y value MSB
-	wispData.epcBuf[2] = (accelOut.y+128);// Y value LSB
-	wispData.epcBuf[3] = 0;			// X value MSB
-	wispData.epcBuf[4] = (accelOut.x+128);// X value LSB
-	wispData.epcBuf[5] = 0;			// Z value MSB
-	wispData.epcBuf[6] = (accelOut.z+128);// Z value LSB
-
     while (FOREVER) {
-    	
+    	
 		WISP_doRFID();
 
         CSCTL0_H = 0xA5;
         CSCTL1 = DCOFSEL_0; //1MHz
         CSCTL2 = SELA__VLOCLK + SELS_3 + SELM_3;
         CSCTL3 = DIVA_0 + DIVS_0 + DIVM_0;
-    	BITCLR(CSCTL6 , (MODCLKREQEN|SMCLKREQEN|MCLKREQEN));
-    	BITSET(CSCTL6 , ACLKREQEN);
-
-		ACCEL_readStat(&accelOut);
-		if((((uint8_t)accelOut.x) & 193) == 0x41){
-			__delay_cycles(20);
-			ACCEL_singleSample(&accelOut);
+    	BITCLR(CSCTL6 , MODCLKREQEN);
+    	BITSET(CSCTL6 , (ACLKREQEN|SMCLKREQEN|MCLKREQEN));
+
+		// Report the newest streamed sample, as 8 MSBs like the XDATA registers
+		if(ACCEL_getSample(&accelLatest)){
+			while(ACCEL_getSample(&accelLatest));
+			accelOut.x = (int8_t)(accelLatest.x >> 4);
+			accelOut.y = (int8_t)(accelLatest.y >> 4);
+			accelOut.z = (int8_t)(accelLatest.z >> 4);
 			wispData.epcBuf[1] = 0;			// Y value MSB
 			wispData.epcBuf[2] = (accelOut.y+128);// Y value LSB
 			wispData.epcBuf[3] = 0;			// X value MSB
 			wispData.epcBuf[4] = (accelOut.x+128);// X value LSB
 			wispData.epcBuf[5] = 0;			// Z value MSB
 			wispData.epcBuf[6] = (accelOut.z+128);// Z value LSB
-			
+			WISP_saveEPC();		// Answer with this reading right after the next reset
+			
 			if( (int8_t)accelOut.z > 0 ) {
 		    	BITCLR(PLED1OUT, PIN_LED1);
 		    	BITSET(PLED2OUT, PIN_LED2);
@@ -178,20 +167,6 @@ void main(void) {
 			}
 		}
 
-		BITSET(TA2CCTL0 , CCIE);
-	    TA2CCR0 = 20;
-	    BITSET(TA2CTL , (TASSEL_1 | MC_1 | TACLR));
-	    __bis_SR_register(LPM4_bits | GIE);       // Enter LPM4 w/ interrupt
-		__delay_cycles(1);
-	    BITCLR(TA2CCTL0 , CCIE);
-	    BITCLR(TA2CTL , (TASSEL_1 | MC_1 | TACLR));
+		Timer_LooseDelay(20);
    }
 }
-
-// Timer A2 interrupt service routine
-#pragma vector = TIMER2_A0_VECTOR
-__interrupt void Timer2_A0_ISR(void)
-{
-	BITCLR(TA2CTL , TAIFG);
-	__bic_SR_register_on_exit(LPM4_bits|GIE);
-}
@@ -58,10 +58,10 @@ void main (void) {
   FRAM_init();
 
   // Use first word of RN16 table as unique ID ('cause why not?)
-  FRAM_write((uint16_t*)(INFO_WISP_TAGID), RN16Vals[0]);
+  FRAM_write((void*)(INFO_WISP_TAGID), &RN16Vals[0], sizeof(uint16_t));
 
   // Store UUID and RN16 table to memory
-  FRAM_write_int_array((uint16_t*)(INFO_WISP_RAND_TBL), NUM_RN16_2_STORE, RN16Vals);
+  FRAM_write((void*)(INFO_WISP_RAND_TBL), RN16Vals, NUM_RN16_2_STORE * sizeof(uint16_t));
 
   // Blink slow when done.
   while(FOREVER) {
@@ -56,74 +56,32 @@ void my_blockWriteCallback(void) {
     asm(" NOP");
 }
 
-void start_blinkClock(void) {
-    //TA2CTL &= ~(TAIFG); // reset interrupt? might introduce timing related issues (i.e. calling this function while an interrupt is pending)
-    TA2CCTL0 |= (CCIE); // enable interrupt
-    TA2CCR0 += Blink_Timer_Period; // periodic interrupt
-
-    __bis_SR_register(GIE); // global interrupt enable
-}
-
-void start_pwmClock(void) {
-    //TA2CTL &= ~(TAIFG); // reset interrupt? might introduce timing related issues (i.e. calling this function while an interrupt is pending)
-    TA2CCTL1 |= (CCIE); // enable interrupt
-    TA2CCR1 += PWM_Timer_Period; // periodic interrupt
-
-    __bis_SR_register(GIE); // global interrupt enable
-}
-
-void stop_blinkClock(void) {
-    TA2CCTL0 &= ~(CCIE); // disable interrupt
-}
-
-void stop_pwmClock(void) {
-    TA2CCTL1 &= ~(CCIE); // disable interrupt
-}
-
-void init_clocks(void) {
-    // better safe than...
-    stop_blinkClock();
-    stop_pwmClock();
-
-    // ACLK(=REFO), upmode, clear TAR
-    TA2CTL = (TASSEL__ACLK | MC__CONTINUOUS | TACLR);
-}
+Timer_alarm_t blinkAlarm;
+Timer_alarm_t pwmAlarm;
 
 volatile uint8_t led_on = 0;
 
-#pragma vector=TIMER2_A0_VECTOR // Interval
-__interrupt
-void INT_Timer2A0(void) {
-    TA2CCR0 += Blink_Timer_Period;
-
+/**
+ * Blink alarm, runs from the timer ISR every Blink_Timer_Period
+ */
+void blinkCallback(void) {
     led_on ^= 0x1;
 }
 
-#pragma vector=TIMER2_A1_VECTOR // Timeout
-__interrupt
-void INT_Timer2A1(void) {
-    switch (__even_in_range(TA2IV, TA2IV_TAIFG)) {
-    case TA2IV_NONE:
-        break;
-    case TA2IV_TACCR1:
-        // Wakeup Timeout Interrupt
-        TA2CCR1 += PWM_Timer_Period;
-
-        static int i = 0;
-
-        if (led_on)
-            if( i++>3 ) {
-                BITSET(PLED1OUT, PIN_LED1);
-                i=0;
-            } else
-                BITCLR(PLED1OUT, PIN_LED1);
-        else {
+/**
+ * PWM alarm, runs from the timer ISR every PWM_Timer_Period
+ */
+void pwmCallback(void) {
+    static int i = 0;
+
+    if (led_on)
+        if( i++>3 ) {
+            BITSET(PLED1OUT, PIN_LED1);
+            i=0;
+        } else
             BITCLR(PLED1OUT, PIN_LED1);
-        }
-
-        break;
-    case TA2IV_TAIFG:
-        break;
+    else {
+        BITCLR(PLED1OUT, PIN_LED1);
     }
 }
 
@@ -171,16 +129,13 @@ void main(void) {
 
     UART_init();
 
-    init_clocks();
-    start_blinkClock();
-    start_pwmClock();
+    Timer_initAlarm(&blinkAlarm, &blinkCallback, TIMER_ALARM_ISR);
+    Timer_initAlarm(&pwmAlarm, &pwmCallback, TIMER_ALARM_ISR);
+    Timer_startAlarm(&blinkAlarm, Blink_Timer_Period, Blink_Timer_Period);
+    Timer_startAlarm(&pwmAlarm, PWM_Timer_Period, PWM_Timer_Period);
 
     // Talk to the RFID reader.
     while (FOREVER) {
-        TA2CCTL0 |= (CCIE); // enable interrupt
-        TA2CCTL1 |= (CCIE); // enable interrupt
-        __bis_SR_register(GIE); // global interrupt enable
-
-        LPM4; // LPM3 ?
+        Timer_waitForEvent();
     }
 }
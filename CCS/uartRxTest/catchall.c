@@ -22,16 +22,16 @@
 #pragma vector=TIMER3_A1_VECTOR       // ".int34" 0xFFD4 Timer3_A2 CC1, TA
 #pragma vector=TIMER3_A0_VECTOR       // ".int35" 0xFFD6 Timer3_A2 CC0
 //#pragma vector=PORT2_VECTOR           // ".int36" 0xFFD8 Port 2
-#pragma vector=TIMER2_A1_VECTOR       // ".int37" 0xFFDA Timer2_A2 CC1, TA
+//#pragma vector=TIMER2_A1_VECTOR       // ".int37" 0xFFDA Timer2_A2 CC1, TA
 //#pragma vector=TIMER2_A0_VECTOR       // ".int38" 0xFFDC Timer2_A2 CC0
 #pragma vector=PORT1_VECTOR           // ".int39" 0xFFDE Port 1
 #pragma vector=TIMER1_A1_VECTOR       // ".int40" 0xFFE0 Timer1_A3 CC1-2, TA
 //#pragma vector=TIMER1_A0_VECTOR       // ".int41" 0xFFE2 Timer1_A3 CC0
-#pragma vector=DMA_VECTOR             // ".int42" 0xFFE4 DMA
+//#pragma vector=DMA_VECTOR             // ".int42" 0xFFE4 DMA
 #pragma vector=USCI_A1_VECTOR         // ".int43" 0xFFE6 USCI A1 Receive/Transmit
 //#pragma vector=TIMER0_A1_VECTOR       // ".int44" 0xFFE8 Timer0_A3 CC1-2, TA
 //#pragma vector=TIMER0_A0_VECTOR       // ".int45" 0xFFEA Timer0_A3 CC0
-#pragma vector=ADC12_VECTOR           // ".int46" 0xFFEC ADC
+//#pragma vector=ADC12_VECTOR           // ".int46" 0xFFEC ADC
 #pragma vector=USCI_B0_VECTOR         // ".int47" 0xFFEE USCI B0 Receive/Transmit
 //#pragma vector=USCI_A0_VECTOR         // ".int48" 0xFFF0 USCI A0 Receive/Transmit
 #pragma vector=WDT_VECTOR             // ".int49" 0xFFF2 Watchdog Timer
@@ -287,6 +287,7 @@ V1_Send_EoS_Byte:
 
     BIC.B	#0x81, &PTXOUT			;[] Clear 2.0 & 2.7 (1.0 is for old 4.1 HW, 2.7 is for current hack...) eventually just 1.0
     ;* End of 16 free cycles. Also note we only put these here to save 3 friggin cycles which prolly won't make a darn difference...*/
+    MOV.B	#TRUE, &(rfid.replied)	;[4] the reader follows up on this reply within T2
     RETA
 
 ; trampoline to avoid a very long jump to V2_Send_Pilot_Tones
@@ -502,6 +503,7 @@ V0_Send_EoS_Byte:
 
     BIC.B	#0x81, &PTXOUT			;[] Clear 1.0 & 1.7 (1.0 is for old 4.1 HW, 1.7 is for current hack...) eventually just 1.0
     ;* End of 16 free cycles. Also note we only put these here to save 3 friggin cycles which prolly won't make a darn difference...*/
+    MOV.B	#TRUE, &(rfid.replied)	;[4] the reader follows up on this reply within T2
     RETA
 
 
@@ -617,6 +619,7 @@ V2_Send_EoS_Byte:
 
     BIC.B	#0x81, &PTXOUT			;[] Clear 1.0 & 1.7 (1.0 is for old 4.1 HW, 1.7 is for current hack...) eventually just 1.0
     ;* End of 16 free cycles. Also note we only put these here to save 3 friggin cycles which prolly won't make a darn difference...*/
+    MOV.B	#TRUE, &(rfid.replied)	;[4] the reader follows up on this reply within T2
     RETA
     
     .end ;* End of ASM */
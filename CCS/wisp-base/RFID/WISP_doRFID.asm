@@ -19,7 +19,8 @@
     .cdecls C,LIST, "../Math/crc16.h"
     .cdecls C,LIST, "rfid.h"
 	.def  WISP_doRFID
-	.global handleAck, handleQR, handleReqRN, handleRead, handleWrite, handleSelect, WISP_doRFID, TxClock, RxClock
+	.global handleAck, handleQR, handleReqRN, handleRead, handleWrite, handleSelect, handleCustom, WISP_doRFID, TxClock, RxClock
+	.global RAND_refill, RFID_swapEPC, RFID_serviceEPCQueue
 
 ;/PRESERVED REGISTERS-----------------------------------------------------------------------------------------------------------------
 R_bitCt			.set  R6
@@ -33,47 +34,26 @@ R_scratch0  	.set  R15
 
 
 WISP_doRFID:
-;/************************************************************************************************************************************
-;/								PREP THE DATABUF W/STOREDPC AND A CRC16 (225 cycles, 55us)                                     		 *
-;/************************************************************************************************************************************
-	;Load the Stored Protocol Control (PC) values
-	MOV.B	&(rfid.epcSize),R14		;[3]
-	AND.B	#(0x001F), R14			;[2]
-	RLAM	#(3), R14				;[3]
-	OR.B	#(STORED_PC1), R14		;[2]
-	MOV.B	R14, &(dataBuf)			;[3]
-
-	MOV.B		#(STORED_PC0), &(dataBuf+1)	;[5]
-
-	;Data was already loaded by user into B2..B13, so we don't need to load it.
-	;[0]! cool...
+	TST.B	(rfid.epcBuffered)		;[] EPC from WISP_commitEPC()? Its StoredPC and CRC16 are built already
+	JNZ		entrySwapEPC			;[]
+	CALLA	#prepDataBuf			;[5+225] load the StoredPC and CRC16 around the EPC
+	MOV.B	#FALSE, &(rfid.epcDirty);[] anything staged before entry is now in dataBuf
 
-	;Calc CRC16! (careful, it will clobber R11-R15)
-	;uint16_t crc16_ccitt(uint16_t preload,uint8_t *dataPtr, uint16_t numBytes);
-	MOV		#(dataBuf),		R13		;[2] load &dataBuf[0] as dataPtr
-	MOV		&(rfid.epcSize),R14		;[3]
-	ADD		R14, R14				;[1]
-	ADD		#(DATABUFF_MIN_SIZE), R14 ;[2]
-	SUB		#(2), R14				; [2]
+entrySwapEPC:
+	TST.B	(rfid.epcQueued)		;[] EPC queue on? Stage its next EPC before the first command
+	JZ		entryCheckSwap			;[]
+	CALLA	#RFID_serviceEPCQueue	;[] Can mangle R12-R15
 
-	MOV 	#CRC_NO_PRELOAD, R12 	;[1] don't use a preload!
-
-	CALLA	#crc16_ccitt			;[5+196]
-	;onReturn: R12 holds the CRC16 value.
-
-	;STORE CRC16
-	MOV		&(rfid.epcSize),R14		;[3]
-	ADD		R14, R14				;[1]
-	ADD		#(DATABUFF_MIN_SIZE), R14 ;[2]
-	ADD		#(dataBuf), R14			;[2]
-
-	MOV.B	R12,	-1(R14)			;[3]
-	SWPB	R12						;[1] move upper byte into lower byte
-	MOV.B	R12,	-2(R14)			;[3]
+entryCheckSwap:
+	TST.B	(rfid.epcSwap)			;[] committed EPC waiting?
+	JZ		entryEPCDone			;[]
+	CALLA	#RFID_swapEPC			;[] Can mangle R12-R15
 
+entryEPCDone:
 
 	;Initial Config of RFID Transaction
 	MOV.B	#FALSE, &(rfid.abortFlag);[] Initialize abort flag
+	MOV.B	#FALSE, &(rfid.replied)	;[] nothing sent yet
 	;BIS.B	#(PIN_RX_EN), &PRXEOUT	;[] enable the receive comparator for a new round
 
 keepDoingRFID:
@@ -191,6 +171,8 @@ decodeCmd_lvl2_11:
 	JEQ		callWriteHandler	;[]
 	CMP.B	#0xC7,	R_scratch0	;[] is it BlockWrite?
 	JEQ		callBlockWriteHandler;[]
+	CMP.B	#CUSTOM_OPCODE,	R_scratch0	;[] is it our custom command?
+	JEQ		callCustomHandler	;[]
 	JMP		endDoRFID 			;[] come back and handle after query is working.
 
 
@@ -219,6 +201,7 @@ decodeCmd_lvl2_10:
 
 callSelectHandler:
 	CALLA	#handleSelect
+	MOV.B	#TRUE, &(rfid.replied)	;[] no reply, but the Query follows within T4: no idle work either
 	JMP		endDoRFID
 
 callQueryHandler:
@@ -238,9 +221,7 @@ callAckHandler:
 	JMP		endDoRFID
 
 callNAKHandler:
-	NOP
-	NOP
-	NOP
+	MOV.B	#FALSE, &(rfid.epcAckPending) ;[] reader did not get the EPC, it has to be sent again
 	JMP		endDoRFID
 
 callReqRNHandler:
@@ -265,6 +246,12 @@ callBlockWriteHandler:
 	CALLA	#handleBlockWrite
 	JMP		WISP_doRFID
 
+callCustomHandler:
+	BIT.B	#MODE_CUSTOM, &(rfid.mode)
+	JNC		endDoRFID
+	CALLA	#handleCustom
+	JMP		endDoRFID
+
 
 ;/************************************************************************************************************************************/
 ;/										DECIDE IF STAYING IN RFID LOOP		                                                         *
@@ -276,10 +263,84 @@ endDoRFID:
 	MOV	#0, TA1CCTL0;
 	MOV #0, TA1CTL;
 
-	TST.B	(rfid.abortFlag)
+	;Fresh RN16 for the next Query/QA/ReqRN, before anything else can send one
+	CALLA	#RAND_refill			;[5+~30] Can mangle R12-R15
+
+	;A queued EPC was ACKed. Only once the reader moved on (anything but another ACK, i.e. the EPC reply was not lost),
+	;the next one may go live.
+	TST.B	(rfid.epcAckPending)	;[]
+	JZ		ackConfirmDone			;[]
+	MOV.B	(cmd), R_scratch0		;[] the command which was just handled, or the ACK itself after a timeout
+	AND.B	#0xC0, R_scratch0		;[]
+	CMP.B	#0x40, R_scratch0		;[] still an ACK?
+	JEQ		ackConfirmDone			;[]
+	MOV.B	#FALSE, &(rfid.epcAckPending) ;[]
+	TST.B	(rfid.epcStaged)		;[]
+	JZ		ackConfirmLast			;[]
+	MOV.B	#FALSE, &(rfid.epcStaged) ;[]
+	MOV.B	#TRUE, &(rfid.epcSwap)	;[]
+	JMP		ackConfirmDone			;[]
+ackConfirmLast:
+	MOV.B	#TRUE, &(rfid.epcAcked)	;[] nothing staged; RFID_serviceEPCQueue() reports the queue as drained
+ackConfirmDone:
+	;Committed EPC goes live here, never in the middle of a reply
+	TST.B	(rfid.epcSwap)			;[]
+	JZ		swapDone				;[]
+	CALLA	#RFID_swapEPC			;[] Can mangle R12-R15
+
+swapDone:
+	;After a reply the reader's next command (ACK after an RN16, QueryRep/ReqRN after an EPC, ...) is due within T2.
+	;Idle work would make us miss it, so it only runs when the last command went unanswered or the receive timed out.
+	TST.B	(rfid.replied)			;[]
+	MOV.B	#FALSE, &(rfid.replied)	;[] (MOV leaves the flags alone)
+	JNZ		idleDone				;[] abortFlag is still honoured there
+
+	;Stage the next queued EPC for the following ACK, now that no command is due.
+	TST.B	(rfid.epcQueued)		;[]
+	JZ		idleWork				;[]
+	CALLA	#RFID_serviceEPCQueue	;[] Can mangle R12-R15
+	TST.B	(rfid.epcSwap)			;[] nothing was waiting for an ACK, so it goes live right away
+	JZ		idleWork				;[]
+	CALLA	#RFID_swapEPC			;[] Can mangle R12-R15
+
+idleWork:
+	CALLA	#bootWork				;[] Can mangle R12-R15
+	;RX_SM is halted between commands, so this is the one place C code may run without leaving the RFID loop.
+	CMP		#(0), &(RWData.idleHook) ;[] Call idle hook if it's configured (if it's non-NULL)
+	JEQ		idleDone				;[] (the drained callback may have asked us to return)
+	MOV		&(RWData.idleHook), R_scratch0 ;[]
+	CALLA	R_scratch0				;[] Can mangle R12-R15
+
+	;Idle work may have changed the EPC. Rebuild StoredPC/CRC16 before anyone can ACK us again.
+	TST.B	(rfid.epcDirty)			;[]
+	JZ		idleDone				;[]
+	MOV.B	#FALSE, &(rfid.epcDirty);[]
+	CALLA	#prepDataBuf			;[5+225]
+
+idleDone:
+	TST.B	(rfid.abortFlag)		;[] idle work can ask us to return, too
 	JZ		keepDoingRFID
 	;JZ		WISP_doRFID
+exitDoRFID:
 	MOV		#(0), &(TA0CCTL0)
+	CALLA	#bootWork				;[] we are leaving, so no command is due either
+	RETA
+
+;/************************************************************************************************************************************
+;/								DEFERRED INIT (WISP_deferInit())						                                     		 *
+;/																																	 *
+;/ Calls RWData.bootHook once, after the first ACK reply went out (rfid.ackCount). Only called where no reader command is due: from	 *
+;/ the idle path and on exit. Clobbers R12-R15.																						 *
+;/************************************************************************************************************************************
+bootWork:
+	TST		&(rfid.ackCount)		;[] reader hasn't seen our EPC yet
+	JZ		bootWorkDone			;[]
+	CMP		#(0), &(RWData.bootHook) ;[]
+	JEQ		bootWorkDone			;[]
+	MOV		&(RWData.bootHook), R_scratch0 ;[]
+	MOV		#(0), &(RWData.bootHook);[] one-shot
+	CALLA	R_scratch0				;[] Can mangle R12-R15
+bootWorkDone:
 	RETA
 
 tagNotSelected:
@@ -287,4 +348,49 @@ tagNotSelected:
 	CLR		&TA0CTL
 	RETA
 
+;/************************************************************************************************************************************
+;/								PREP THE DATABUF W/STOREDPC AND A CRC16 (230 cycles, 57us)                                     		 *
+;/																																	 *
+;/ Called on entry, and again from the idle path whenever rfid.epcDirty was set. Works on the front EPC buffer (RWData.EPCBankPtr:	 *
+;/ dataBuf, or dataBufAlt once WISP_commitEPC() swapped it in). Clobbers R11-R15.													 *
+;/************************************************************************************************************************************
+prepDataBuf:
+	MOV		&(RWData.EPCBankPtr), R13 ;[3] the buffer which is being sent
+
+	;Load the Stored Protocol Control (PC) values
+	MOV.B	&(rfid.epcSize),R14		;[3]
+	AND.B	#(0x001F), R14			;[2]
+	RLAM	#(3), R14				;[3]
+	OR.B	#(STORED_PC1), R14		;[2]
+	MOV.B	R14, 0(R13)				;[4]
+
+	MOV.B		#(STORED_PC0), 1(R13)	;[5]
+
+	;Data was already loaded by user into B2..B13, so we don't need to load it.
+	;[0]! cool...
+
+	;Calc CRC16! (careful, it will clobber R11-R15)
+	;uint16_t crc16_ccitt(uint16_t preload,uint8_t *dataPtr, uint16_t numBytes);
+	;R13 already holds the buffer as dataPtr
+	MOV		&(rfid.epcSize),R14		;[3]
+	ADD		R14, R14				;[1]
+	ADD		#(DATABUFF_MIN_SIZE), R14 ;[2]
+	SUB		#(2), R14				; [2]
+
+	MOV 	#CRC_NO_PRELOAD, R12 	;[1] don't use a preload!
+
+	CALLA	#crc16_ccitt			;[5+196]
+	;onReturn: R12 holds the CRC16 value.
+
+	;STORE CRC16
+	MOV		&(rfid.epcSize),R14		;[3]
+	ADD		R14, R14				;[1]
+	ADD		#(DATABUFF_MIN_SIZE), R14 ;[2]
+	ADD		&(RWData.EPCBankPtr), R14 ;[3]
+
+	MOV.B	R12,	-1(R14)			;[3]
+	SWPB	R12						;[1] move upper byte into lower byte
+	MOV.B	R12,	-2(R14)			;[3]
+	RETA							;[5]
+
 	.end
@@ -0,0 +1,106 @@
+/**
+ * @file downlink.c
+ *
+ * Downlink queue for the RFID module. Every accepted Write or BlockWrite
+ *  appends a record, so a reader can send many writes back to back while the
+ *  application drains them at its own pace, instead of each one overwriting
+ *  RWData.wrData (or the BlockWrite buffer) before it was looked at.
+ *
+ * While the queue is full, the handles reply with a Gen2 error code
+ *  (GEN2_ERR_OTHER) instead of the success reply, and the reader has to
+ *  repeat the write later. They decide this from RWData.dlFull while the
+ *  command is still coming in, since the reply is built before the last bits
+ *  arrive.
+ *
+ * @note The handles are the only producer and the client is the only
+ *  consumer, so the queue is a lock-free SPSC ring buffer. RWData.dlFull is
+ *  only set by the producer (with interrupts off) and only cleared by the
+ *  consumer.
+ */
+
+#include "../globals.h"
+#include "../util/ringbuf.h"
+#include "rfid.h"
+
+#if (WISP_DOWNLINK_QUEUE_SIZE & (WISP_DOWNLINK_QUEUE_SIZE-1))
+#error "WISP_DOWNLINK_QUEUE_SIZE must be a power of two"
+#endif
+
+static WISP_write_t DL_queue[WISP_DOWNLINK_QUEUE_SIZE]; // Writes waiting for the client
+
+/**
+ * State variables for the downlink queue
+ */
+static struct {
+    RINGBUF_t ring; // over DL_queue
+    volatile uint16_t rejected; // Writes answered with an error code because the queue was full
+} DL_SM = { RINGBUF_STATIC(DL_queue, WISP_DOWNLINK_QUEUE_SIZE, sizeof(WISP_write_t)), 0 };
+
+/**
+ * Queue the command which was just handled. Called from the Write/BlockWrite
+ *  handles (via CALLA) with the RX state machine halted, for the commands in
+ *  RWData.dlMask.
+ *
+ * @param cmd CMD_ID_WRITE or CMD_ID_BLOCKWRITE
+ * @return SUCCESS, or FAIL if the reply is the error code (the queue was full)
+ */
+BOOL RFID_queueWrite(uint8_t cmd) {
+    WISP_write_t wr;
+
+    // Header bit of the reply: '1' for the error reply
+    if (rfidBuf[0] & BIT7) {
+        DL_SM.rejected++;
+        return FAIL;
+    }
+
+    wr.cmd = cmd;
+    wr.memBank = RWData.memBank;
+    wr.wordPtr = RWData.wordPtr;
+    wr.data = (cmd == CMD_ID_WRITE) ? RWData.wrData : RWData.bwrBufPtr[RWData.wordPtr];
+
+    RINGBUF_put(&DL_SM.ring, &wr); // room was checked through RWData.dlFull
+
+    if (RINGBUF_isFull(&DL_SM.ring))
+        RWData.dlFull = RWData.dlMask;
+
+    return SUCCESS;
+}
+
+/**
+ * Select which commands are queued. Nothing is queued by default; the
+ *  handles then keep overwriting RWData.wrData and the BlockWrite buffer.
+ *
+ * @param mask OR of CMD_ID_WRITE and CMD_ID_BLOCKWRITE
+ */
+void WISP_enableDownlink(uint8_t mask) {
+    RWData.dlMask = mask;
+    RWData.dlFull = RINGBUF_isFull(&DL_SM.ring) ? mask : 0;
+}
+
+/**
+ * Pop the oldest queued write.
+ *
+ * @param wr destination for the write record
+ * @return SUCCESS if a record was copied out, FAIL if the queue was empty
+ */
+BOOL WISP_getWrite(WISP_write_t* wr) {
+    BOOL result = RINGBUF_get(&DL_SM.ring, wr);
+
+    RWData.dlFull = 0; // there is room now, or the queue is empty anyway
+    return result ? SUCCESS : FAIL;
+}
+
+/**
+ * @return number of writes waiting in the queue
+ */
+uint8_t WISP_writesPending(void) {
+    return (uint8_t) RINGBUF_count(&DL_SM.ring);
+}
+
+/**
+ * @return number of writes answered with an error code because the queue
+ *  was full
+ */
+uint16_t WISP_writesRejected(void) {
+    return DL_SM.rejected;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file epcqueue.c
+ *
+ * Queue of EPCs which are sent one per ACK, so sensor data can be streamed
+ *  to an inventorying reader without returning from WISP_doRFID() between
+ *  payloads.
+ *
+ * The next queued EPC is staged ahead of time: copied into the back EPC
+ *  buffer with its StoredPC and CRC16 built, while the current one is still
+ *  being sent. Staging runs where no reader command is due (on entry of
+ *  WISP_doRFID(), between commands which got no reply, and from
+ *  WISP_queueEPC()).
+ *
+ * An ACK only counts once the reader moves on to another command (QueryRep,
+ *  Query, ReqRN, ...). A repeated ACK means the EPC reply was lost, so it is
+ *  answered with the same EPC; a NAK drops the ACK. Once it is confirmed,
+ *  WISP_doRFID() flips rfid.epcSwap and swaps the buffers right away. Once the
+ *  last queued EPC has been acknowledged, the queue is drained: the drained
+ *  callback runs and the tag keeps sending that last EPC.
+ *
+ * Every queued EPC carries its own length (rfid.epcSize when it was queued).
+ *  RFID_swapEPC() takes it over from the StoredPC.
+ *
+ * @note Queued EPCs are built in the back buffer, so the application must
+ *  not use WISP_getBackEPC() or write wispData.epcBuf while the queue is in
+ *  use.
+ */
+
+#include <string.h>
+#include "../globals.h"
+#include "../util/ringbuf.h"
+#include "rfid.h"
+
+#if (WISP_EPC_QUEUE_SIZE & (WISP_EPC_QUEUE_SIZE-1))
+#error "WISP_EPC_QUEUE_SIZE must be a power of two"
+#endif
+
+#if (WISP_EPC_QUEUE_WORDS > MAX_EPC_WORDS)
+#error "WISP_EPC_QUEUE_WORDS must not exceed MAX_EPC_WORDS"
+#endif
+
+#define EPCQ_REC_SIZE   ((WISP_EPC_QUEUE_WORDS << 1) + 1)  // length in words, then the EPC bytes
+
+static uint8_t EPCQ_queue[WISP_EPC_QUEUE_SIZE][EPCQ_REC_SIZE]; // EPCs waiting to be sent
+
+/**
+ * State variables for the EPC queue
+ */
+static struct {
+    RINGBUF_t ring; // over EPCQ_queue
+    BOOL inFlight; // A queued EPC is being sent and waits for its ACK
+    void (*drainedFn)(void); // Called once the last queued EPC was acknowledged
+} EPCQ_SM = { RINGBUF_STATIC(EPCQ_queue, WISP_EPC_QUEUE_SIZE, EPCQ_REC_SIZE), FALSE, 0 };
+
+/**
+ * Catch up with confirmed ACKs, and stage the oldest queued EPC if the back
+ *  buffer is free. An EPC staged while nothing waits for an ACK goes live
+ *  right away.
+ *
+ * @pre interrupts are disabled
+ * @return TRUE if the last queued EPC was acknowledged just now
+ */
+static BOOL EPCQ_service(void) {
+    uint8_t rec[EPCQ_REC_SIZE];
+    uint8_t* back;
+    BOOL isDrained = FALSE;
+
+    // A staged EPC is still waiting for its ACK, or the swap did not happen yet
+    if (rfid.epcStaged || rfid.epcSwap)
+        return FALSE;
+
+    if (rfid.epcAcked) {
+        rfid.epcAcked = FALSE;
+        isDrained = EPCQ_SM.inFlight; // not if the ACK was for an EPC from outside the queue
+        EPCQ_SM.inFlight = FALSE;
+    }
+
+    if (!RINGBUF_get(&EPCQ_SM.ring, rec))
+        return isDrained;
+
+    back = RFID_backEPC();
+    memcpy(&back[2], &rec[1], rec[0] << 1);
+    RFID_buildEPC(back, rec[0]);
+
+    if (EPCQ_SM.inFlight) {
+        rfid.epcStaged = TRUE; // the ACK of the current EPC swaps it in
+    } else {
+        rfid.epcSwap = TRUE;
+        EPCQ_SM.inFlight = TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Start sending queued EPCs, one per ACK. EPCs queued before are staged
+ *  right away.
+ *
+ * @param fnPtr called (from WISP_doRFID(), between reader commands) once the
+ *  last queued EPC was acknowledged, may be NULL. It may set rfid.abortFlag to
+ *  leave WISP_doRFID().
+ */
+void WISP_startEPCQueue(void(*fnPtr)(void)) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    EPCQ_SM.drainedFn = fnPtr;
+    rfid.epcQueued = TRUE;
+    EPCQ_service();
+
+    __set_interrupt_state(state);
+}
+
+/**
+ * Stop the EPC queue and drop all EPCs which were not sent yet. The EPC which
+ *  is being sent stays in place.
+ */
+void WISP_stopEPCQueue(void) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    rfid.epcQueued = FALSE;
+    rfid.epcStaged = FALSE;
+    rfid.epcAckPending = FALSE;
+    rfid.epcAcked = FALSE;
+    EPCQ_SM.inFlight = FALSE;
+    RINGBUF_flush(&EPCQ_SM.ring);
+
+    __set_interrupt_state(state);
+}
+
+/**
+ * Add an EPC to the queue. May be called from an ISR, also while
+ *  WISP_doRFID() runs.
+ *
+ * @param epc rfid.epcSize words of EPC data
+ * @return SUCCESS, or FAIL if the queue is full or rfid.epcSize is larger
+ *  than WISP_EPC_QUEUE_WORDS
+ */
+BOOL WISP_queueEPC(const uint8_t* epc) {
+    return WISP_queueEPCWords(epc, rfid.epcSize);
+}
+
+/**
+ * Like WISP_queueEPC(), but with a length of its own. rfid.epcSize changes to
+ *  it when this EPC is swapped in.
+ *
+ * @param epc EPC data
+ * @param words its length in words, 1 to WISP_EPC_QUEUE_WORDS
+ * @return SUCCESS, or FAIL if the queue is full or the length is out of range
+ */
+BOOL WISP_queueEPCWords(const uint8_t* epc, uint8_t words) {
+    uint8_t rec[EPCQ_REC_SIZE];
+    uint16_t state;
+    BOOL result;
+
+    if ((words == 0) || (words > WISP_EPC_QUEUE_WORDS))
+        return FAIL;
+
+    rec[0] = words;
+    memcpy(&rec[1], epc, words << 1);
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+
+    result = RINGBUF_put(&EPCQ_SM.ring, rec);
+
+    if (result && rfid.epcQueued)
+        EPCQ_service();
+
+    __set_interrupt_state(state);
+
+    return result;
+}
+
+/**
+ * @return number of queued EPCs which were not acknowledged yet, including
+ *  the staged one and the one being sent
+ */
+uint8_t WISP_epcsQueued(void) {
+    return (uint8_t) RINGBUF_count(&EPCQ_SM.ring) + (rfid.epcStaged ? 1 : 0)
+            + ((EPCQ_SM.inFlight && !rfid.epcAcked) ? 1 : 0);
+}
+
+/**
+ * @return TRUE once every queued EPC has been acknowledged
+ */
+BOOL WISP_isEPCQueueDrained(void) {
+    return (WISP_epcsQueued() == 0) ? TRUE : FALSE;
+}
+
+/**
+ * Called by WISP_doRFID() on entry and between reader commands which got no
+ *  reply, when rfid.epcQueued is set. Stages the next queued EPC, or reports
+ *  the queue as drained.
+ */
+void RFID_serviceEPCQueue(void) {
+    uint16_t state = __get_interrupt_state();
+    BOOL isDrained;
+
+    __disable_interrupt();
+    isDrained = EPCQ_service();
+    __set_interrupt_state(state);
+
+    if (isDrained && EPCQ_SM.drainedFn)
+        EPCQ_SM.drainedFn();
+}
@@ -0,0 +1,105 @@
+/**
+ * @file events.c
+ *
+ * Deferred event queue for the RFID module. The command handles post a small
+ *  record once their reply is on the air, and client code drains the queue
+ *  after WISP_doRFID() returns (or from any other context) instead of doing
+ *  work from inside the timing critical handles.
+ *
+ * @note The handles are the only producer and the client is the only
+ *  consumer, so the queue is a lock-free SPSC ring buffer.
+ */
+
+#include "../globals.h"
+#include "../util/ringbuf.h"
+#include "rfid.h"
+
+#if (WISP_EVENT_QUEUE_SIZE & (WISP_EVENT_QUEUE_SIZE-1))
+#error "WISP_EVENT_QUEUE_SIZE must be a power of two"
+#endif
+
+static WISP_event_t EVT_queue[WISP_EVENT_QUEUE_SIZE]; // Pending event records
+
+/**
+ * State variables for the event queue
+ */
+static struct {
+    RINGBUF_t ring; // over EVT_queue
+    volatile uint16_t dropped; // Events lost because the queue was full
+} EVT_SM = { RINGBUF_STATIC(EVT_queue, WISP_EVENT_QUEUE_SIZE, sizeof(WISP_event_t)), 0 };
+
+/**
+ * Post an event record. Called from the RFID handles (via CALLA) after their
+ *  reply has been sent, while the RX state machine is halted.
+ *
+ * @param type WISP_EVENT_* id of the command which was just handled
+ */
+void RFID_postEvent(uint8_t type) {
+    WISP_event_t evt;
+
+    evt.type = type;
+
+    switch (type) {
+    case WISP_EVENT_READ:
+        evt.memBank = RWData.memBank;
+        evt.wordPtr = RWData.wordPtr;
+        evt.data = rfid.handle;
+        break;
+    case WISP_EVENT_WRITE:
+        evt.memBank = RWData.memBank;
+        evt.wordPtr = RWData.wordPtr;
+        evt.data = RWData.wrData;
+        break;
+    case WISP_EVENT_BLOCKWRITE:
+        evt.memBank = RWData.memBank;
+        evt.wordPtr = RWData.wordPtr;
+        evt.data = RWData.bwrByteCount;
+        break;
+    case WISP_EVENT_CUSTOM:
+        evt.memBank = RWData.cuSub;
+        evt.wordPtr = RWData.cuCount;
+        evt.data = RWData.cuOffset;
+        break;
+    default: // RN16 and ACK only carry the handle
+        evt.memBank = 0;
+        evt.wordPtr = 0;
+        evt.data = rfid.handle;
+        break;
+    }
+
+    if (!RINGBUF_put(&EVT_SM.ring, &evt))
+        EVT_SM.dropped++;
+}
+
+/**
+ * Select which commands post an event record. Nothing is posted by default.
+ *
+ * @param mask OR of WISP_EVENT_* ids
+ */
+void WISP_enableEvents(uint8_t mask) {
+    RWData.evtMask = mask;
+}
+
+/**
+ * Pop the oldest pending event.
+ *
+ * @param evt destination for the event record
+ * @return SUCCESS if an event was copied out, FAIL if the queue was empty
+ */
+BOOL WISP_getEvent(WISP_event_t* evt) {
+    return RINGBUF_get(&EVT_SM.ring, evt);
+}
+
+/**
+ * @return number of events waiting in the queue
+ */
+uint8_t WISP_eventsPending(void) {
+    return (uint8_t) RINGBUF_count(&EVT_SM.ring);
+}
+
+/**
+ * @return number of events lost because the queue was full
+ */
+uint16_t WISP_eventsDropped(void) {
+    return EVT_SM.dropped;
+}
@@ -6,12 +6,19 @@
  * @author Aaron Parks
  */
 
+#include <string.h>
 #include "../globals.h"
+#include "../Math/crc16.h"
 #include "rfid.h"
 
+#if (CUSTOM_MAX_READ + 6 > RFIDBUFF_SIZE)
+#error "CUSTOM_MAX_READ does not fit the reply buffer"
+#endif
+
 uint8_t usrBank[USRBANK_SIZE];
 
-// Client access to RFID data buffers.
+// Client access to RFID data buffers. epcBuf is always dataBuf; once the EPC is
+//  double buffered (WISP_commitEPC()) that may be the back buffer, see WISP_refreshEPC().
 void WISP_getDataBuffers(WISP_dataStructInterface_t* clientStruct) {
 	clientStruct->epcBuf=&dataBuf[2];
 	clientStruct->writeBufPtr=&(RWData.wrData);
@@ -56,6 +63,27 @@ void WISP_registerCallback_BLOCKWRITE(void(*fnPtr)(void)){
 }
 
 
+/**
+ * Registers a callback which WISP_doRFID() calls between reader commands,
+ *  while the RX state machine is halted, and once more when the receive times
+ *  out. It is skipped after commands which got a reply, since the reader
+ *  follows those up within T2, and after Select, which the Query follows
+ *  within T4. Keep it short: a command arriving while it runs is missed and
+ *  the reader has to repeat it.
+ */
+void WISP_registerCallback_IDLE(void(*fnPtr)(void)){
+	RWData.idleHook =((void*)(fnPtr));
+}
+
+
+/**
+ * Registers a callback for a custom command (0xE0 xx) event
+ */
+void WISP_registerCallback_CUSTOM(void(*fnPtr)(void)){
+	RWData.cuHook =((void*)(fnPtr));
+}
+
+
 /**
  * Sets mode parameters for the RFID state machine
  */
@@ -70,3 +98,108 @@ void WISP_setMode(uint8_t mode) {
 void WISP_setAbortConditions(uint8_t abortOn) {
 	rfid.abortOn = abortOn;
 }
+
+/**
+ * Tells the RFID loop that the EPC buffer was modified from within
+ *  WISP_doRFID() (e.g. by the idle callback), so the StoredPC and CRC16 are
+ *  rebuilt before the next reply. Not needed for changes made outside of
+ *  WISP_doRFID(), since every entry rebuilds them anyway.
+ *
+ * Once the EPC is double buffered, wispData.epcBuf may point into the back
+ *  buffer. Then the change is committed, so it is swapped in (with its own
+ *  StoredPC and CRC16) instead of rebuilding the buffer which is being sent.
+ */
+void WISP_refreshEPC(void) {
+	if (rfid.epcBuffered && (RWData.EPCBankPtr != dataBuf))
+		WISP_commitEPC();
+	else
+		rfid.epcDirty = TRUE;
+}
+
+/**
+ * Sets the memory regions the custom command (MODE_CUSTOM) works on. A custom
+ *  read streams up to CUSTOM_MAX_READ bytes from rdPtr[offset], a custom bulk
+ *  write stores up to CUSTOM_MAX_WRITE bytes to wrPtr[offset]. Requests which
+ *  don't fit in the region get a Gen2 error reply (GEN2_ERR_OVERRUN).
+ *
+ * @param rdPtr region custom reads are served from, NULL for none
+ * @param rdSize its size in bytes
+ * @param wrPtr region custom bulk writes go to, NULL for none
+ * @param wrSize its size in bytes
+ */
+void WISP_setCustomRegions(const uint8_t* rdPtr, uint16_t rdSize, uint8_t* wrPtr, uint16_t wrSize) {
+	RWData.cuRdPtr = (uint8_t*) rdPtr;
+	RWData.cuRdSize = rdPtr ? rdSize : 0;
+	RWData.cuWrPtr = wrPtr;
+	RWData.cuWrSize = wrPtr ? wrSize : 0;
+}
+
+/**
+ * @return the EPC buffer (StoredPC, EPC, CRC16) which is not being sent
+ */
+uint8_t* RFID_backEPC(void) {
+	return (RWData.EPCBankPtr == dataBuf) ? dataBufAlt : dataBuf;
+}
+
+/**
+ * Start an EPC update. Any committed but not yet swapped update is dropped,
+ *  so a half filled buffer never goes out.
+ *
+ * @return the EPC bytes of the back buffer, preloaded with the current EPC.
+ *  Change them as needed, then call WISP_commitEPC().
+ */
+uint8_t* WISP_getBackEPC(void) {
+	uint8_t* back;
+
+	rfid.epcSwap = FALSE;
+
+	back = RFID_backEPC();
+	memcpy(&back[2], &RWData.EPCBankPtr[2], rfid.epcSize << 1);
+
+	return &back[2];
+}
+
+/**
+ * Finish an EPC update: build the StoredPC and CRC16 of the back buffer and
+ *  have WISP_doRFID() swap it in between two reader commands, so a reply
+ *  never carries a mix of old and new bytes. From the first commit on,
+ *  WISP_doRFID() no longer rebuilds the CRC16 on every entry, and the EPC
+ *  must only be changed through WISP_getBackEPC() (not wispData.epcBuf).
+ */
+void WISP_commitEPC(void) {
+	RFID_buildEPC(RFID_backEPC(), rfid.epcSize);
+	rfid.epcSwap = TRUE;
+}
+
+/**
+ * Build the StoredPC and CRC16 of an EPC buffer which is not being sent. The
+ *  length goes into the StoredPC; RFID_swapEPC() takes it from there.
+ *
+ * @param buf StoredPC, EPC, CRC16 buffer (dataBuf or dataBufAlt)
+ * @param words EPC length in words
+ */
+void RFID_buildEPC(uint8_t* buf, uint8_t words) {
+	uint16_t len = (words << 1) + DATABUFF_MIN_SIZE;
+	uint16_t crc;
+
+	buf[0] = ((words & 0x1F) << 3) | STORED_PC1;
+	buf[1] = STORED_PC0;
+
+	crc = crc16_ccitt(CRC_NO_PRELOAD, buf, len - 2);
+	buf[len - 2] = (uint8_t) (crc >> 8);
+	buf[len - 1] = (uint8_t) crc;
+
+	rfid.epcBuffered = TRUE;
+}
+
+/**
+ * Make the committed back buffer the one which is sent. Called by
+ *  WISP_doRFID() on entry and after every command, when rfid.epcSwap is set.
+ *  rfid.epcSize follows the StoredPC of the new buffer, so queued EPCs may
+ *  differ in length.
+ */
+void RFID_swapEPC(void) {
+	RWData.EPCBankPtr = RFID_backEPC();
+	rfid.epcSize = RWData.EPCBankPtr[0] >> 3;
+	rfid.epcSwap = FALSE;
+}
@@ -0,0 +1,230 @@
+/**
+ * @file link.c
+ *
+ * Link estimator for uplink data. The application writes a byte stream with
+ *  LINK_send(); the estimator cuts it into EPCs and sends them through the
+ *  EPC queue, one per ACK.
+ *
+ * The RN16 and ACK handles keep free running counters in rfid. Every
+ *  LINK_WINDOW RN16 replies, the share of them which led to a delivered EPC
+ *  (an ACK which was not repeated for the same handle) is folded into an
+ *  EWMA for the EPC length in use. Success can only drop with a longer EPC,
+ *  so the other lengths are clamped against it, and lengths which are not in
+ *  use slowly regain their success so they get probed again. The length with
+ *  the most data bytes per unit of air time is used for the next EPC.
+ *
+ * At most LINK_AHEAD EPCs (the one being sent and the staged one) are handed
+ *  to the EPC queue at a time. The rest of the stream stays in the byte
+ *  buffer, so a new EPC length applies to all data which was not sent yet.
+ *
+ * The data bytes per unit of air time of each length are computed once, in
+ *  LINK_init(), so closing a window takes one small division and a few
+ *  hardware multiplies.
+ *
+ * @note LINK_send() and LINK_update() belong to the main loop. WISP_doRFID()
+ *  runs the estimator too, between reader commands which got no reply (from
+ *  the EPC queue drained callback), never in the ACK handle.
+ */
+
+#include <string.h>
+#include "../globals.h"
+#include "../util/ringbuf.h"
+#include "rfid.h"
+#include "link.h"
+
+#if (LINK_STREAM_SIZE & (LINK_STREAM_SIZE-1))
+#error "LINK_STREAM_SIZE must be a power of two"
+#endif
+
+#define LINK_ONE        (256)   // success ratio of 1.0 (Q8)
+#define LINK_EWMA_SHIFT (2)     // a new window counts 1/4
+#define LINK_AHEAD      (2)     // EPCs packed ahead of the stream
+
+static const uint8_t LINK_sizes[] = { 2, 4, 6, 8, 12, 16, 24 }; // EPC lengths in words, ascending
+#define LINK_NUM_SIZES  (sizeof(LINK_sizes))
+#define LINK_DEF_SIZE   (2)     // index of 6 words, the default EPC length
+
+static uint8_t LINK_stream[LINK_STREAM_SIZE]; // Data which was not packed into an EPC yet
+
+/**
+ * State variables for the link estimator
+ */
+static struct {
+    RINGBUF_t stream; // over LINK_stream
+    uint16_t success[LINK_NUM_SIZES]; // Delivered EPCs per RN16 reply for each length (Q8, EWMA)
+    uint16_t weight[LINK_NUM_SIZES]; // Data bytes per unit of air time for each length (Q8)
+    uint8_t cur; // Index into LINK_sizes of the length in use
+    uint8_t numSizes; // Lengths which fit into the EPC queue
+    uint16_t rnStart; // rfid counters at the start of the window
+    uint16_t ackStart;
+    uint16_t repStart;
+    uint8_t seq; // Sequence number of the next EPC
+    void (*doneFn)(void); // Called once the whole stream was acknowledged
+} LINK_SM = { RINGBUF_STATIC(LINK_stream, LINK_STREAM_SIZE, 1) };
+
+/**
+ * Start a new window at the current counter values.
+ */
+static void LINK_restartWindow(void) {
+    LINK_SM.rnStart = rfid.rnCount;
+    LINK_SM.ackStart = rfid.ackCount;
+    LINK_SM.repStart = rfid.ackRepeats;
+}
+
+/**
+ * Hand the stream to the EPC queue at the current length, until LINK_AHEAD
+ *  of its EPCs are queued.
+ */
+static void LINK_pack(void) {
+    uint8_t epc[WISP_EPC_QUEUE_WORDS << 1];
+    uint8_t words = LINK_sizes[LINK_SM.cur];
+    uint8_t room = (words << 1) - LINK_HDR_SIZE;
+    uint8_t len;
+
+    if (!rfid.epcQueued)
+        return;
+
+    while ((WISP_epcsQueued() < LINK_AHEAD) && !RINGBUF_isEmpty(&LINK_SM.stream)) {
+        len = (uint8_t) RINGBUF_read(&LINK_SM.stream, &epc[LINK_HDR_SIZE], room);
+        memset(&epc[LINK_HDR_SIZE + len], 0, room - len);
+        epc[0] = LINK_SM.seq++;
+        epc[1] = len;
+
+        WISP_queueEPCWords(epc, words);
+    }
+}
+
+/**
+ * EPC queue drained callback, runs in WISP_doRFID() between reader commands.
+ */
+static void LINK_drained(void) {
+    LINK_update();
+    LINK_pack();
+
+    if (!WISP_epcsQueued() && LINK_SM.doneFn)
+        LINK_SM.doneFn();
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Reset the estimator and drop all data which was not sent yet. Starts with
+ *  the default EPC length and every length assumed to work.
+ */
+void LINK_init(void) {
+    uint8_t i;
+
+    RINGBUF_flush(&LINK_SM.stream);
+
+    LINK_SM.numSizes = 0;
+    for (i = 0; i < LINK_NUM_SIZES; i++) {
+        LINK_SM.success[i] = LINK_ONE;
+        LINK_SM.weight[i] = (((LINK_sizes[i] << 1) - LINK_HDR_SIZE) << 8)
+                / (LINK_sizes[i] + LINK_OVERHEAD_WORDS);
+        if (LINK_sizes[i] <= WISP_EPC_QUEUE_WORDS)
+            LINK_SM.numSizes = i + 1;
+    }
+
+    LINK_SM.cur = (LINK_DEF_SIZE < LINK_SM.numSizes) ? LINK_DEF_SIZE : LINK_SM.numSizes - 1;
+    LINK_SM.seq = 0;
+    LINK_restartWindow();
+}
+
+/**
+ * Add data to the uplink stream.
+ *
+ * @return number of bytes taken, less than size if the stream buffer is full
+ */
+uint16_t LINK_send(const uint8_t* data, uint16_t size) {
+    uint16_t n = RINGBUF_write(&LINK_SM.stream, data, size);
+
+    LINK_pack();
+    return n;
+}
+
+/**
+ * @return bytes of the stream which were not packed into an EPC yet
+ */
+uint16_t LINK_pending(void) {
+    return RINGBUF_count(&LINK_SM.stream);
+}
+
+/**
+ * Close the window once LINK_WINDOW RN16 replies were sent, and pick the EPC
+ *  length for the data which follows. Runs whenever the EPC queue drains;
+ *  call it from the main loop too, so a tag which stops getting ACKs still
+ *  falls back to shorter EPCs.
+ */
+void LINK_update(void) {
+    uint16_t rn = rfid.rnCount - LINK_SM.rnStart;
+    uint16_t good, ratio, curSuccess;
+    uint32_t rate, bestRate = 0;
+    uint8_t i, best = 0;
+
+    if (rn < LINK_WINDOW)
+        return;
+
+    good = (rfid.ackCount - LINK_SM.ackStart) - (rfid.ackRepeats - LINK_SM.repStart);
+    LINK_restartWindow();
+
+    // Keep good << 8 in 16 bits
+    while (rn > 255) {
+        rn >>= 1;
+        good >>= 1;
+    }
+    ratio = (good >= rn) ? LINK_ONE : ((good << 8) / rn);
+
+    i = LINK_SM.cur;
+    LINK_SM.success[i] += (int16_t) (ratio - LINK_SM.success[i]) >> LINK_EWMA_SHIFT;
+    curSuccess = LINK_SM.success[i];
+
+    for (i = 0; i < LINK_SM.numSizes; i++) {
+        if (i == LINK_SM.cur)
+            continue;
+
+        LINK_SM.success[i] += (LINK_ONE - LINK_SM.success[i]) >> LINK_PROBE_SHIFT;
+
+        if ((i > LINK_SM.cur) && (LINK_SM.success[i] > curSuccess))
+            LINK_SM.success[i] = curSuccess; // longer EPCs do no better
+        else if ((i < LINK_SM.cur) && (LINK_SM.success[i] < curSuccess))
+            LINK_SM.success[i] = curSuccess; // shorter EPCs do no worse
+    }
+
+    for (i = 0; i < LINK_SM.numSizes; i++) {
+        rate = (uint32_t) LINK_SM.success[i] * LINK_SM.weight[i];
+        if (rate > bestRate) {
+            bestRate = rate;
+            best = i;
+        }
+    }
+
+    LINK_SM.cur = best;
+}
+
+/**
+ * @return EPC length in words which the estimator uses for the next EPC
+ */
+uint8_t LINK_epcWords(void) {
+    return LINK_sizes[LINK_SM.cur];
+}
+
+/**
+ * Start streaming: takes over the EPC queue (and with it the EPC and
+ *  rfid.epcSize) and sends the stream one EPC per ACK.
+ *
+ * @param fnPtr called (from WISP_doRFID(), between reader commands) once all
+ *  data handed to LINK_send() was acknowledged, may be NULL
+ */
+void LINK_attachToRFID(void(*fnPtr)(void)) {
+    LINK_SM.doneFn = fnPtr;
+    LINK_restartWindow();
+    WISP_startEPCQueue(&LINK_drained);
+    LINK_pack();
+}
+
+/**
+ * Stop streaming. Data which was not sent yet stays in the stream.
+ */
+void LINK_detachFromRFID(void) {
+    WISP_stopEPCQueue();
+}
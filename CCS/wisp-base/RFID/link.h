@@ -0,0 +1,34 @@
+/**
+ * @file link.h
+ *
+ * Link estimator which streams application data through the EPC queue and
+ *  picks the EPC length from the observed RN16/ACK success.
+ *
+ * Every EPC it sends starts with two header bytes:
+ *  - 0: sequence number, counts up by one per EPC (a reader can drop repeats
+ *       and detect lost EPCs with it)
+ *  - 1: number of data bytes which follow; the rest up to the EPC length is
+ *       zero padding
+ */
+
+#ifndef LINK_H_
+#define LINK_H_
+
+#include "../globals.h"
+
+#define LINK_HDR_SIZE   (2)     // bytes in front of the data of every EPC
+
+/*
+ * Function prototypes
+ */
+
+void LINK_init(void);
+uint16_t LINK_send(const uint8_t* data, uint16_t size);
+uint16_t LINK_pending(void);
+void LINK_update(void);
+uint8_t LINK_epcWords(void);
+
+void LINK_attachToRFID(void(*fnPtr)(void));
+void LINK_detachFromRFID(void);
+
+#endif /* LINK_H_ */
@@ -16,12 +16,34 @@
 #define MODE_READ       (BIT0)      /* tag responds to read commands                                                            */
 #define MODE_WRITE      (BIT1)      /* tag responds to write commands                                                           */
 #define MODE_USES_SEL   (BIT2)      /* tags only use select when they want to play nice (they don't have to)                    */
+#define MODE_CUSTOM     (BIT3)      /* tag responds to the custom command (0xE0 xx), see WISP_setCustomRegions()                */
 
 // RFID command IDs
 #define CMD_ID_ACK      (BIT0)
 #define CMD_ID_READ     (BIT1)
 #define CMD_ID_WRITE    (BIT2)
 #define CMD_ID_BLOCKWRITE (BIT3)
+#define CMD_ID_CUSTOM   (BIT4)
+
+// Gen2 error code sent in reply to a Write/BlockWrite which the full downlink queue can't take
+#define GEN2_ERR_OTHER  (0x00)
+
+// Gen2 error code sent in reply to a custom command outside of its region
+#define GEN2_ERR_OVERRUN (0x03)
+
+// RFID event IDs (also used as the mask bits for WISP_enableEvents)
+#define WISP_EVENT_RN16         (BIT0)
+#define WISP_EVENT_ACK          (BIT1)
+#define WISP_EVENT_READ         (BIT2)
+#define WISP_EVENT_WRITE        (BIT3)
+#define WISP_EVENT_BLOCKWRITE   (BIT4)
+#define WISP_EVENT_CUSTOM       (BIT5)
+
+// Custom command: {0xE0, sub[8], len[8], payload[len bytes], RN16, CRC16}, all fields byte aligned
+#define CUSTOM_OPCODE       (0xE0)
+#define CUSTOM_SUB_READ     (0x00)  /* payload {offset[16], count[8]}, reply {'0', count[8], data[count], RN16, CRC16}  */
+#define CUSTOM_SUB_WRITE    (0x01)  /* payload {offset[16], data[len-2]}, reply {'0', RN16, CRC16}                       */
+#define CUSTOM_MAX_LEN      (2+CUSTOM_MAX_WRITE)    /* longest payload which fits the command buffer                    */
 
 // Client interface to read, write, and EPC memory buffers
 typedef struct {
@@ -32,6 +54,22 @@ typedef struct {
 	uint8_t* readBufPtr;
 } WISP_dataStructInterface_t;
 
+// Event record posted by the RFID handles once their reply has been sent
+typedef struct {
+	uint8_t type;       // WISP_EVENT_* id
+	uint8_t memBank;    // memBank parsed from READ/WRITE/BLOCKWRITE, else 0
+	uint8_t wordPtr;    // wordPtr parsed from READ/WRITE/BLOCKWRITE, else 0
+	uint16_t data;      // WRITE data, BLOCKWRITE byte count, else the RN16 handle
+} WISP_event_t;
+
+// Write record queued by the Write/BlockWrite handles (one word per command)
+typedef struct {
+	uint8_t cmd;        // CMD_ID_WRITE or CMD_ID_BLOCKWRITE
+	uint8_t memBank;    // memBank parsed from the command
+	uint8_t wordPtr;    // wordPtr parsed from the command
+	uint16_t data;      // the word which was written
+} WISP_write_t;
+
 extern void WISP_doRFID(void);
 
 // Callback registration
@@ -40,10 +78,44 @@ void WISP_registerCallback_ACK(void(*fnPtr)(void));
 void WISP_registerCallback_READ(void(*fnPtr)(void));
 void WISP_registerCallback_WRITE(void(*fnPtr)(void));
 void WISP_registerCallback_BLOCKWRITE(void(*fnPtr)(void));
+void WISP_registerCallback_IDLE(void(*fnPtr)(void));
+void WISP_registerCallback_CUSTOM(void(*fnPtr)(void));
 
 // Access functions for RFID mode parameters
 void WISP_setMode(uint8_t newMode);
 void WISP_setAbortConditions(uint8_t newAbortConditions);
+void WISP_refreshEPC(void);
+void WISP_setCustomRegions(const uint8_t* rdPtr, uint16_t rdSize, uint8_t* wrPtr, uint16_t wrSize);
+
+// Double buffered EPC
+uint8_t* WISP_getBackEPC(void);
+void WISP_commitEPC(void);
+uint8_t* RFID_backEPC(void);
+void RFID_buildEPC(uint8_t* buf, uint8_t words);
+void RFID_swapEPC(void);
+
+// EPC queue
+void WISP_startEPCQueue(void(*fnPtr)(void));
+void WISP_stopEPCQueue(void);
+BOOL WISP_queueEPC(const uint8_t* epc);
+BOOL WISP_queueEPCWords(const uint8_t* epc, uint8_t words);
+uint8_t WISP_epcsQueued(void);
+BOOL WISP_isEPCQueueDrained(void);
+void RFID_serviceEPCQueue(void);
+
+// Deferred event queue
+void WISP_enableEvents(uint8_t mask);
+BOOL WISP_getEvent(WISP_event_t* evt);
+uint8_t WISP_eventsPending(void);
+uint16_t WISP_eventsDropped(void);
+void RFID_postEvent(uint8_t type);
+
+// Downlink queue
+void WISP_enableDownlink(uint8_t mask);
+BOOL WISP_getWrite(WISP_write_t* wr);
+uint8_t WISP_writesPending(void);
+uint16_t WISP_writesRejected(void);
+BOOL RFID_queueWrite(uint8_t cmd);
 
 
 // Linker hack: We need to reference assembly ISRs directly somewhere to force linker to include them in binary.
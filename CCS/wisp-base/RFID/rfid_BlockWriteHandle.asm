@@ -23,7 +23,7 @@ R_scratch0	.set  R15
 
 	.ref cmd
 	.def  handleBlockWrite
-	.global RxClock, TxClock
+	.global RxClock, TxClock, RFID_postEvent, RFID_queueWrite
 	.sect ".text"
 
 handleBlockWrite:
@@ -104,11 +104,7 @@ store_Word:
 
 	SWPB    R_scratch1                                      ;[1]
 	BIS     R_scratch2, R_scratch1                          ;[1] merge b15-b8(R_scratch1) and b7-b(R_scratch2) together into R_scratch1
-
-	MOV.B   &(RWData.wordPtr), R_scratch2                   ;[3] Put offset to R15
-	RLAM.A  #1, R_scratch2                                  ;[2] Offset *= 2
-	ADDX.A  &(RWData.bwrBufPtr), R_scratch2                 ;[3] Add base address to offset.
-	MOV     R_scratch1, 0(R_scratch2)                       ;[3] move the data out to the correct address.
+	MOV     R_scratch1, R11                                 ;[1] hold the data word until handle and queue are checked (R11 is free until crc16_ccitt)
 
 ; Wait on handle.
 waitOnBits_4:
@@ -139,6 +135,16 @@ waitOnBits_4:
 	CMP     R_scratch1, &rfid.handle                        ;[2]
 	JNE     exit_safely                                     ;[2] Handle doesn't match, so exit.
 
+; Downlink queue full? Then the reader gets an error code instead, and the word is not queued.
+	BIT.B   #(CMD_ID_BLOCKWRITE), &(RWData.dlFull)          ;[4]
+	JNZ     blockWrite_ErrorReply                           ;[2]
+
+; Both checks passed, so the word may go into the BlockWrite buffer now.
+	MOV.B   &(RWData.wordPtr), R_scratch2                   ;[3] Put offset to R13
+	RLAM.A  #1, R_scratch2                                  ;[2] Offset *= 2
+	ADDX.A  &(RWData.bwrBufPtr), R_scratch2                 ;[3] Add base address to offset.
+	MOV     R11, 0(R_scratch2)                              ;[4] move the data out to the correct address.
+
 ; Prepare rfid transmission buffer, CRC16 0-bit and handle.
 	MOV     (rfid.handle), R_scratch0                       ;[3] bring in the RN16
 	SWPB    R_scratch0                                      ;[1] swap bytes so we can shove full word out in one call (MSByte into dataBuf[0],...)
@@ -161,6 +167,7 @@ waitOnBits_4:
 	RRC.B   (rfidBuf+3)                                     ;[6]
 	RRC.B   (rfidBuf+4)                                     ;[6]
 
+blockWrite_ReplyReady:
 ; Wait for the rest of the BlockWrite command bits (CRC16).
 waitOnBits_5:
 	CMP.W   #74, R_bits                                     ;[2]
@@ -179,8 +186,17 @@ waitOnBits_5:
 	CLR     &TA0CTL                                         ;[4]
 
 ; TCAL*0.85 - 2 us <= DELAY before response <= 20 ms
+; Queue the word for the application (or count it as rejected if the reply is an error code).
+queue_BlockWrite:
+	BIT.B   #(CMD_ID_BLOCKWRITE), &(RWData.dlMask)          ;[4]
+	JZ      call_my_BlockWriteCallback                      ;[2]
+	MOV     #(CMD_ID_BLOCKWRITE), R12                       ;[2]
+	CALLA   #RFID_queueWrite                                ;[5] Can mangle R12-R15
+	TST.B   R12                                             ;[1] FAIL: rejected, skip the callback
+	JZ      move_timing_delay_BlockWrite                    ;[2]
+
 call_my_BlockWriteCallback:
-	CMP.B       #(0), &(RWData.bwrHook)                     ;[4]
+	CMP         #(0), &(RWData.bwrHook)                     ;[4]
 	JEQ         move_timing_delay_BlockWrite                ;[2] If there is no user callback, wait before responding.
 	MOV         &(RWData.bwrHook), R_scratch0               ;[3]
 	CALLA       R_scratch0                                  ;[5]
@@ -194,13 +210,23 @@ timing_delay_for_BlockWrite:
 	JNZ     timing_delay_for_BlockWrite                     ;[2]
 
 respond_to_BlockWrite:
+	BIT.B   #(BIT7), &(rfidBuf)                             ;[4] C = header bit, '1' for the longer error reply
 	MOV     #rfidBuf, R12                                   ;[2] load the &rfidBuf[0]
 	MOV     #(4), R_scratch2                                ;[1] load into corr reg (numBytes)
+	ADC     R_scratch2                                      ;[1] 5 bytes for the error reply
 	MOV     #1, R_scratch1                                  ;[1] load numBits=1
 	MOV.B   #TREXT_ON, R_scratch0                           ;[3] load TRext
 
 	CALLA   #TxFM0                                          ;[5] Send response.
 
+; Post BLOCKWRITE event if enabled (reply is out, so no timing constraint anymore).
+	TST.B   &(rfidBuf)                                      ;[4] header bit '1': rejected, nothing to report
+	JN      exit_safely                                     ;[2]
+	BIT.B   #(WISP_EVENT_BLOCKWRITE), &(RWData.evtMask)     ;[4]
+	JZ      exit_safely                                     ;[2]
+	MOV     #(WISP_EVENT_BLOCKWRITE), R12                   ;[2]
+	CALLA   #RFID_postEvent                                 ;[5] Can mangle R12-R15
+
 ; TODO: In what order do we receive the words!? Figure out correct stop condition.
 ; Experimental, breaks BlockWrite atm... pls fix.
 ;blockwriteHandle_SkipHookCall:
@@ -218,6 +244,34 @@ respond_to_BlockWrite:
 ;	RETA
 
 
+; Error reply: header bit '1', error code, RN16, CRC16 (41 bits).
+blockWrite_ErrorReply:
+	MOV.B   #(GEN2_ERR_OTHER), &(rfidBuf)                   ;[4] load the error code
+	MOV     (rfid.handle), R_scratch0                       ;[3] bring in the RN16
+	SWPB    R_scratch0                                      ;[1] MSByte first
+	MOV.B   R_scratch0, &(rfidBuf+1)                        ;[4]
+	SWPB    R_scratch0                                      ;[1]
+	MOV.B   R_scratch0, &(rfidBuf+2)                        ;[4]
+
+	MOV     #(rfidBuf), R_scratch2                          ;[2] load &rfidBuf[0] as dataPtr
+	MOV     #(3), R_scratch1                                ;[2] error code and RN16
+
+	MOV     #ONE_BIT_CRC, R12                               ;[2]
+	CALLA   #crc16_ccitt                                    ;[5+196]
+
+	MOV.B   R12, &(rfidBuf+4)                               ;[3] store lower CRC byte first
+	SWPB    R12                                             ;[1] move upper byte into lower byte
+	MOV.B   R12, &(rfidBuf+3)                               ;[3] store upper CRC byte
+
+	SETC                                                    ;[1] header bit '1'
+	RRC.B   (rfidBuf)                                       ;[6]
+	RRC.B   (rfidBuf+1)                                     ;[6]
+	RRC.B   (rfidBuf+2)                                     ;[6]
+	RRC.B   (rfidBuf+3)                                     ;[6]
+	RRC.B   (rfidBuf+4)                                     ;[6]
+	RRC.B   (rfidBuf+5)                                     ;[6]
+	JMP     blockWrite_ReplyReady                           ;[2]
+
 exit_safely:
 	DINT
 	NOP;
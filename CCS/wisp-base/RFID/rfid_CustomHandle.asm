@@ -0,0 +1,306 @@
+;/***********************************************************************************************************************************/
+;/**@file		rfid_CustomHandle.asm
+;*	@brief		Implements the custom command (Gen2 custom opcode 0xE0 xx) for bulk data transfer
+;* 	@details	A Read moves at most 16 words behind a status bit, RN16 and CRC16, and a Write only one word. The custom
+;*				command uses its own length-prefixed framing instead, so a reader with custom command support can move
+;*				up to CUSTOM_MAX_READ bytes per reply, or CUSTOM_MAX_WRITE bytes per command.
+;*
+;*	@notes		CUSTOM:	{0xE0 [8], SUB [8], LEN [8], PAYLOAD [8*LEN], RN [16], CRC [16]}, every field is byte aligned
+;*				READ:	PAYLOAD = {OFFSET [16], COUNT [8]}		reply {'0', COUNT [8], DATA [8*COUNT], RN [16], CRC [16]}
+;*				WRITE:	PAYLOAD = {OFFSET [16], DATA [8*(LEN-2)]}	reply {'0', RN [16], CRC [16]}
+;*				Requests outside of the regions set by WISP_setCustomRegions() get {'1', GEN2_ERR_OVERRUN [8], RN [16], CRC [16]}
+;*
+;*	@section	Timing
+;*				The reply is built while the RN16 and CRC16 of the command are still coming in (32 bits, ~4000 cycles at the
+;*				16MHz RxClock, ~40% of which are left over by RX_SM). A full CUSTOM_MAX_READ reply takes ~1100 cycles of that:
+;*				copy (9/byte), CRC16 (4/byte) and the header bit shift (3/byte).
+;*
+;* 	WARNING:	As this routine executes concurrently with RX_SM, it is restricted to R11-R15 and RAM!
+;*/
+;/***********************************************************************************************************************************/
+
+	.cdecls C,LIST, "../globals.h"
+	.cdecls C,LIST, "../Math/crc16.h"
+	.cdecls C,LIST, "rfid.h"
+
+R_bits      .set  R5
+R_scratch2	.set  R13
+R_scratch1	.set  R14
+R_scratch0	.set  R15
+
+	.ref cmd
+	.def  handleCustom
+	.global RxClock, TxClock, RFID_postEvent
+	.sect ".text"
+
+handleCustom:
+
+;Wait for the sub opcode and the payload length (cmd[1], cmd[2])
+customWaitOnBits_0:
+	CMP.W   #24, R_bits                                     ;[2]
+	JLO     customWaitOnBits_0                              ;[2]
+
+	MOV.B   (cmd+1), &(RWData.cuSub)                        ;[6] store the sub opcode
+	MOV.B   (cmd+2), R_scratch0                             ;[3] payload length
+	MOV.B   R_scratch0, &(RWData.cuLen)                     ;[4]
+
+	CMP.B   #(CUSTOM_MAX_LEN+1), R_scratch0                 ;[2] would the payload overrun cmd[]? Then stop RX_SM right here.
+	JHS     customHandle_Ignore                             ;[2]
+
+	CMP.B   #(CUSTOM_SUB_READ), &(RWData.cuSub)             ;[4]
+	JEQ     customRead                                      ;[2]
+	CMP.B   #(CUSTOM_SUB_WRITE), &(RWData.cuSub)            ;[4]
+	JEQ     customWrite                                     ;[2]
+	JMP     customHandle_Ignore                             ;[2] unknown sub opcode
+
+;*************************************************************************************************************************************
+;	READ: stream COUNT bytes from cuRdPtr[OFFSET]
+;*************************************************************************************************************************************
+customRead:
+	CMP.B   #(3), R_scratch0                                ;[1] payload is {OFFSET, COUNT}
+	JNE     customHandle_Ignore                             ;[2]
+
+customWaitOnBits_1:
+	CMP.W   #48, R_bits                                     ;[2] OFFSET and COUNT are in cmd[3..5]
+	JLO     customWaitOnBits_1                              ;[2]
+
+	MOV.B   (cmd+3), R_scratch1                             ;[3] OFFSET MSByte
+	SWPB    R_scratch1                                      ;[1]
+	MOV.B   (cmd+4), R_scratch0                             ;[3] OFFSET LSByte
+	BIS     R_scratch0, R_scratch1                          ;[1]
+	MOV     R_scratch1, &(RWData.cuOffset)                  ;[4]
+	MOV.B   (cmd+5), R_scratch0                             ;[3] COUNT
+	MOV.B   R_scratch0, &(RWData.cuCount)                   ;[4]
+
+	;Range check: COUNT <= CUSTOM_MAX_READ and OFFSET+COUNT <= cuRdSize
+	CMP     #(CUSTOM_MAX_READ+1), R_scratch0                ;[2]
+	JHS     customError                                     ;[2]
+	ADD     R_scratch0, R_scratch1                          ;[1] end of the request
+	JC      customError                                     ;[2] wrapped around
+	CMP     R_scratch1, &(RWData.cuRdSize)                  ;[4]
+	JLO     customError                                     ;[2]
+
+	;Load {COUNT, DATA, RN16} into rfidBuf
+	MOV.B   R_scratch0, &(rfidBuf)                          ;[4] COUNT leads the reply
+	MOV     &(RWData.cuRdPtr), R_scratch2                   ;[3]
+	ADD     &(RWData.cuOffset), R_scratch2                  ;[3] source
+	MOV     #(rfidBuf+1), R_scratch1                        ;[2] destination
+	TST     R_scratch0                                      ;[1]
+	JZ      customRead_CopyDone                             ;[2]
+
+customRead_Copy:
+	MOV.B   @R_scratch2+, 0(R_scratch1)                     ;[5]
+	INC     R_scratch1                                      ;[1]
+	DEC     R_scratch0                                      ;[1]
+	JNZ     customRead_Copy                                 ;[2]
+
+customRead_CopyDone:
+	MOV     (rfid.handle), R_scratch0                       ;[3] RN16 goes right behind the data
+	MOV.B   R_scratch0, 1(R_scratch1)                       ;[4] store lower byte first
+	SWPB    R_scratch0                                      ;[1]
+	MOV.B   R_scratch0, 0(R_scratch1)                       ;[4] store upper byte
+
+	;Calc CRC16! (careful, it will clobber R11-R15)
+	MOV     #(rfidBuf), R13                                 ;[2] load &rfidBuf[0] as dataPtr
+	MOV.B   &(RWData.cuCount), R14                          ;[3]
+	ADD     #(3), R14                                       ;[1] COUNT, DATA and RN16
+	MOV     #ZERO_BIT_CRC, R12                              ;[2]
+	CALLA   #crc16_ccitt                                    ;[5+4/byte]
+
+	MOV.B   &(RWData.cuCount), R14                          ;[3]
+	ADD     #(rfidBuf+3), R14                               ;[2] CRC16 goes right behind the RN16
+	MOV.B   R12, 1(R14)                                     ;[4] store lower CRC byte first
+	SWPB    R12                                             ;[1] move upper byte into lower byte
+	MOV.B   R12, 0(R14)                                     ;[4] store upper CRC byte
+
+	MOV.B   &(RWData.cuCount), R_scratch0                   ;[3]
+	ADD     #(5), R_scratch0                                ;[1] reply length: COUNT, DATA, RN16, CRC16
+	CLR     R_scratch1                                      ;[1] header bit '0'
+	JMP     customReply                                     ;[2]
+
+;*************************************************************************************************************************************
+;	WRITE: store LEN-2 bytes to cuWrPtr[OFFSET], once the command is complete and the reply is out
+;*************************************************************************************************************************************
+customWrite:
+	SUB.B   #(2), R_scratch0                                ;[1] payload is {OFFSET, DATA}
+	JLO     customHandle_Ignore                             ;[2] shorter than OFFSET
+	MOV.B   R_scratch0, &(RWData.cuCount)                   ;[4]
+
+customWaitOnBits_2:
+	CMP.W   #40, R_bits                                     ;[2] OFFSET is in cmd[3..4]
+	JLO     customWaitOnBits_2                              ;[2]
+
+	MOV.B   (cmd+3), R_scratch1                             ;[3] OFFSET MSByte
+	SWPB    R_scratch1                                      ;[1]
+	MOV.B   (cmd+4), R_scratch2                             ;[3] OFFSET LSByte
+	BIS     R_scratch2, R_scratch1                          ;[1]
+	MOV     R_scratch1, &(RWData.cuOffset)                  ;[4]
+
+	;Range check: OFFSET+LEN-2 <= cuWrSize (LEN was checked against CUSTOM_MAX_LEN already)
+	ADD     R_scratch0, R_scratch1                          ;[1] end of the request
+	JC      customError                                     ;[2] wrapped around
+	CMP     R_scratch1, &(RWData.cuWrSize)                  ;[4]
+	JLO     customError                                     ;[2]
+
+	;Load {RN16, CRC16} into rfidBuf, like the Write reply
+	MOV     (rfid.handle), R_scratch0                       ;[3] bring in the RN16
+	SWPB    R_scratch0                                      ;[1] MSByte first
+	MOV     R_scratch0, &(rfidBuf)                          ;[4]
+
+	MOV     #(rfidBuf), R13                                 ;[2] load &rfidBuf[0] as dataPtr
+	MOV     #(2), R14                                       ;[1] RN16
+	MOV     #ZERO_BIT_CRC, R12                              ;[2]
+	CALLA   #crc16_ccitt                                    ;[5+8]
+
+	MOV.B   R12, &(rfidBuf+3)                               ;[4] store lower CRC byte first
+	SWPB    R12                                             ;[1] move upper byte into lower byte
+	MOV.B   R12, &(rfidBuf+2)                               ;[4] store upper CRC byte
+
+	MOV     #(4), R_scratch0                                ;[1] reply length: RN16, CRC16
+	CLR     R_scratch1                                      ;[1] header bit '0'
+	JMP     customReply                                     ;[2]
+
+;*************************************************************************************************************************************
+;	Error reply: {'1', GEN2_ERR_OVERRUN, RN16, CRC16}
+;*************************************************************************************************************************************
+customError:
+	MOV.B   #(GEN2_ERR_OVERRUN), &(rfidBuf)                 ;[4] load the error code
+	MOV     (rfid.handle), R_scratch0                       ;[3] bring in the RN16
+	SWPB    R_scratch0                                      ;[1] MSByte first
+	MOV.B   R_scratch0, &(rfidBuf+1)                        ;[4]
+	SWPB    R_scratch0                                      ;[1]
+	MOV.B   R_scratch0, &(rfidBuf+2)                        ;[4]
+
+	MOV     #(rfidBuf), R13                                 ;[2] load &rfidBuf[0] as dataPtr
+	MOV     #(3), R14                                       ;[2] error code and RN16
+	MOV     #ONE_BIT_CRC, R12                               ;[2]
+	CALLA   #crc16_ccitt                                    ;[5+12]
+
+	MOV.B   R12, &(rfidBuf+4)                               ;[4] store lower CRC byte first
+	SWPB    R12                                             ;[1] move upper byte into lower byte
+	MOV.B   R12, &(rfidBuf+3)                               ;[4] store upper CRC byte
+
+	MOV     #(5), R_scratch0                                ;[1] reply length: error code, RN16, CRC16
+	MOV     #(1), R_scratch1                                ;[1] header bit '1'
+
+;*************************************************************************************************************************************
+;	Shift the reply right by one bit to insert the header bit, then wait for the rest of the command and transmit.
+;	Entry: R_scratch0 = reply length in bytes, R_scratch1 = header bit
+;*************************************************************************************************************************************
+customReply:
+	PUSHM.A #1, R_scratch0                                  ;[3] keep the reply length for TxFM0
+
+	;Jump into the unrolled shift so that exactly length+1 bytes are rotated (the last one catches the final bit)
+	MOVA    #(customShiftEnd), R_scratch2                   ;[2]
+	SUBA    R_scratch0, R_scratch2                          ;[1] each RRC.B @Rn+ is one word
+	SUBA    R_scratch0, R_scratch2                          ;[1]
+	SUBA    #(2), R_scratch2                                ;[2]
+	MOV     #(rfidBuf), R_scratch0                          ;[2]
+	RRC     R_scratch1                                      ;[1] C = header bit (nothing below touches the flags)
+	BRA     R_scratch2                                      ;[3]
+
+	.loop   (CUSTOM_MAX_READ+6)
+	RRC.B   @R_scratch0+                                    ;[3]
+	.endloop
+customShiftEnd:
+
+	;Wait for All Bits to Come in: (3+LEN+2+2)*8
+	MOV.B   &(RWData.cuLen), R_scratch1                     ;[3]
+	ADD     #(7), R_scratch1                                ;[1]
+	RLAM    #(3), R_scratch1                                ;[1]
+
+customWaitOnBits_3:
+	CMP.W   R_scratch1, R_bits                              ;[1]
+	JLO     customWaitOnBits_3                              ;[2]
+
+	;Check if handle matched. It is in cmd[3+LEN], cmd[4+LEN].
+	MOV.B   &(RWData.cuLen), R_scratch2                     ;[3]
+	MOV.B   cmd+3(R_scratch2), R_scratch0                   ;[3]
+	SWPB    R_scratch0                                      ;[1]
+	MOV.B   cmd+4(R_scratch2), R_scratch1                   ;[3]
+	BIS     R_scratch1, R_scratch0                          ;[1]
+	CMP     R_scratch0, &rfid.handle                        ;[4]
+	JNE     customHandle_IgnorePop                          ;[2]
+
+	DINT                                                    ;[2]
+	NOP                                                     ;[1]
+	CLR     &TA0CTL                                         ;[4]
+
+	;TRANSMIT DELAY FOR TIMING
+	MOV     #TX_TIMING_CUSTOM, R_scratch0                   ;[1]
+
+timing_delay_for_Custom:
+	DEC     R_scratch0                                      ;[1] while((X--)>0);
+	CMP     #0XFFFF, R_scratch0                             ;[1] 'when X underflows'
+	JNE     timing_delay_for_Custom                         ;[2]
+
+	;TRANSMIT
+	MOV     #rfidBuf, R12                                   ;[2] load the &rfidBuf[0]
+	POPM.A  #1, R13                                         ;[2] recall the reply length (numBytes)
+	MOV     #1, R14                                         ;[1] load numBits=1
+	MOV.B   rfid.TRext, R15                                 ;[3] load TRext
+
+	CALLA   #TxFM0                                          ;[5] call the routine
+
+	CALLA   #RxClock                                        ;Switch to RxClock
+
+	BIC     #(GIE), SR                                      ;[1] don't need anymore bits, so turn off Rx_SM
+	NOP
+	CLR     &TA0CTL
+
+	;Header bit '1': the request was refused, nothing else to do
+	TST.B   &(rfidBuf)                                      ;[4]
+	JN      customHandle_Done                               ;[2]
+
+	;Bulk write: DATA is still in cmd[5..], move it out now that the reply is out
+	CMP.B   #(CUSTOM_SUB_WRITE), &(RWData.cuSub)            ;[4]
+	JNE     customHandle_SkipCopy                           ;[2]
+	MOV.B   &(RWData.cuCount), R_scratch0                   ;[3]
+	TST     R_scratch0                                      ;[1]
+	JZ      customHandle_SkipCopy                           ;[2]
+	MOV     &(RWData.cuWrPtr), R_scratch1                   ;[3]
+	ADD     &(RWData.cuOffset), R_scratch1                  ;[3] destination
+	MOV     #(cmd+5), R_scratch2                            ;[2] source
+
+customWrite_Copy:
+	MOV.B   @R_scratch2+, 0(R_scratch1)                     ;[5]
+	INC     R_scratch1                                      ;[1]
+	DEC     R_scratch0                                      ;[1]
+	JNZ     customWrite_Copy                                ;[2]
+
+customHandle_SkipCopy:
+	;Call user hook function if it's configured (if it's non-NULL)
+	CMP     #(0), &(RWData.cuHook)                          ;[]
+	JEQ     customHandle_SkipUserHook                       ;[]
+	MOV     &(RWData.cuHook), R_scratch0                    ;[]
+	CALLA   R_scratch0                                      ;[] Can mangle R12-R15
+
+customHandle_SkipUserHook:
+	;Post CUSTOM event if enabled
+	BIT.B   #(WISP_EVENT_CUSTOM), &(RWData.evtMask)         ;[]
+	JZ      customHandle_SkipHookCall                       ;[]
+	MOV     #(WISP_EVENT_CUSTOM), R12                       ;[]
+	CALLA   #RFID_postEvent                                 ;[] Can mangle R12-R15
+
+customHandle_SkipHookCall:
+	;Modify Abort Flag if necessary
+	BIT.B   #(CMD_ID_CUSTOM), (rfid.abortOn)                ;[] Should we abort on CUSTOM?
+	JZ      customHandle_Done                               ;[]
+	BIS.B   #1, (rfid.abortFlag)                            ;[] by setting this bit we'll abort correctly!
+
+customHandle_Done:
+	RETA
+
+customHandle_IgnorePop:
+	POPM.A  #1, R_scratch0                                  ;[] clean off the reply length
+
+customHandle_Ignore:
+	DINT                                                    ;[2]
+	NOP
+	CLR     &TA0CTL                                         ;[4]
+
+	CALLA   #RxClock                                        ;Switch to RxClock
+
+	RETA
+
+	.end
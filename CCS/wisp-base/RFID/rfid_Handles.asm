@@ -17,7 +17,7 @@
     .cdecls C,LIST, "../Math/crc16.h"
     .cdecls C,LIST, "rfid.h"
 	.def  handleQuery, handleAck, handleQR, handleQA, handleReqRN, handleSelect
-	.global TxClock, RxClock
+	.global TxClock, RxClock, RFID_postEvent, RAND_table
 
 
 ;/PRESERVED REGISTERS-----------------------------------------------------------------------------------------------------------------
@@ -82,17 +82,32 @@ QRTimingLoop:
 	MOV.B	rfid.TRext,	R15			;[3] load TRext
 	CALLA	#TxFM0					;[5] call the routine @us@todo: need to check RN16 in the future, fake TxFM0 in TX
 
-	;Call RN16 callback
-	MOV			&(RWData.rnHook), R_scratch0 ;[]
-
-	CALLA		R_scratch0			;[] Can mangle R12-R1
-
 	;Restore faster Rx Clock
 	;MOV		&(INFO_ADDR_RXUCS0), &UCSCTL0 ;[] switch to corr Rx Frequency
 	;MOV		&(INFO_ADDR_RXUCS1), &UCSCTL1 ;[] ""
 
 	CALLA #RxClock	;Switch to Rx Clock
 
+	.if WISP_BOOT_PROFILE
+	BIC			#(MC_3), &TA3CTL	;[] first reply is out, stop the boot profiler
+	.endif
+
+	INC			&(rfid.rnCount)		;[] link statistics: one more RN16 reply
+
+	;Call RN16 callback if it's configured (if it's non-NULL)
+	CMP			#(0), &(RWData.rnHook) ;[]
+	JEQ			QRSkipHookCall		;[]
+	MOV			&(RWData.rnHook), R_scratch0 ;[]
+	CALLA		R_scratch0			;[] Can mangle R12-R15
+
+QRSkipHookCall:
+	;Post RN16 event if enabled
+	BIT.B		#(WISP_EVENT_RN16), &(RWData.evtMask) ;[]
+	JZ			QRSkipEvent			;[]
+	MOV			#(WISP_EVENT_RN16), R12 ;[]
+	CALLA		#RFID_postEvent		;[] Can mangle R12-R15
+
+QRSkipEvent:
 	RETA
 
 
@@ -206,14 +221,14 @@ handleQuery:
 	;	-Random Seed will be prev RN16 with simple operation on it
 	;*********************************************************************************************************************************
 	;Generate psuedo-random #---------------------------------------------------------------------------------------------------------
-	;Grab a Random Value from Random Value Table in InfoB
+	;Grab a Random Value from the RN16 table (kept fresh by RAND_refill)
 	MOV.B	rfid.rn8_ind,	R_scratch0 ;[1] bring in rn8_ind
 	INC		R_scratch0				;[1] rn8_ind++
 	AND		#0x001F, 		R_scratch0 ;[1] modulo 32 on the ind
 	MOV.B	R_scratch0, 	&rfid.rn8_ind ;[4] store new rn8_ind
 
 	;Grab the RN8 (as a 16bit val) and use for RN16 and slotCount
-	ADD		#MEM_MAP_INFOB_START, R_scratch0 ;[] offset the index into the table
+	ADD		#RAND_table,	R_scratch0 ;[] offset the index into the table
 	MOV		@R_scratch0, 	R_scratch0 ;[] bring in random val (as int, grab some other byte too!)
 	MOV		R_scratch0,		&rfid.handle ;[] store the handle (don't store slotCount just yet!)
 
@@ -264,10 +279,26 @@ queryTimingLoop:
 	MOV.B	rfid.TRext,		R15		;[3] load TRext
 	CALLA	#TxFM0					;[5] call the routine
 
-	;Call RN16 callback
+	CALLA #RxClock	;Switch to RxClock before any hook runs
+
+	.if WISP_BOOT_PROFILE
+	BIC			#(MC_3), &TA3CTL	;[] first reply is out, stop the boot profiler
+	.endif
+
+	INC			&(rfid.rnCount)		;[] link statistics: one more RN16 reply
+
+	;Call RN16 callback if it's configured (if it's non-NULL)
+	CMP			#(0), &(RWData.rnHook) ;[]
+	JEQ			querySkipHookCall	;[]
 	MOV			&(RWData.rnHook), R_scratch0 ;[]
+	CALLA		R_scratch0			;[] Can mangle R12-R15
 
-	CALLA		R_scratch0			;[] Can mangle R12-R1
+querySkipHookCall:
+	;Post RN16 event if enabled
+	BIT.B		#(WISP_EVENT_RN16), &(RWData.evtMask) ;[]
+	JZ			doneQuery			;[]
+	MOV			#(WISP_EVENT_RN16), R12 ;[]
+	CALLA		#RFID_postEvent		;[] Can mangle R12-R15
 
 
 	;Restore faster Rx Clock
@@ -339,9 +370,10 @@ ackTimingLoop:
 	DEC		R5						;[1] Info stored in N: N = (R5<0)
 	JNZ		ackTimingLoop			;[2] Break out of loop on N
 
-	;Setup TxFM0
+	;Setup TxFM0 (13 cycles: the front buffer pointer costs 1 more than the old #dataBuf. That is below the
+	;5 cycle step of ackTimingLoop, so TX_TIMING_ACK stays and the reply starts 1 cycle (62.5ns) later.)
 	;TRANSMIT (16pre,38tillTxinTxFM0 -> 54cycles)
-	MOV		#dataBuf,	R12			;[2] load the &dataBuf[0]
+	MOV		&(RWData.EPCBankPtr), R12 ;[3] load the front EPC buffer (dataBuf, or dataBufAlt once swapped)
 	MOV		&(rfid.epcSize),R13		;[3]
 	ADD		R13, R13				;[1]
 	ADD		#(DATABUFF_MIN_SIZE), R13 ;[2]
@@ -359,13 +391,36 @@ ackTimingLoop:
 
 	CALLA #RxClock	;Switch to RxClock
 
+	;Link statistics: a second ACK with the same handle means the reader lost the EPC reply
+	INC			&(rfid.ackCount)	;[]
+	CMP			&(rfid.handle), &(rfid.ackHandle) ;[]
+	JNE			ackNewHandle		;[]
+	INC			&(rfid.ackRepeats)	;[]
+ackNewHandle:
+	MOV			&(rfid.handle), &(rfid.ackHandle) ;[]
+
+	;The reply may still get lost; endDoRFID confirms the ACK once the reader sends something else than another ACK.
+	TST.B		(rfid.epcQueued)	;[]
+	JZ			ackSkipEPCQueue		;[]
+	TST.B		(rfid.epcSwap)		;[] reply came from the buffer which is about to be replaced
+	JNZ			ackSkipEPCQueue		;[]
+	MOV.B		#TRUE, &(rfid.epcAckPending) ;[]
+
+ackSkipEPCQueue:
 	;Call user hook function if it's configured (if it's non-NULL)
-	CMP.B		#(0), &(RWData.akHook);[]
-	JEQ			ackSkipHookCall		;[]
+	CMP			#(0), &(RWData.akHook);[]
+	JEQ			ackSkipUserHook		;[]
 	MOV			&(RWData.akHook), R_scratch0 ;[]
 
 	CALLA		R_scratch0			;[] Can mangle R12-R15
 
+ackSkipUserHook:
+	;Post ACK event if enabled
+	BIT.B		#(WISP_EVENT_ACK), &(RWData.evtMask) ;[]
+	JZ			ackSkipHookCall		;[]
+	MOV			#(WISP_EVENT_ACK), R12 ;[]
+	CALLA		#RFID_postEvent		;[] Can mangle R12-R15
+
 ackSkipHookCall:
 	
 	;Modify Abort Flag if necessary (i.e. if in std_mode
@@ -423,14 +478,14 @@ decrementQ:
 	MOV.B	R_scratch0, &(rfid.Q)	;[] else move new Q value out
 
 QALoadNewSlot:
-	;Grab a Random Value from Random Value Table in InfoB
+	;Grab a Random Value from the RN16 table (kept fresh by RAND_refill)
 	MOV.B	rfid.rn8_ind,	R_scratch0 ;[1] bring in rn8_ind
 	INC		R_scratch0				;[1] rn8_ind++
 	AND		#0x001F, R_scratch0		;[1] modulo 32 on the ind
 	MOV.B	R_scratch0, 	&rfid.rn8_ind ;[4] store new rn8_ind
 
 	;Grab the RN8 (as a 16bit val) and use for RN16 and slotCount
-	ADD		#MEM_MAP_INFOB_START,	R_scratch0 ;[] offset the index into the table
+	ADD		#RAND_table,	R_scratch0 ;[] offset the index into the table
 	MOV		@R_scratch0, 	R_scratch0 ;[] bring in random val (as int, grab some other byte too!)
 
 	CLR		R_scratch2				;[1] load Rs0 with a empty mask
@@ -479,10 +534,28 @@ QATimingLoop:
 	;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;NO HIT
 	CALLA	#TxFM0					;[5] call the routine
 
-	;Call RN16 callback
+	CALLA #RxClock	;Switch to RxClock before any hook runs
+
+	.if WISP_BOOT_PROFILE
+	BIC			#(MC_3), &TA3CTL	;[] first reply is out, stop the boot profiler
+	.endif
+
+	INC			&(rfid.rnCount)		;[] link statistics: one more RN16 reply
+
+	;Call RN16 callback if it's configured (if it's non-NULL)
+	CMP			#(0), &(RWData.rnHook) ;[]
+	JEQ			QASkipHookCall		;[]
 	MOV			&(RWData.rnHook), R_scratch0 ;[]
+	CALLA		R_scratch0			;[] Can mangle R12-R15
+
+QASkipHookCall:
+	;Post RN16 event if enabled
+	BIT.B		#(WISP_EVENT_RN16), &(RWData.evtMask) ;[]
+	JZ			QASkipEvent			;[]
+	MOV			#(WISP_EVENT_RN16), R12 ;[]
+	CALLA		#RFID_postEvent		;[] Can mangle R12-R15
 
-	CALLA		R_scratch0			;[] Can mangle R12-R1
+QASkipEvent:
 
 	;Restore faster Rx Clock
 	;MOV		&(INFO_ADDR_RXUCS0), &UCSCTL0 ;[] switch to corr Rx Frequency
@@ -516,14 +589,14 @@ handleReqRN:
 	CMP		(rfid.handle), R_scratch1 ;[]
 	JNE		reqRN_badHandle			;[]
 
-	;Generate a new handle! (Grab a Random Value from Random Value Table in InfoB)
+	;Generate a new handle! (Grab a Random Value from the RN16 table)
 	MOV.B	rfid.rn8_ind,	R_scratch0 ;[1] bring in rn8_ind
 	INC		R_scratch0				;[1] rn8_ind++ (why?? This doesn't appear to change behavior)
 	AND		#0x001F, R_scratch0		;[1] modulo 32 on the ind
 	MOV.B	R_scratch0, 	&rfid.rn8_ind ;[4] store new rn8_ind
 
 	;Grab the RN8 (as a 16bit val) and use for RN16 and slotCount
-	ADD		#INFO_WISP_RAND_TBL,	R_scratch0 ;[] offset the index into the table
+	ADD		#RAND_table,	R_scratch0 ;[] offset the index into the table
 	MOV		@R_scratch0,	R_scratch0
 	MOV		R_scratch0,		&rfid.handle ;[] store the new handle!
 
@@ -710,10 +783,11 @@ handleSelect:
 	;	-so when comparing mask to lower EPC bits, one of them has to be SWPB first. Lowest cycle count would be to SWPB on R_scratch0
 	;*********************************************************************************************************************************
 	;Does the Mask Match Lower EPC Bits?
-	CLR		R_scratch1				;[] prep scratch1 for the comparison result
 	SWPB	R_scratch0				;[] prep Mask for comparison to lower EPC Bits
 
-	CMP		(dataBuf+2),	R_scratch0 ;[] do they match? (Z = matches)
+	MOV		&(RWData.EPCBankPtr), R_scratch1 ;[] front EPC buffer
+	CMP		2(R_scratch1),	R_scratch0 ;[] do they match? (Z = matches)
+	MOV		#FALSE,			R_scratch1 ;[] prep scratch1 for the comparison result (MOV keeps Z)
 	JNZ		skipAssertingFlag
 	MOV		#TRUE,			R_scratch1 ;[] else assert the flag
 skipAssertingFlag:
@@ -55,7 +55,7 @@ R_scratch1  .set R14
 
    	.ref cmd
 	.def  handleRead
-	.global RxClock, TxClock
+	.global RxClock, TxClock, RFID_postEvent
 	.sect ".text"
    
 ;	extern void handleRead (uint8_t handle);
@@ -129,10 +129,9 @@ offSetByWordPtr:
 	RLC.B	R14						;[1] pull out b7 from R14 (wordCt.b0)
 	RLC.B	R15						;[1] shove it into R15 at bottom (wordCt.b0)
 	MOV.B	R15, R15				;[1] mask wordPtr to just lower 8 bits
+	MOV.B	R15,	&(RWData.wordPtr)	;[4] store the wordPtr
 	RLA		R15						;[1] multiply by two (now is byte addr)
 	ADD.W	R15, R_readPtr			;[1] calculate final memBank Pointer!! that took a lot of effort in assembly X(...
-	
-	MOV.W	R_readPtr,	&(RWData.wordPtr)
 
 	;exit: R15 and R14 open for use. R12 restricted. memBankPtr is setup for transfer into rfidBuf. automatically
 
@@ -214,8 +213,8 @@ offSetByWordPtr:
 ;			Entry Timing: 29 cycles remaining before end of Rx Byte 4											 					 *
 ;			Exit Timing:  40%*600cyc-13cyc --> 227 cycles remaining before end of Rx Byte 5											 *
 ;************************************************************************************************************************************/
-	;Now wait for wordPtr to come in, and off R_readPtr by it. R15 is unused, R14 is held.
-	;Wait for Enough Bits to Come in(2+8+8+8+8) (first four bytes come in, then wordPtr is in cmd[2].b5-b0 | cmd[3].b7b6
+	;Now wait for wordCt to come in. wordPtr was already stored to RWData.wordPtr in [1/8] (only the one-byte EBV form is parsed).
+	;Wait for Enough Bits to Come in(2+8+8+8+8) (first four bytes come in, then wordCt is in cmd[2].b5-b0 | cmd[3].b7b6
 waitOnBits_2:
 	MOV.W	R5,	R15					;[1]
 	CMP.W	#32, R15				;[1] while(bits<34)
@@ -409,11 +408,18 @@ readHandle_exit:
 
 
 	;Call user hook function if it's configured (if it's non-NULL)
-	CMP.B		#(0), &(RWData.rdHook) ;[]
-	JEQ			readHandle_SkipHookCall ;[]
+	CMP			#(0), &(RWData.rdHook) ;[]
+	JEQ			readHandle_SkipUserHook ;[]
 	MOV			&(RWData.rdHook), R_scratch0 ;[]
 	CALLA		R_scratch0			;[]
 
+readHandle_SkipUserHook:
+	;Post READ event if enabled
+	BIT.B		#(WISP_EVENT_READ), &(RWData.evtMask) ;[]
+	JZ			readHandle_SkipHookCall ;[]
+	MOV			#(WISP_EVENT_READ), R12 ;[]
+	CALLA		#RFID_postEvent		;[] Can mangle R12-R15
+
 readHandle_SkipHookCall:
 
 	;Modify Abort Flag if necessary (i.e. if in std_mode
@@ -26,7 +26,7 @@ R_scratch0	.set  R15
 
 	.ref cmd,memBank_RES			;[0] declare TACCR1
 	.def  handleWrite
-	.global RxClock, TxClock
+	.global RxClock, TxClock, RFID_postEvent, RFID_queueWrite
 	.sect ".text"
 
 ;	extern void handleWrite (uint8_t handle);
@@ -148,6 +148,11 @@ waitOnBits_3:
 
 	POPM.A	#1,	R13					;[] now data^RN16 is in R13
 	XOR		R14, R13				;[] unXOR data & RN16 to reveal actual data value
+
+	;Downlink queue full? Then the reader gets an error code instead, and the write is dropped
+	BIT.B	#(CMD_ID_WRITE), &(RWData.dlFull) ;[]
+	JNZ		writeHandle_ErrorReply	;[]
+
 	MOV		R13,	&(RWData.wrData);[] move the data out
 
 ;Load the Reply Buffer (rfidBuf)
@@ -177,6 +182,7 @@ waitOnBits_3:
 	RRC.B	(rfidBuf+2)
 	RRC.B	(rfidBuf+3)
 	RRC.B	(rfidBuf+4)
+	MOV		#(4),		R14			;[1] reply length in bytes (after the header bit)
 
 	;------------WAIT FOR FINAL BITS, THEN TRANSMIT-----------------------------------------------------------------------------------
 waitOnBits_4:
@@ -201,7 +207,7 @@ timing_delay_for_Write:
 
 	;TRANSMIT (16pre,38tillTxinTxFM0 -> 54cycles)
 	MOV		#rfidBuf, 	R12			;[2] load the &rfidBuf[0]
-	MOV		#(4),		R13			;[1] load into corr reg (numBytes)
+	MOV		R14,		R13			;[1] load into corr reg (numBytes)
 	MOV		#1,			R14			;[1] load numBits=1
 	MOV.B	#TREXT_ON,	R15			;[3] load TRext (write always uses trext=1. wtf)
 
@@ -222,12 +228,28 @@ timing_delay_for_Write:
 	NOP
 	CLR		&TA0CTL
 
+	;Queue the write for the application (or count it as rejected if the reply was an error code)
+	BIT.B		#(CMD_ID_WRITE), &(RWData.dlMask) ;[]
+	JZ			writeHandle_SkipDownlink ;[]
+	MOV			#(CMD_ID_WRITE), R12 ;[]
+	CALLA		#RFID_queueWrite	;[] Can mangle R12-R15
+	TST.B		R12					;[] FAIL: rejected, nothing else to report
+	JZ			writeHandle_Done	;[]
+
+writeHandle_SkipDownlink:
 	;Call user hook function if it's configured (if it's non-NULL)
-	CMP.B		#(0), &(RWData.wrHook);[]
-	JEQ			writeHandle_SkipHookCall ;[]
+	CMP			#(0), &(RWData.wrHook);[]
+	JEQ			writeHandle_SkipUserHook ;[]
 	MOV			&(RWData.wrHook), R_scratch0 ;[]
 	CALLA		R_scratch0			;[]
 
+writeHandle_SkipUserHook:
+	;Post WRITE event if enabled
+	BIT.B		#(WISP_EVENT_WRITE), &(RWData.evtMask) ;[]
+	JZ			writeHandle_SkipHookCall ;[]
+	MOV			#(WISP_EVENT_WRITE), R12 ;[]
+	CALLA		#RFID_postEvent		;[] Can mangle R12-R15
+
 writeHandle_SkipHookCall:
 
 	;Modify Abort Flag if necessary (i.e. if in std_mode
@@ -239,8 +261,41 @@ writeHandle_SkipHookCall:
 writeHandle_BreakOutofRFID:
 
 	BIS.B		#1, (rfid.abortFlag);[] by setting this bit we'll abort correctly!
+
+writeHandle_Done:
 	RETA
 
+;Error reply: header bit '1', error code, RN16, CRC16 (41 bits). Rejoins the normal path to wait for the final bits.
+writeHandle_ErrorReply:
+	MOV.B	#(GEN2_ERR_OTHER), &(rfidBuf) ;[4] load the error code
+	MOV		(rfid.handle), 	R_scratch0;[3] bring in the RN16
+	SWPB	R_scratch0				;[1] MSByte first
+	MOV.B	R_scratch0, &(rfidBuf+1);[4]
+	SWPB	R_scratch0				;[1]
+	MOV.B	R_scratch0, &(rfidBuf+2);[4]
+
+	;Calc CRC16! (careful, it will clobber R11-R15)
+	MOV		#(rfidBuf),		R13		;[2] load &rfidBuf[0] as dataPtr
+	MOV		#(3),			R14		;[2] error code and RN16
+
+	MOV 	#ONE_BIT_CRC, R12 		;[1]
+
+	CALLA	#crc16_ccitt			;[5+196]
+
+	MOV.B	R12,	&(rfidBuf+4)	;[4] store lower CRC byte first
+	SWPB	R12						;[1] move upper byte into lower byte
+	MOV.B	R12,	&(rfidBuf+3)	;[4] store upper CRC byte
+
+	SETC							;[1] header bit '1'
+	RRC.B	(rfidBuf)
+	RRC.B	(rfidBuf+1)
+	RRC.B	(rfidBuf+2)
+	RRC.B	(rfidBuf+3)
+	RRC.B	(rfidBuf+4)
+	RRC.B	(rfidBuf+5)
+	MOV		#(5),		R14			;[1] reply length in bytes (after the header bit)
+	JMP		waitOnBits_4
+
 writeHandle_Ignore:
 	DINT							;[2]
 	NOP
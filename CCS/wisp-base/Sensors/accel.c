@@ -1,6 +1,16 @@
 /**
  * Driver for the ADXL362 accelerometer
  *
+ * Besides single reads, the driver can stream: the ADXL362 collects samples
+ *  in its FIFO and raises INT1 once a watermark is reached; the INT1 interrupt
+ *  then drains the watermark in one SPI burst into a caller-owned sample
+ *  buffer.
+ *
+ * The activity/inactivity detector runs in loop mode: the part tracks on its
+ *  own whether it is moving, optionally dropping to its wake-up mode while it
+ *  is not (autosleep), and shows the AWAKE state on INT2. WISP_waitForMotion()
+ *  sleeps in LPM4 until INT2 rises. This module owns PORT3_VECTOR.
+ *
  * @author Aaron Parks
  * @date Aug 2013
  */
@@ -9,6 +19,7 @@
 #include "../globals.h"
 #include "../Timing/timer.h"
 #include "../wired/spi.h"
+#include "../util/ringbuf.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -27,8 +38,71 @@ uint8_t const ADXL_CONFIG_INTERRUPT[] = {ADXL_CMD_WRITE_REG,ADXL_REG_INTMAP1,0X0
 
 uint8_t const ADXL_CONFIG_FIFO_CTL[] = {ADXL_CMD_WRITE_REG,ADXL_REG_FIFO_CONTROL,0X0A}; // FIFO in stream mode
 uint8_t const ADXL_CONFIG_FIFO_SAMPLE[] = {ADXL_CMD_WRITE_REG,ADXL_REG_FIFO_SAMPLES,6}; // 1*6 data to be stored in FIFO
+uint8_t const ADXL_CONFIG_FIFO_OFF[] = {ADXL_CMD_WRITE_REG,ADXL_REG_FIFO_CONTROL,ADXL_FIFO_MODE_OFF};
+uint8_t const ADXL_CONFIG_INT1_OFF[] = {ADXL_CMD_WRITE_REG,ADXL_REG_INTMAP1,0x00};
+uint8_t const ADXL_READ_FIFO_BURST[1 + 6*ACCEL_FIFO_MAX_SETS] = {ADXL_CMD_READ_FIFO}; // Rest is fill
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * State variables for FIFO streaming
+ */
+static struct {
+    RINGBUF_t samples; // Caller's sample buffer
+    uint16_t dropped; // Samples lost because the buffer was full
+    SPI_job_t job; // FIFO burst read
+    uint8_t raw[1 + 6*ACCEL_FIFO_MAX_SETS]; // Command echo, then two bytes per FIFO entry
+    threeAxis_t_12 cur; // Sample being assembled from FIFO entries
+    uint8_t axes; // Axes of cur filled so far, bit n for axis n
+    BOOL isStreaming;
+    BOOL isMotionDetect; // Is the activity/inactivity detector running?
+    uint8_t powerCtl; // POWER_CTL value while measuring
+    uint8_t actInactCtl; // Threshold reference bits for ACT_INACT_CTL
+    volatile BOOL isBursting; // Is the burst job queued or running?
+    volatile BOOL isSleeping; // Main loop sleeps in ACCEL_waitForSamples()
+} ACCEL_SM;
+
+static void ACCEL_burstDone(void);
+
+/**
+ * Run one chip-select framed command through the SPI job queue and wait for
+ *  it. The response lands in gpRxBuf.
+ */
+static BOOL ACCEL_transfer(uint8_t const* cmd, uint16_t size) {
+    SPI_job_t job;
+
+    SPI_initJob(&job, &POUT_ACCEL_CS, PIN_ACCEL_CS, (uint8_t*)cmd, gpRxBuf, size, 0);
+
+    if(!SPI_submit(&job))
+        return FAIL;
+
+    SPI_waitForJob(&job);
+    return SUCCESS;
+}
+
+/**
+ * Write one ADXL362 register
+ */
+static BOOL ACCEL_writeReg(uint8_t reg, uint8_t value) {
+    uint8_t cmd[3];
+
+    cmd[0] = ADXL_CMD_WRITE_REG;
+    cmd[1] = reg;
+    cmd[2] = value;
+
+    return ACCEL_transfer(cmd, sizeof(cmd));
+}
+
+/**
+ * Back to measurement after reconfiguring in standby, keeping autosleep if
+ *  the motion detector asked for it.
+ */
+static BOOL ACCEL_measure(void) {
+    if (ACCEL_SM.isMotionDetect)
+        return ACCEL_writeReg(ADXL_REG_POWER_CTL, ACCEL_SM.powerCtl);
+
+    return ACCEL_transfer(ADXL_CONFIG_MEAS, sizeof(ADXL_CONFIG_MEAS));
+}
+
 /**
  * Turn on and start up the ADXL362 accelerometer. This leaves the ADXL running.
  */
@@ -36,17 +110,12 @@ uint8_t const ADXL_CONFIG_FIFO_SAMPLE[] = {ADXL_CMD_WRITE_REG,ADXL_REG_FIFO_SAMP
 BOOL ACCEL_reset() {
 
     // TODO Figure out optimal ADXL configuration for single measurement
-    while(!SPI_acquirePort());
     //BITSET(POUT_ACCEL_EN, PIN_ACCEL_EN);
     //BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
 
     //TODO find the proper length of delay
 
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_CONFIG_RESET, sizeof(ADXL_CONFIG_RESET));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
-
-    SPI_releasePort();
+    ACCEL_transfer(ADXL_CONFIG_RESET, sizeof(ADXL_CONFIG_RESET));
 
     //__delay_cycles(5000);
 
@@ -59,17 +128,12 @@ BOOL ACCEL_reset() {
 BOOL ACCEL_range() {
 
     // TODO Figure out optimal ADXL configuration for single measurement
-    while(!SPI_acquirePort());
     //BITSET(POUT_ACCEL_EN, PIN_ACCEL_EN);
     //BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
 
     //TODO find the proper length of delay
 
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_CONFIG_FILTER, sizeof(ADXL_CONFIG_FILTER));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
-
-    SPI_releasePort();
+    ACCEL_transfer(ADXL_CONFIG_FILTER, sizeof(ADXL_CONFIG_FILTER));
 
     //__delay_cycles(5000);
 
@@ -83,15 +147,12 @@ BOOL ACCEL_range() {
 BOOL ACCEL_initialize() {
 
     // TODO Figure out optimal ADXL configuration for single measurement
-    while(!SPI_acquirePort());
     //BITSET(POUT_ACCEL_EN, PIN_ACCEL_EN);
     //BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
 
     //TODO find the proper length of delay
 
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_CONFIG_MEAS, sizeof(ADXL_CONFIG_MEAS));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
+    ACCEL_transfer(ADXL_CONFIG_MEAS, sizeof(ADXL_CONFIG_MEAS));
 //    __delay_cycles(10);
 //    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
 //    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_CONFIG_INTERRUPT, sizeof(ADXL_CONFIG_INTERRUPT));
@@ -105,8 +166,6 @@ BOOL ACCEL_initialize() {
 //    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_CONFIG_FIFO_SAMPLE, sizeof(ADXL_CONFIG_FIFO_SAMPLE));
 //    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
 
-    SPI_releasePort();
-
     //__delay_cycles(5000);
 
     //Timer_LooseDelay(LP_LSDLY_200MS);// To let ADXL start measuring? How much time is actually required here, if any?
@@ -118,15 +177,8 @@ BOOL ACCEL_initialize() {
 BOOL ACCEL_initialize_withoutWait() {
 
     // TODO Figure out optimal ADXL configuration for single measurement
-    while(!SPI_acquirePort());
     //BITSET(POUT_ACCEL_EN, PIN_ACCEL_EN);
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_CONFIG_MEAS, sizeof(ADXL_CONFIG_MEAS));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
-
-    SPI_releasePort();
+    ACCEL_transfer(ADXL_CONFIG_MEAS, sizeof(ADXL_CONFIG_MEAS));
 
     //Timer_LooseDelay(LP_LSDLY_200MS);// To let ADXL start measuring? How much time is actually required here, if any?
 
@@ -135,13 +187,11 @@ BOOL ACCEL_initialize_withoutWait() {
 }
 
 /**
- * Put the ADXL362 into a lower power standby state without gating power
- *
- * @todo Implement this function
+ * Put the ADXL362 into a lower power standby state without gating power.
+ *  Streaming and motion detection pause until the part measures again.
  */
 void ACCEL_standby() {
-
-
+    ACCEL_transfer(ADXL_CONFIG_STBY, sizeof(ADXL_CONFIG_STBY));
 }
 
 /**
@@ -150,13 +200,7 @@ void ACCEL_standby() {
 
 BOOL ACCEL_singleSample_FIFO(threeAxis_t_8* result) {
 
-    while(!SPI_acquirePort());
-
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_READ_XYZ_16BIT_FIFO, sizeof(ADXL_READ_XYZ_16BIT_FIFO));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
-
-    SPI_releasePort();
+    ACCEL_transfer(ADXL_READ_XYZ_16BIT_FIFO, sizeof(ADXL_READ_XYZ_16BIT_FIFO));
 
     result->x = ((gpRxBuf[2] & 0x0F) << 4)|((gpRxBuf[1] & 0xF0) >> 4);
     result->y = ((gpRxBuf[4] & 0x0F) << 4)|((gpRxBuf[3] & 0xF0) >> 4);
@@ -167,13 +211,7 @@ BOOL ACCEL_singleSample_FIFO(threeAxis_t_8* result) {
 
 BOOL ACCEL_singleSample(threeAxis_t_8* result) {
 
-    while(!SPI_acquirePort());
-
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_READ_XYZ_8BIT, sizeof(ADXL_READ_XYZ_8BIT));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
-
-    SPI_releasePort();
+    ACCEL_transfer(ADXL_READ_XYZ_8BIT, sizeof(ADXL_READ_XYZ_8BIT));
 
     result->x = gpRxBuf[2];
     result->y = gpRxBuf[3];
@@ -184,30 +222,350 @@ BOOL ACCEL_singleSample(threeAxis_t_8* result) {
 
 BOOL ACCEL_readStat(threeAxis_t_8* result) {
 
-    while(!SPI_acquirePort());
+    ACCEL_transfer(ADXL_REAsxD_STATUS, sizeof(ADXL_REAsxD_STATUS));
 
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_REAsxD_STATUS, sizeof(ADXL_REAsxD_STATUS));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
+    result->x = gpRxBuf[2];
 
-    SPI_releasePort();
+    return SUCCESS;
+}
+
+BOOL ACCEL_readID(threeAxis_t_8* result) {
+
+    ACCEL_transfer(ADXL_READ_DEVID, sizeof(ADXL_READ_DEVID));
 
     result->x = gpRxBuf[2];
 
     return SUCCESS;
 }
 
-BOOL ACCEL_readID(threeAxis_t_8* result) {
+//----------------------------------------------------------------------------
 
-    while(!SPI_acquirePort());
+/**
+ * Queue the FIFO burst read, unless it is running already.
+ *
+ * @pre interrupts are disabled
+ */
+static void ACCEL_startBurst(void) {
+    if (ACCEL_SM.isBursting)
+        return;
 
-    BITCLR(POUT_ACCEL_CS, PIN_ACCEL_CS);
-    SPI_transaction(gpRxBuf, (uint8_t*)ADXL_READ_DEVID, sizeof(ADXL_READ_DEVID));
-    BITSET(POUT_ACCEL_CS, PIN_ACCEL_CS);
+    ACCEL_SM.isBursting = TRUE;
+    SPI_submit(&ACCEL_SM.job);
+}
 
-    SPI_releasePort();
+/**
+ * Completion callback of the burst job. Sorts the FIFO entries into samples
+ *  by their axis tag, so a read which starts mid-set can't shift the axes.
+ */
+static void ACCEL_burstDone(void) {
+    uint16_t i;
+    uint16_t entry;
+    int16_t value;
+
+    for (i = 1; i + 1 < ACCEL_SM.job.size; i += 2) {
+        entry = ACCEL_SM.raw[i] | ((uint16_t) ACCEL_SM.raw[i + 1] << 8);
+        value = (int16_t) (entry << 4) >> 4;
+
+        switch (entry >> ADXL_FIFO_AXIS_SHIFT) {
+        case ADXL_FIFO_AXIS_X:
+            ACCEL_SM.cur.x = value;
+            ACCEL_SM.axes = BIT0;
+            break;
+        case ADXL_FIFO_AXIS_Y:
+            ACCEL_SM.cur.y = value;
+            ACCEL_SM.axes |= BIT1;
+            break;
+        case ADXL_FIFO_AXIS_Z:
+            ACCEL_SM.cur.z = value;
+            if (ACCEL_SM.axes == (BIT0 | BIT1)) {
+                if (!RINGBUF_put(&ACCEL_SM.samples, &ACCEL_SM.cur))
+                    ACCEL_SM.dropped++;
+            }
+            ACCEL_SM.axes = 0;
+            break;
+        default: // Temperature
+            break;
+        }
+    }
+
+    ACCEL_SM.isBursting = FALSE;
+
+    // More samples came in meanwhile; the edge of INT1 may be gone already
+    if (ACCEL_SM.isStreaming && (PACCEL_INT1IN & PIN_ACCEL_INT1))
+        ACCEL_startBurst();
+}
 
-    result->x = gpRxBuf[2];
+/**
+ * Start FIFO streaming. The ADXL362 must be powered and SPI initialized, and
+ *  the sample rate is whatever ACCEL_range() set up. Call from the main loop;
+ *  the configuration is written with blocking transfers.
+ *
+ * The buffer may live in RAM or, for samples which have to survive a power
+ *  loss, in FRAM (#pragma PERSISTENT).
+ *
+ * @param buf sample buffer, owned by the caller
+ * @param capacity number of samples in buf, must be a power of two
+ * @param watermark XYZ sets per burst, 1 to ACCEL_FIFO_MAX_SETS
+ * @return SUCCESS, or FAIL if a parameter is out of range
+ *
+ * @note Bursts are started from the INT1 interrupt. If the CPU sleeps deeper
+ *  than LPM0 meanwhile (other than in ACCEL_waitForSamples()), SMCLK and MCLK
+ *  requests must stay enabled in CSCTL6 for the transfer to run.
+ */
+BOOL ACCEL_startStream(threeAxis_t_12* buf, uint16_t capacity, uint8_t watermark) {
+    uint16_t entries = 3 * (uint16_t) watermark;
+
+    if ((watermark == 0) || (watermark > ACCEL_FIFO_MAX_SETS))
+        return FAIL;
+
+    ACCEL_stopStream();
+
+    if (!RINGBUF_init(&ACCEL_SM.samples, buf, capacity, sizeof(threeAxis_t_12)))
+        return FAIL;
+
+    ACCEL_SM.dropped = 0;
+    ACCEL_SM.axes = 0;
+    SPI_initJob(&ACCEL_SM.job, &POUT_ACCEL_CS, PIN_ACCEL_CS, (uint8_t*)ADXL_READ_FIFO_BURST,
+            ACCEL_SM.raw, 1 + 2 * entries, &ACCEL_burstDone);
+
+    // Reconfigure the FIFO in standby, which also empties it
+    ACCEL_transfer(ADXL_CONFIG_STBY, sizeof(ADXL_CONFIG_STBY));
+
+    ACCEL_writeReg(ADXL_REG_FIFO_SAMPLES, (uint8_t) entries);
+    ACCEL_writeReg(ADXL_REG_FIFO_CONTROL,
+            ADXL_FIFO_MODE_STREAM | ((entries > 0xFF) ? ADXL_FIFO_AH : 0));
+    ACCEL_writeReg(ADXL_REG_INTMAP1, ADXL_INT_FIFO_WATERMARK); // Active high
+
+    // INT1 as a rising edge interrupt
+    BITCLR(PDIR_ACCEL_INT1, PIN_ACCEL_INT1);
+    BITCLR(PACCEL_INT1SEL0, PIN_ACCEL_INT1);
+    BITCLR(PACCEL_INT1SEL1, PIN_ACCEL_INT1);
+    BITCLR(PACCEL_INT1IES, PIN_ACCEL_INT1);
+    BITCLR(PACCEL_INT1IFG, PIN_ACCEL_INT1);
+    ACCEL_SM.isStreaming = TRUE;
+    BITSET(PACCEL_INT1IE, PIN_ACCEL_INT1);
+
+    ACCEL_measure();
+
+    return SUCCESS;
+}
+
+/**
+ * Stop FIFO streaming. A running burst is finished first; samples still in
+ *  the buffer can be read afterwards.
+ */
+void ACCEL_stopStream(void) {
+    if (!ACCEL_SM.isStreaming)
+        return;
+
+    BITCLR(PACCEL_INT1IE, PIN_ACCEL_INT1);
+    ACCEL_SM.isStreaming = FALSE;
+
+    if (ACCEL_SM.isBursting)
+        SPI_waitForJob(&ACCEL_SM.job);
+
+    ACCEL_transfer(ADXL_CONFIG_INT1_OFF, sizeof(ADXL_CONFIG_INT1_OFF));
+    ACCEL_transfer(ADXL_CONFIG_FIFO_OFF, sizeof(ADXL_CONFIG_FIFO_OFF));
+}
+
+/**
+ * Take the oldest streamed sample.
+ *
+ * @return SUCCESS, or FAIL if no sample is buffered
+ */
+BOOL ACCEL_getSample(threeAxis_t_12* result) {
+    return RINGBUF_get(&ACCEL_SM.samples, result);
+}
+
+/**
+ * Return the number of buffered samples which ACCEL_getSample() can take.
+ */
+uint16_t ACCEL_samplesAvailable(void) {
+    return RINGBUF_count(&ACCEL_SM.samples);
+}
+
+/**
+ * Return the number of streamed samples lost because the buffer was full.
+ */
+uint16_t ACCEL_samplesDropped(void) {
+    return ACCEL_SM.dropped;
+}
+
+/**
+ * Sleep until streamed samples are buffered. Waits in LPM3 for the watermark
+ *  interrupt and in LPM0 while the burst runs. Returns right away if samples
+ *  are buffered already or streaming is off.
+ */
+void ACCEL_waitForSamples(void) {
+    __disable_interrupt();
+
+    while (ACCEL_SM.isStreaming && RINGBUF_isEmpty(&ACCEL_SM.samples)) {
+        if (ACCEL_SM.isBursting) {
+            __enable_interrupt();
+            SPI_waitForJob(&ACCEL_SM.job);
+        } else {
+            ACCEL_SM.isSleeping = TRUE;
+            __bis_SR_register(LPM3_bits | GIE);
+        }
+        __disable_interrupt();
+    }
+    ACCEL_SM.isSleeping = FALSE;
+
+    __enable_interrupt();
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Set up activity detection: the part counts as moving once the acceleration
+ *  stays above the threshold for the given number of samples. Takes effect
+ *  with the next ACCEL_startMotionDetect().
+ *
+ * @param threshold in LSBs of the current range (1mg at +-2g), at most 0x7FF
+ * @param time samples above the threshold, at the output data rate
+ * @param isReferenced TRUE to compare against the acceleration at the last
+ *  state change (ignores gravity and mounting), FALSE for absolute values
+ * @return SUCCESS, or FAIL if the threshold is out of range
+ */
+BOOL ACCEL_setActivity(uint16_t threshold, uint8_t time, BOOL isReferenced) {
+    if (threshold > ADXL_THRESH_MAX)
+        return FAIL;
+
+    ACCEL_writeReg(ADXL_REG_THRESH_ACT_L, (uint8_t) threshold);
+    ACCEL_writeReg(ADXL_REG_THRESH_ACT_H, (uint8_t) (threshold >> 8));
+    ACCEL_writeReg(ADXL_REG_TIME_ACT, time);
+
+    if (isReferenced)
+        ACCEL_SM.actInactCtl |= ADXL_ACT_REF;
+    else
+        ACCEL_SM.actInactCtl &= ~ADXL_ACT_REF;
 
     return SUCCESS;
 }
+
+/**
+ * Set up inactivity detection: the part counts as still once the acceleration
+ *  stays below the threshold for the given number of samples.
+ *
+ * @param threshold in LSBs of the current range (1mg at +-2g), at most 0x7FF
+ * @param time samples below the threshold, at the output data rate
+ * @param isReferenced TRUE for a referenced threshold, FALSE for absolute
+ * @return SUCCESS, or FAIL if the threshold is out of range
+ */
+BOOL ACCEL_setInactivity(uint16_t threshold, uint16_t time, BOOL isReferenced) {
+    if (threshold > ADXL_THRESH_MAX)
+        return FAIL;
+
+    ACCEL_writeReg(ADXL_REG_THRESH_INACT_L, (uint8_t) threshold);
+    ACCEL_writeReg(ADXL_REG_THRESH_INACT_H, (uint8_t) (threshold >> 8));
+    ACCEL_writeReg(ADXL_REG_TIME_INACT_L, (uint8_t) time);
+    ACCEL_writeReg(ADXL_REG_TIME_INACT_H, (uint8_t) (time >> 8));
+
+    if (isReferenced)
+        ACCEL_SM.actInactCtl |= ADXL_INACT_REF;
+    else
+        ACCEL_SM.actInactCtl &= ~ADXL_INACT_REF;
+
+    return SUCCESS;
+}
+
+/**
+ * Start the activity/inactivity detector in loop mode and route its AWAKE
+ *  state to INT2 (P3.6). Leaves the ADXL362 measuring. Set the thresholds
+ *  with ACCEL_setActivity() and ACCEL_setInactivity() first.
+ *
+ * @param isAutosleep TRUE to let the part drop to its ~270nA wake-up mode
+ *  while still; it only samples at about 6Hz then, so streaming slows down too
+ */
+void ACCEL_startMotionDetect(BOOL isAutosleep) {
+    ACCEL_transfer(ADXL_CONFIG_STBY, sizeof(ADXL_CONFIG_STBY));
+
+    ACCEL_writeReg(ADXL_REG_ACT_INACT_CTL,
+            ADXL_ACT_EN | ADXL_INACT_EN | ADXL_ACT_LOOP | ACCEL_SM.actInactCtl);
+    ACCEL_writeReg(ADXL_REG_INTMAP2, ADXL_INT_AWAKE); // Active high
+
+    // INT2 as a rising edge interrupt
+    BITCLR(PDIR_ACCEL_INT2, PIN_ACCEL_INT2);
+    BITCLR(PACCEL_INT2SEL0, PIN_ACCEL_INT2);
+    BITCLR(PACCEL_INT2SEL1, PIN_ACCEL_INT2);
+    BITCLR(PACCEL_INT2IES, PIN_ACCEL_INT2);
+    BITCLR(PACCEL_INT2IFG, PIN_ACCEL_INT2);
+    BITSET(PACCEL_INT2IE, PIN_ACCEL_INT2);
+
+    ACCEL_SM.powerCtl = ADXL_POWER_MEASURE | (isAutosleep ? ADXL_POWER_AUTOSLEEP : 0);
+    ACCEL_SM.isMotionDetect = TRUE;
+    ACCEL_measure();
+}
+
+/**
+ * Stop the activity/inactivity detector. The ADXL362 keeps measuring.
+ */
+void ACCEL_stopMotionDetect(void) {
+    if (!ACCEL_SM.isMotionDetect)
+        return;
+
+    BITCLR(PACCEL_INT2IE, PIN_ACCEL_INT2);
+    ACCEL_SM.isMotionDetect = FALSE;
+
+    ACCEL_transfer(ADXL_CONFIG_STBY, sizeof(ADXL_CONFIG_STBY));
+    ACCEL_writeReg(ADXL_REG_INTMAP2, 0x00);
+    ACCEL_writeReg(ADXL_REG_ACT_INACT_CTL, 0x00);
+    ACCEL_measure();
+}
+
+/**
+ * @return TRUE while the motion detector sees the part as moving
+ */
+BOOL ACCEL_isMoving(void) {
+    return (ACCEL_SM.isMotionDetect && (PACCEL_INT2IN & PIN_ACCEL_INT2)) ? TRUE : FALSE;
+}
+
+/**
+ * Sleep in LPM4 until the accelerometer detects motion. Returns right away if
+ *  it is moving already. Timer alarms don't run meanwhile.
+ *
+ * @return SUCCESS, or FAIL if the motion detector is not running
+ */
+BOOL WISP_waitForMotion(void) {
+    if (!ACCEL_SM.isMotionDetect)
+        return FAIL;
+
+    __disable_interrupt();
+
+    while (!(PACCEL_INT2IN & PIN_ACCEL_INT2)) {
+        ACCEL_SM.isSleeping = TRUE;
+        __bis_SR_register(LPM4_bits | GIE);
+        __disable_interrupt();
+    }
+    ACCEL_SM.isSleeping = FALSE;
+
+    __enable_interrupt();
+
+    return SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// ACCEL_ISR
+//
+// Port 3 interrupt, for INT1 and INT2 of the ADXL362. INT1: the FIFO
+// watermark was reached, start draining it. INT2: motion, just wake up.
+//
+////////////////////////////////////////////////////////////////////////////
+#pragma vector=PORT3_VECTOR
+__interrupt void ACCEL_ISR(void) {
+    switch (__even_in_range(P3IV, P3IV_P3IFG7)) {
+    case P3IV_P3IFG7:
+        if (ACCEL_SM.isStreaming)
+            ACCEL_startBurst();
+        break;
+    case P3IV_P3IFG6:
+        break;
+    default:
+        break;
+    }
+
+    if (ACCEL_SM.isSleeping) {
+        ACCEL_SM.isSleeping = FALSE;
+        __bic_SR_register_on_exit(LPM4_bits);
+    }
+}
@@ -22,6 +22,15 @@ typedef struct {
     int8_t z;
 } threeAxis_t_8;
 
+/**
+ * Full resolution sample, sign extended from 12 bits
+ */
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} threeAxis_t_12;
+
 BOOL ACCEL_initialize();
 BOOL ACCEL_singleSample(threeAxis_t_8* result);
 BOOL ACCEL_readStat(threeAxis_t_8* result);
@@ -29,6 +38,21 @@ BOOL ACCEL_readID(threeAxis_t_8* result);
 BOOL ACCEL_reset();
 BOOL ACCEL_range();
 BOOL ACCEL_singleSample_FIFO(threeAxis_t_8* result);
+void ACCEL_standby();
+
+BOOL ACCEL_startStream(threeAxis_t_12* buf, uint16_t capacity, uint8_t watermark);
+void ACCEL_stopStream(void);
+BOOL ACCEL_getSample(threeAxis_t_12* result);
+uint16_t ACCEL_samplesAvailable(void);
+uint16_t ACCEL_samplesDropped(void);
+void ACCEL_waitForSamples(void);
+
+BOOL ACCEL_setActivity(uint16_t threshold, uint8_t time, BOOL isReferenced);
+BOOL ACCEL_setInactivity(uint16_t threshold, uint16_t time, BOOL isReferenced);
+void ACCEL_startMotionDetect(BOOL isAutosleep);
+void ACCEL_stopMotionDetect(void);
+BOOL ACCEL_isMoving(void);
+BOOL WISP_waitForMotion(void);
 
 
 #endif /* ACCEL_H_ */
@@ -57,5 +57,26 @@
 #define ADXL_REG_POWER_CTL      0x2D
 #define ADXL_REG_SELF_TEST      0x2E
 
+//
+// Register bits
+//
+#define ADXL_FIFO_MODE_OFF      0x00    // FIFO_CONTROL: FIFO disabled
+#define ADXL_FIFO_MODE_STREAM   0x02    // FIFO_CONTROL: keep the newest samples
+#define ADXL_FIFO_AH            0x08    // FIFO_CONTROL: MSB of FIFO_SAMPLES
+#define ADXL_INT_FIFO_WATERMARK 0x04    // INTMAP1/2, STATUS: FIFO holds FIFO_SAMPLES entries
+#define ADXL_FIFO_AXIS_SHIFT    14      // FIFO entries carry the axis in bits 15:14
+#define ADXL_FIFO_AXIS_X        0
+#define ADXL_FIFO_AXIS_Y        1
+#define ADXL_FIFO_AXIS_Z        2
+#define ADXL_ACT_EN             0x01    // ACT_INACT_CTL: activity detection on
+#define ADXL_ACT_REF            0x02    // ACT_INACT_CTL: activity threshold relative to a reference
+#define ADXL_INACT_EN           0x04    // ACT_INACT_CTL: inactivity detection on
+#define ADXL_INACT_REF          0x08    // ACT_INACT_CTL: inactivity threshold relative to a reference
+#define ADXL_ACT_LOOP           0x30    // ACT_INACT_CTL: linked, acknowledged automatically
+#define ADXL_INT_AWAKE          0x40    // INTMAP1/2, STATUS: moving (in linked/loop mode)
+#define ADXL_POWER_MEASURE      0x02    // POWER_CTL: measurement mode
+#define ADXL_POWER_AUTOSLEEP    0x04    // POWER_CTL: drop to wake-up mode while inactive
+#define ADXL_THRESH_MAX         0x7FF   // THRESH_ACT/THRESH_INACT are 11 bits
+
 
 #endif /* ACCEL_REGISTERS_H_ */
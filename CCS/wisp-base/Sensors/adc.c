@@ -6,6 +6,18 @@
 
 #include "adc.h"
 #include "../globals.h"
+#include "../util/ringbuf.h"
+#include "../wired/dma.h"
+
+/**
+ * Sample trigger of sequences and the window monitor: the TB0.1 output (see the datasheet, ADC12_B
+ *  trigger signal connections). Timer_B0 is otherwise unused; Timer_A0/A1
+ *  belong to the RFID code, Timer_A2 to timer.c and Timer_A3 to the boot
+ *  cycle counter.
+ */
+#define ADC_SEQ_TRIGGER (ADC12SHS_3)
+
+static uint16_t ADC_samples[ADC_SAMPLE_BUFFER_SIZE]; // Storage of ADC_SM.sampleRing
 
 /**
  * State variables for the ADC module
@@ -18,7 +30,34 @@ static struct {
     ADC_inputSelect channel;
 
     void (*read_callback)(uint16_t); // Callback function for asynchronous measurements
-} ADC_SM;
+
+    RINGBUF_t sampleRing; // Results of ADC_queueRead(), filled by the ISR
+    uint8_t isQueued; // Does the running conversion go to sampleRing?
+    uint16_t dropped; // Results lost because sampleRing was full
+
+    uint16_t* seqBuf; // Caller's sequence buffer, NULL while no sequence runs
+    uint8_t seqInputs; // ADC12MEMx slots per sequence, 0 if none is set up
+    uint16_t seqCount; // Sequences per block
+    uint16_t seqIdx; // Sequences done in the current block
+    uint8_t isSeqRepeat; // Start the next block when one is full?
+    uint8_t isSeqDma; // Does the DMA move the results?
+    void (*seq_callback)(void); // Called once per block
+
+    uint8_t isWindow; // Is the window monitor running?
+    void (*window_callback)(uint16_t); // Called when the input leaves or re-enters the band
+
+    // Conversion constants: out = (raw * scale + offset) >> shift, see ADC_updateCalibration()
+    uint8_t isCalValid; // Do they match the current reference and precision?
+    int16_t voltScale;
+    int32_t voltOffset;
+    uint8_t voltShift;
+    int16_t tempScale;
+    int32_t tempOffset;
+    uint8_t tempShift;
+} ADC_SM = {
+    0, ADC_reference_2_0V, ADC_precision_10bit, ADC_input_A9, 0,
+    RINGBUF_STATIC(ADC_samples, ADC_SAMPLE_BUFFER_SIZE, sizeof(uint16_t)), FALSE, 0,
+};
 
 /**
  * Configure the ADC12_B module in single channel single measurement mode and prepare for measurement.
@@ -36,6 +75,22 @@ void ADC_init(void) {
  */
 void ADC_initCustom(ADC_referenceSelect reference,
         ADC_precisionSelect precision, ADC_inputSelect channel) {
+    ADC_configure(reference, precision, channel);
+
+    // enable interrupt
+    ADC_enableInterrupts();
+}
+
+/**
+ * Like ADC_initCustom(), but leaves the ADC interrupt and GIE alone. Enough
+ *  for blocking reads with ADC_critRead().
+ *
+ * @param reference voltage reference source
+ * @param precision ADC measurement precision
+ * @param channel ADC input channel
+ */
+void ADC_configure(ADC_referenceSelect reference,
+        ADC_precisionSelect precision, ADC_inputSelect channel) {
     // Set registers to their reset conditions..
     ADC12CTL0 = 0;
     ADC12CTL1 = 0;
@@ -55,9 +110,6 @@ void ADC_initCustom(ADC_referenceSelect reference,
     // Set resolution to 10 bits. (see user guide 25.3.3)
     ADC_setPrecision(precision);
 
-    // enable interrupt
-    ADC_enableInterrupts();
-
     // Select analog input channel.
     ADC_setInputChannel(channel);
 
@@ -65,6 +117,36 @@ void ADC_initCustom(ADC_referenceSelect reference,
     ADC_enableConversion();
 }
 
+/**
+ * Like ADC_configure(), but while the ADC is on and already uses the wanted
+ *  reference, only the precision and input channel are changed. The reference
+ *  stays up, so there is no settling time to wait for. Leaves the ADC
+ *  interrupt off and the ADC in single channel-single conversion mode.
+ *
+ * @param reference voltage reference source
+ * @param precision ADC measurement precision
+ * @param channel ADC input channel
+ */
+void ADC_switchInput(ADC_referenceSelect reference,
+        ADC_precisionSelect precision, ADC_inputSelect channel) {
+    if (!(ADC12CTL0 & ADC12ON) || (reference != ADC_SM.reference)) {
+        ADC_configure(reference, precision, channel);
+        return;
+    }
+
+    ADC_disableConversion();
+    ADC12IER0 = 0;
+
+    // Software triggered single conversions, like ADC_configure() sets up
+    ADC12CTL1 &= ~(ADC12SHS_7 + ADC12CONSEQ_3);
+    ADC12CTL2 &= ~(ADC12RES_3);
+
+    ADC_setPrecision(precision);
+    ADC_setInputChannel(channel);
+
+    ADC_enableConversion();
+}
+
 /**
  * Synchronously read ADC. Does block.
  */
@@ -85,10 +167,350 @@ uint16_t ADC_read(void) {
 void ADC_asyncRead(void (*callback)(uint16_t)) {
     ADC_enableInterrupts();
 
+    ADC_SM.isQueued = FALSE;
     ADC_SM.read_callback = callback;
     ADC12CTL0 |= ADC12SC;
 }
 
+/**
+ * Start a conversion whose result is buffered by the ISR instead of passed
+ *  to a callback. Do not block; collect results with ADC_getSample().
+ *
+ * @return SUCCESS, or FAIL if a conversion is still running
+ */
+BOOL ADC_queueRead(void) {
+    if (ADC_isBusy())
+        return FAIL;
+
+    ADC_enableInterrupts();
+
+    ADC_SM.isQueued = TRUE;
+    ADC_SM.read_callback = 0;
+    ADC12CTL0 |= ADC12SC;
+
+    return SUCCESS;
+}
+
+/**
+ * Take the oldest buffered result of ADC_queueRead().
+ *
+ * @param raw RAW ADC value
+ * @return SUCCESS, or FAIL if no result is buffered
+ */
+BOOL ADC_getSample(uint16_t* raw) {
+    return RINGBUF_get(&ADC_SM.sampleRing, raw);
+}
+
+/**
+ * Return the number of buffered results which ADC_getSample() can take.
+ */
+uint16_t ADC_samplesAvailable(void) {
+    return RINGBUF_count(&ADC_SM.sampleRing);
+}
+
+/**
+ * Return the number of ADC_queueRead() results lost because the buffer was full.
+ */
+uint16_t ADC_samplesDropped(void) {
+    return ADC_SM.dropped;
+}
+
+/**
+ * Reset the ADC for a timer triggered mode, with the reference of the last
+ *  ADC_initCustom().
+ */
+static void ADC_resetForTrigger(void) {
+    ADC12CTL0 = 0;
+    ADC12CTL1 = 0;
+    ADC12CTL2 = 0;
+    ADC12CTL3 = 0;
+    ADC_disableInterrupts();
+
+    ADC_setReference(ADC_SM.reference); // Also turns the temperature sensor off
+}
+
+/**
+ * Map an input to its ADC12INCH_x value, switching on the temperature sensor
+ *  or the supply divider when needed.
+ */
+static uint16_t ADC_mapInput(ADC_inputSelect input) {
+    switch (input) {
+    case ADC_input_temperature:
+        ADC12CTL3 |= ADC12TCMAP;
+        REFCTL0 &= ~REFTCOFF;
+        return ADC12INCH_30;
+    case ADC_input_supply:
+        ADC12CTL3 |= ADC12BATMAP;
+        return ADC12INCH_31;
+    default:
+        return input;
+    }
+}
+
+/**
+ * Run Timer_B0 in up mode from ACLK; TB0.1 rises (reset/set) every time the
+ *  period starts over.
+ */
+static void ADC_startTrigger(uint16_t period) {
+    TB0CCR0 = period - 1;
+    TB0CCR1 = period >> 1;
+    TB0CCTL1 = OUTMOD_7;
+    TB0CTL = TBSSEL__ACLK | MC__UP | TBCLR;
+}
+
+/**
+ * Stop the sample trigger.
+ */
+static void ADC_stopTrigger(void) {
+    TB0CTL = 0;
+    TB0CCTL1 = 0;
+}
+
+/**
+ * Program the ADC for a sequence: one ADC12MEMx slot per input, converted back
+ *  to back (ADC12MSC) on every trigger, with the reference and precision of
+ *  the last ADC_initCustom(). The single channel functions need
+ *  ADC_initCustom() again afterwards.
+ *
+ * @param inputs channels in conversion order; at most one temperature and one
+ *  supply input, which take the places of A30 and A31
+ * @param n number of inputs, 1 to ADC_SEQ_MAX_INPUTS
+ * @return SUCCESS, or FAIL if n is out of range or a sequence is running
+ */
+BOOL ADC_setSequence(const ADC_inputSelect* inputs, uint8_t n) {
+    uint8_t i;
+    volatile uint16_t* mctl = &ADC12MCTL0;
+
+    if ((n == 0) || (n > ADC_SEQ_MAX_INPUTS) || ADC_SM.seqBuf || ADC_SM.isWindow)
+        return FAIL;
+
+    ADC_resetForTrigger();
+
+    for (i = 0; i < n; i++)
+        mctl[i] = ADC12VRSEL_1 | ADC_mapInput(inputs[i]) | ((i == n - 1) ? ADC12EOS : 0);
+
+    // MODOSC is requested by the ADC itself, so sequences also run in LPM3
+    ADC12CTL0 = ADC12SHT0_4 | ADC12SHT1_4 | ADC12MSC | ADC12ON;
+    ADC12CTL1 = ADC12SHP | ADC12SSEL_0 | ADC12CONSEQ_1 | ADC_SEQ_TRIGGER;
+    ADC12CTL2 = ADC_SM.precision;
+
+    ADC_SM.seqInputs = n;
+
+    return SUCCESS;
+}
+
+/**
+ * Point the DMA at the slot of the next sequence in the caller's buffer.
+ */
+static void ADC_armDma(void) {
+    __data16_write_addr((unsigned short) &DMA2SA, (unsigned long) &ADC12MEM0);
+    __data16_write_addr((unsigned short) &DMA2DA,
+            (unsigned long) (ADC_SM.seqBuf + ADC_SM.seqIdx * ADC_SM.seqInputs));
+    DMA2SZ = ADC_SM.seqInputs;
+    DMA2CTL = DMADT_1 | DMASRCINCR_3 | DMADSTINCR_3 | DMAIE | DMAEN;
+}
+
+/**
+ * One sequence is in the buffer. Signal the block when it is full, and re-arm
+ *  the ADC for the next trigger.
+ */
+static void ADC_seqStep(void) {
+    void (*callback)(void) = ADC_SM.seq_callback;
+
+    if (++ADC_SM.seqIdx >= ADC_SM.seqCount) {
+        ADC_SM.seqIdx = 0;
+
+        if (!ADC_SM.isSeqRepeat)
+            ADC_stopSequence();
+
+        if (callback)
+            callback();
+    }
+
+    if (ADC_SM.seqBuf == 0)
+        return; // stopped, maybe by the callback
+
+    // Sequence-of-channels mode waits for a new ADC12ENC edge before the next
+    //  trigger can start another sequence.
+    ADC12CTL0 &= ~ADC12ENC;
+    ADC12CTL0 |= ADC12ENC;
+
+    if (ADC_SM.isSeqDma)
+        ADC_armDma();
+}
+
+/**
+ * DMA completion callback: the results of one sequence have been moved.
+ */
+static void ADC_seqDmaDone(void) {
+    ADC_seqStep();
+}
+
+/**
+ * Start converting the sequence set up with ADC_setSequence() once per
+ *  period. The results go to the buffer sequence after sequence, in input
+ *  order, moved by the DMA (or by the ADC ISR while the shared DMA channel is
+ *  busy with the UART).
+ *
+ * @param buf caller owned buffer of count * inputs results
+ * @param count sequences per block
+ * @param period ACLK ticks between sequences, at least 2
+ * @param isRepeat TRUE to refill the buffer from the start once it is full,
+ *  FALSE to stop after one block
+ * @param callback called from an ISR once per full block, may be NULL. The
+ *  results must be used before the next sequence overwrites them.
+ * @return SUCCESS, or FAIL if no sequence is set up or one is running
+ */
+BOOL ADC_startSequence(uint16_t* buf, uint16_t count, uint16_t period,
+        BOOL isRepeat, void (*callback)(void)) {
+    uint8_t last = ADC_SM.seqInputs - 1;
+
+    if ((ADC_SM.seqInputs == 0) || ADC_SM.seqBuf || ADC_SM.isWindow || (count == 0) || (period < 2))
+        return FAIL;
+
+    ADC_SM.seqBuf = buf;
+    ADC_SM.seqCount = count;
+    ADC_SM.seqIdx = 0;
+    ADC_SM.isSeqRepeat = isRepeat;
+    ADC_SM.seq_callback = callback;
+
+    ADC12IFGR0 = 0;
+    ADC12IFGR1 = 0;
+
+    ADC_SM.isSeqDma = DMA_claim(DMA_CH_ADC, &ADC_seqDmaDone);
+    if (ADC_SM.isSeqDma) {
+        DMA_init();
+        DMA_setTrigger(DMA_CH_ADC, DMA_TRIG_ADC12);
+        ADC_armDma();
+    } else if (last < 16) {
+        ADC12IER0 = 1 << last; // End of sequence
+    } else {
+        ADC12IER1 = 1 << (last - 16);
+    }
+
+    ADC12CTL0 |= ADC12ENC;
+    ADC_startTrigger(period);
+
+    return SUCCESS;
+}
+
+/**
+ * Stop the running sequence. Safe to call from the block callback.
+ */
+void ADC_stopSequence(void) {
+    ADC_stopTrigger();
+
+    ADC12CTL0 &= ~ADC12ENC;
+    ADC_disableInterrupts();
+
+    if (ADC_SM.seqBuf && ADC_SM.isSeqDma)
+        DMA_release(DMA_CH_ADC);
+
+    ADC_SM.seqBuf = 0;
+}
+
+/**
+ * Return true while a sequence is being sampled.
+ */
+BOOL ADC_isSequenceRunning(void) {
+    return (ADC_SM.seqBuf != 0);
+}
+
+/**
+ * Start watching one input with the window comparator. It is converted once
+ *  per period, but the CPU only gets an interrupt when the result leaves the
+ *  band [low, high], and once more when it comes back. The single channel
+ *  functions need ADC_initCustom() again afterwards.
+ *
+ * @param input channel to watch
+ * @param low lowest in-band result, in raw ADC counts of the precision of
+ *  the last ADC_initCustom()
+ * @param high highest in-band result
+ * @param period ACLK ticks between conversions, at least 2
+ * @param callback called from the ADC ISR with the result which crossed the
+ *  band edge (compare with low/high to tell which way), may be NULL
+ * @return SUCCESS, or FAIL if the band is empty or a sequence is running
+ */
+BOOL ADC_startWindow(ADC_inputSelect input, uint16_t low, uint16_t high,
+        uint16_t period, void (*callback)(uint16_t)) {
+    if ((low > high) || (period < 2) || ADC_SM.seqBuf)
+        return FAIL;
+
+    ADC_stopWindow();
+    ADC_resetForTrigger();
+    ADC_SM.seqInputs = 0; // MEM0 is taken over
+
+    ADC12MCTL0 = ADC12VRSEL_1 | ADC12WINC | ADC_mapInput(input);
+    ADC12LO = low;
+    ADC12HI = high;
+
+    // Repeat-single-channel, one conversion per trigger
+    ADC12CTL0 = ADC12SHT0_4 | ADC12ON;
+    ADC12CTL1 = ADC12SHP | ADC12SSEL_0 | ADC12CONSEQ_2 | ADC_SEQ_TRIGGER;
+    ADC12CTL2 = ADC_SM.precision;
+
+    ADC_SM.window_callback = callback;
+    ADC_SM.isWindow = TRUE;
+
+    ADC12IFGR2 = 0;
+    ADC12IER2 = ADC12HIIE | ADC12LOIE;
+
+    ADC12CTL0 |= ADC12ENC;
+    ADC_startTrigger(period);
+
+    return SUCCESS;
+}
+
+/**
+ * Stop the window monitor.
+ */
+void ADC_stopWindow(void) {
+    if (!ADC_SM.isWindow)
+        return;
+
+    ADC_stopTrigger();
+
+    ADC12CTL0 &= ~ADC12ENC;
+    ADC_disableInterrupts();
+
+    ADC_SM.isWindow = FALSE;
+}
+
+/**
+ * Return true while the input is outside the band (after the last crossing).
+ */
+BOOL ADC_isOutsideWindow(void) {
+    return ADC_SM.isWindow && (ADC12IER2 & ADC12INIE);
+}
+
+/**
+ * The window comparator saw a band edge crossing: from now on, wait for the
+ *  opposite one. Flags of earlier conversions are stale, so clear them first.
+ */
+static void ADC_windowCrossed(uint16_t nextIe) {
+    ADC12IFGR2 &= ~(ADC12HIIFG | ADC12LOIFG | ADC12INIFG);
+    ADC12IER2 = nextIe;
+
+    ADC_SM.lastValue = ADC12MEM0;
+
+    if (ADC_SM.window_callback)
+        (*ADC_SM.window_callback)(ADC_SM.lastValue);
+}
+
+/**
+ * Copy the results of one sequence (when not using DMA).
+ */
+static void ADC_seqCopy(void) {
+    uint8_t i;
+    uint16_t* dst = ADC_SM.seqBuf + ADC_SM.seqIdx * ADC_SM.seqInputs;
+    volatile uint16_t* mem = &ADC12MEM0;
+
+    for (i = 0; i < ADC_SM.seqInputs; i++)
+        dst[i] = mem[i];
+
+    ADC_seqStep();
+}
+
 /**
  * Critical ADC read. Does block, does not use interrupts.
  */
@@ -114,11 +536,30 @@ uint16_t ADC_critRead(void) {
  */
 #pragma vector=ADC12_VECTOR
 __interrupt void INT_ADC12(void) {
-    switch (__even_in_range(ADC12IV, ADC12IV_ADC12RDYIFG)) {
+    uint16_t iv = __even_in_range(ADC12IV, ADC12IV_ADC12RDYIFG);
+
+    // End of sequence, only enabled when the DMA doesn't move the results
+    if (ADC_SM.seqBuf && (iv == ADC12IV_ADC12IFG0 + 2 * (ADC_SM.seqInputs - 1))) {
+        ADC_seqCopy();
+        return;
+    }
+
+    switch (iv) {
+    case ADC12IV_ADC12HIIFG:
+    case ADC12IV_ADC12LOIFG:
+        ADC_windowCrossed(ADC12INIE);
+        break;
+    case ADC12IV_ADC12INIFG:
+        ADC_windowCrossed(ADC12HIIE | ADC12LOIE);
+        break;
     case ADC12IV_ADC12IFG0:
         ADC_SM.lastValue = ADC12MEM0;
 
-        if (ADC_SM.read_callback)
+        if (ADC_SM.isQueued) {
+            ADC_SM.isQueued = FALSE;
+            if (!RINGBUF_put(&ADC_SM.sampleRing, &ADC_SM.lastValue))
+                ADC_SM.dropped++;
+        } else if (ADC_SM.read_callback)
             (*ADC_SM.read_callback)(ADC_SM.lastValue);
 
         break;
@@ -221,6 +662,159 @@ int16_t ADC_rawToTemperature(uint16_t raw) {
     return (int16_t) (temp & 0xFFFF);
 }
 
+/**
+ * Fold the TLV gain/offset correction and the reference and precision into
+ *  one fixed point multiply-add per conversion. All TLV values are 12-bit
+ *  results, so raw values of lower precision are scaled up first; that
+ *  factor cancels out of the scale, which is why it doesn't depend on the
+ *  precision:
+ *
+ *  mV   = raw * gain * Vref / (2^(15 + bits)) + offset * Vref / 4096 - LSB/2
+ *  0.01C = raw * gain * 5500 / (2^(3 + bits) * (ref85 - ref30))
+ *          + 3000 + (offset - ref30) * 5500 / (ref85 - ref30)
+ *
+ * The shifts (bits + 3 and bits - 2) keep both scales below 2^15 for every
+ *  reference, so they fit a signed 16x16 hardware multiply.
+ */
+static void ADC_updateCalibration(void) {
+    uint16_t adc_gain   = *((uint16_t*)0x1A16);
+    int16_t  adc_offset = *((int16_t*)0x1A18);
+    uint16_t v_plus;
+    uint16_t adc_ref30, adc_ref85;
+    uint8_t resBits;
+    int32_t part;
+    int16_t delta;
+
+    switch (ADC_SM.reference) {
+    case ADC_reference_1_2V:
+        v_plus = 1200;
+        adc_ref30 = *((uint16_t*)0x1A1A);
+        adc_ref85 = *((uint16_t*)0x1A1C);
+        break;
+    case ADC_reference_2_0V:
+        v_plus = 2000;
+        adc_ref30 = *((uint16_t*)0x1A1E);
+        adc_ref85 = *((uint16_t*)0x1A20);
+        break;
+    default:
+        v_plus = 2500;
+        adc_ref30 = *((uint16_t*)0x1A22);
+        adc_ref85 = *((uint16_t*)0x1A24);
+        break;
+    }
+
+    resBits = (ADC_SM.precision == ADC_precision_8bit) ? 8 :
+           (ADC_SM.precision == ADC_precision_10bit) ? 10 : 12;
+
+    // Voltage, shift resBits + 3
+    ADC_SM.voltShift = resBits + 3;
+    ADC_SM.voltScale = (int16_t) (((uint32_t) adc_gain * v_plus + 2048) >> 12);
+    part = (int32_t) adc_offset * v_plus;
+    part = (resBits >= 9) ? (part << (resBits - 9)) : (part >> (9 - resBits));
+    ADC_SM.voltOffset = part - ((int32_t) (v_plus >> resBits) << (resBits + 2))
+            + (1L << (ADC_SM.voltShift - 1));
+
+    // Temperature, shift resBits - 2
+    delta = (int16_t) (adc_ref85 - adc_ref30);
+    ADC_SM.tempShift = resBits - 2;
+    if (delta > 0) {
+        ADC_SM.tempScale = (int16_t) (((uint32_t) adc_gain * 5500 + 16UL * delta) / (32UL * delta));
+        part = ((int32_t) adc_offset - adc_ref30) * 5500;
+        ADC_SM.tempOffset = ((3000L + part / delta) << ADC_SM.tempShift)
+                + (((part % delta) << ADC_SM.tempShift) / delta)
+                + (1L << (ADC_SM.tempShift - 1));
+    } else {
+        ADC_SM.tempScale = 0; // No calibration data
+        ADC_SM.tempOffset = 0;
+    }
+
+    ADC_SM.isCalValid = TRUE;
+}
+
+/**
+ * out[i] = (raw[i] * scale + offset) >> shift on the MPY32. Operand 1 stays
+ *  loaded, so each sample costs one OP2 write. Interrupts are held off per
+ *  chunk, since compiled code in an ISR may use the multiplier too.
+ */
+static void ADC_convertBlock(const uint16_t* raw, int16_t* out, uint16_t n,
+        int16_t scale, int32_t offset, uint8_t shift) {
+    uint16_t state = __get_interrupt_state();
+    uint16_t i;
+    int32_t acc;
+
+    while (n) {
+        i = (n > 16) ? 16 : n;
+        n -= i;
+
+        __disable_interrupt();
+        MPYS = scale;
+
+        while (i--) {
+            OP2 = *raw++;
+            __no_operation(); // 16x16 result is ready three cycles after OP2 is written
+            __no_operation();
+            acc = ((int32_t) RESHI << 16) | RESLO;
+            *out++ = (int16_t) ((acc + offset) >> shift);
+        }
+
+        __set_interrupt_state(state);
+    }
+}
+
+/**
+ * Convert a block of RAW ADC readings to milli Volts, with cached calibration
+ *  constants and the hardware multiplier. Same formula as ADC_rawToVoltage(),
+ *  but with the TLV correction applied at 12 bits for every precision.
+ *
+ * @param raw RAW ADC values
+ * @param mV results, may be the same array as raw
+ * @param n number of values
+ */
+void ADC_convertVoltages(const uint16_t* raw, uint16_t* mV, uint16_t n) {
+    if (!ADC_SM.isCalValid)
+        ADC_updateCalibration();
+
+    ADC_convertBlock(raw, (int16_t*) mV, n,
+            ADC_SM.voltScale, ADC_SM.voltOffset, ADC_SM.voltShift);
+}
+
+/**
+ * Convert a block of RAW temperature sensor readings to 0.01 degree Celcius
+ *  (e.g. 2150 ~ 21.5C), with cached calibration constants and the hardware
+ *  multiplier.
+ *
+ * @param raw RAW ADC values
+ * @param centiC results, may be the same array as raw
+ * @param n number of values
+ */
+void ADC_convertTemperatures(const uint16_t* raw, int16_t* centiC, uint16_t n) {
+    if (!ADC_SM.isCalValid)
+        ADC_updateCalibration();
+
+    ADC_convertBlock(raw, centiC, n,
+            ADC_SM.tempScale, ADC_SM.tempOffset, ADC_SM.tempShift);
+}
+
+/**
+ * Single value ADC_convertVoltages().
+ */
+uint16_t ADC_convertVoltage(uint16_t raw) {
+    uint16_t mV;
+
+    ADC_convertVoltages(&raw, &mV, 1);
+    return mV;
+}
+
+/**
+ * Single value ADC_convertTemperatures().
+ */
+int16_t ADC_convertTemperature(uint16_t raw) {
+    int16_t centiC;
+
+    ADC_convertTemperatures(&raw, &centiC, 1);
+    return centiC;
+}
+
 /**
  * Return true if ADC module is in the middle of a conversion, false if not.
  */
@@ -304,6 +898,7 @@ void ADC_setReference(ADC_referenceSelect reference) {
         return;
 
     ADC_SM.reference = reference;
+    ADC_SM.isCalValid = FALSE;
 
     // Set reference voltage.
     REFCTL0 = reference + REFTCOFF; // REFON is not needed, ADC automatically enables REF
@@ -329,6 +924,7 @@ ADC_referenceSelect ADC_getReference(void) {
  */
 void ADC_setPrecision(ADC_precisionSelect precision) {
     ADC_SM.precision = precision;
+    ADC_SM.isCalValid = FALSE;
 
     ADC12CTL2 |= precision;
 }
@@ -343,7 +939,8 @@ ADC_precisionSelect ADC_getPrecision(void) {
 /**
  * Set ADC input channel and single channel-single conversion mode.
  *
- * Possible channels: analog input pins A0-A31 and internal temperature sensor.
+ * Possible channels: analog input pins A0-A31, internal temperature sensor
+ *  and internal supply voltage divider.
  *
  * @param channel the wanted channel.
  */
@@ -353,6 +950,7 @@ void ADC_setInputChannel(ADC_inputSelect channel) {
     switch (channel) {
     case ADC_input_temperature:
         // Use alternate channel muxing
+        ADC12CTL3 &= ~ADC12BATMAP;
         ADC12CTL3 |= ADC12TCMAP;
 
         // Enable temperature sensor
@@ -362,9 +960,21 @@ void ADC_setInputChannel(ADC_inputSelect channel) {
         ADC12MCTL0 &= ~(0x1F);
         ADC12MCTL0 |= ADC12INCH_30;
         break;
+    case ADC_input_supply:
+        // Use alternate channel muxing
+        ADC12CTL3 &= ~ADC12TCMAP;
+        ADC12CTL3 |= ADC12BATMAP;
+
+        // Disable temperature sensor
+        REFCTL0 |= REFTCOFF;
+
+        // Select (AVCC - AVSS) / 2 input channel
+        ADC12MCTL0 &= ~(0x1F);
+        ADC12MCTL0 |= ADC12INCH_31;
+        break;
     default:
         // Use default channel muxing
-        ADC12CTL3 &= ~ADC12TCMAP;
+        ADC12CTL3 &= ~(ADC12TCMAP + ADC12BATMAP);
 
         // Disable temperature sensor
         REFCTL0 |= REFTCOFF;
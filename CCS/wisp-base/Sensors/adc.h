@@ -30,10 +30,12 @@ typedef enum {
 } ADC_precisionSelect;
 
 /**
- * ADC input channel, for now only external analog inputs
+ * ADC input channel, external analog inputs and the internal temperature and
+ *  supply (AVCC/2) channels
  */
 typedef enum {
     ADC_input_temperature,
+    ADC_input_supply = 0x20, // (AVCC - AVSS) / 2, outside of the ADC12INCH_x range
     ADC_input_A0 = ADC12INCH_0,
     ADC_input_A1 = ADC12INCH_1,
     ADC_input_A2 = ADC12INCH_2,
@@ -71,17 +73,43 @@ typedef enum {
 // Initialization functions
 void ADC_init(void);
 void ADC_initCustom(ADC_referenceSelect, ADC_precisionSelect, ADC_inputSelect);
+void ADC_configure(ADC_referenceSelect, ADC_precisionSelect, ADC_inputSelect);
+void ADC_switchInput(ADC_referenceSelect, ADC_precisionSelect, ADC_inputSelect);
 
 // Read functions
 uint16_t ADC_read(void);
 void ADC_asyncRead(void (*)(uint16_t));
 uint16_t ADC_critRead(void);
 
+// Buffered read functions
+uint8_t ADC_queueRead(void);
+uint8_t ADC_getSample(uint16_t*);
+uint16_t ADC_samplesAvailable(void);
+uint16_t ADC_samplesDropped(void);
+
+// Sequence functions (timer triggered, one ADC12MEMx slot per input)
+#define ADC_SEQ_MAX_INPUTS 32
+uint8_t ADC_setSequence(const ADC_inputSelect*, uint8_t);
+uint8_t ADC_startSequence(uint16_t*, uint16_t, uint16_t, uint8_t, void (*)(void));
+void ADC_stopSequence(void);
+uint8_t ADC_isSequenceRunning(void);
+
+// Window comparator functions (timer triggered, interrupts only on band crossings)
+uint8_t ADC_startWindow(ADC_inputSelect, uint16_t, uint16_t, uint16_t, void (*)(uint16_t));
+void ADC_stopWindow(void);
+uint8_t ADC_isOutsideWindow(void);
+
 // Conversion functions
 uint16_t ADC_rawCorrection(uint16_t);
 uint16_t ADC_rawToVoltage(uint16_t);
 int16_t ADC_rawToTemperature(uint16_t);
 
+// Fast conversion functions (cached calibration, hardware multiplier)
+uint16_t ADC_convertVoltage(uint16_t);
+int16_t ADC_convertTemperature(uint16_t);
+void ADC_convertVoltages(const uint16_t*, uint16_t*, uint16_t);
+void ADC_convertTemperatures(const uint16_t*, int16_t*, uint16_t);
+
 // Get ADC status
 uint8_t ADC_isBusy(void);
 uint8_t ADC_isReady(void);
@@ -0,0 +1,129 @@
+/**
+ * @file supply.c
+ * @brief Supply voltage monitor and energy gating
+ *
+ * Work which browns out halfway (an accelerometer burst, a FRAM log flush)
+ *  wastes all the energy spent on it. These functions measure the supply with
+ *  a single blocking ADC conversion and run such work only once the supply is
+ *  high enough, sleeping in LPM3 meanwhile so the storage can charge.
+ *
+ * A measurement borrows the ADC and leaves it as it was found: switched off,
+ *  or configured as before. If the ADC is already on with the 2.0V reference,
+ *  only its input is switched, since the reference has settled already.
+ *
+ * Protothread tasks can gate themselves with
+ *  PT_WAIT_UNTIL(pt, SUPPLY_isAbove(mV)).
+ */
+
+#include "supply.h"
+#include "adc.h"
+#include "../Timing/timer.h"
+
+/**
+ * State variables for the supply monitor
+ */
+static struct {
+    SUPPLY_sourceSelect source; // What SUPPLY_read() measures
+    uint16_t lastValue; // Last measurement in mV
+} SUPPLY_SM;
+
+/**
+ * Select what SUPPLY_read() measures. Default is SUPPLY_source_vcc.
+ */
+void SUPPLY_setSource(SUPPLY_sourceSelect source) {
+    SUPPLY_SM.source = source;
+}
+
+/**
+ * Measure the supply. Blocks for one conversion, plus the settling time of the
+ *  reference if the ADC was off or used another reference.
+ *
+ * @return supply voltage in milli Volts
+ */
+uint16_t SUPPLY_read(void) {
+    // Previous ADC setup, to put back afterwards
+    uint8_t wasOn = !!(ADC12CTL0 & ADC12ON);
+    uint16_t ier = ADC12IER0;
+    ADC_referenceSelect reference = ADC_getReference();
+    ADC_precisionSelect precision = ADC_getPrecision();
+    ADC_inputSelect channel = ADC_getInputChannel();
+    uint16_t raw;
+
+    while (ADC_isBusy())
+        ; // let a running conversion finish
+
+    if (SUPPLY_SM.source == SUPPLY_source_storage) {
+        BITSET(PMEAS_ENDIR, PIN_MEAS_EN);
+        BITSET(PMEAS_ENOUT, PIN_MEAS_EN);
+        ADC_switchInput(ADC_reference_2_0V, ADC_precision_10bit, ADC_input_A9);
+    } else {
+        ADC_switchInput(ADC_reference_2_0V, ADC_precision_10bit, ADC_input_supply);
+    }
+
+    raw = ADC_critRead();
+    SUPPLY_SM.lastValue = ADC_rawToVoltage(raw) * SUPPLY_DIVIDER;
+
+    if (SUPPLY_SM.source == SUPPLY_source_storage)
+        BITCLR(PMEAS_ENOUT, PIN_MEAS_EN);
+
+    if (wasOn) {
+        ADC_switchInput(reference, precision, channel);
+        ADC12IER0 = ier;
+    } else {
+        ADC_disable(); // the reference turns off with the ADC
+    }
+
+    return SUPPLY_SM.lastValue;
+}
+
+/**
+ * @return result of the last SUPPLY_read() in milli Volts, without measuring
+ */
+uint16_t SUPPLY_last(void) {
+    return SUPPLY_SM.lastValue;
+}
+
+/**
+ * @param mV threshold in milli Volts
+ * @return TRUE if the supply is at or above the threshold right now
+ */
+BOOL SUPPLY_isAbove(uint16_t mV) {
+    return (SUPPLY_read() >= mV) ? TRUE : FALSE;
+}
+
+/**
+ * Sleep until the supply has reached a threshold, checking every
+ *  SUPPLY_POLL_TICKS.
+ *
+ * @param mV threshold in milli Volts
+ */
+void SUPPLY_waitFor(uint16_t mV) {
+    while (SUPPLY_read() < mV)
+        Timer_LooseDelay(SUPPLY_POLL_TICKS);
+}
+
+/**
+ * Run a function only if the supply is high enough right now.
+ *
+ * @param mV threshold in milli Volts
+ * @param fn work to run
+ * @return SUCCESS if it was run, FAIL if the supply was too low
+ */
+BOOL SUPPLY_tryRun(uint16_t mV, void (*fn)(void)) {
+    if (SUPPLY_read() < mV)
+        return FAIL;
+
+    fn();
+    return SUCCESS;
+}
+
+/**
+ * Run a function once the supply is high enough, sleeping until then.
+ *
+ * @param mV threshold in milli Volts
+ * @param fn work to run
+ */
+void SUPPLY_runGated(uint16_t mV, void (*fn)(void)) {
+    SUPPLY_waitFor(mV);
+    fn();
+}
@@ -0,0 +1,29 @@
+/**
+ * @file supply.h
+ * @brief Supply voltage monitor and energy gating
+ */
+
+#ifndef SUPPLY_H_
+#define SUPPLY_H_
+
+#include "../globals.h"
+
+/**
+ * What to measure
+ */
+typedef enum {
+    SUPPLY_source_vcc,      // MCU supply, through the internal AVCC/2 channel
+    SUPPLY_source_storage,  // Storage capacitor, through the MEAS divider on A9
+} SUPPLY_sourceSelect;
+
+void SUPPLY_setSource(SUPPLY_sourceSelect source);
+
+uint16_t SUPPLY_read(void);
+uint16_t SUPPLY_last(void);
+BOOL SUPPLY_isAbove(uint16_t mV);
+
+void SUPPLY_waitFor(uint16_t mV);
+BOOL SUPPLY_tryRun(uint16_t mV, void (*fn)(void));
+void SUPPLY_runGated(uint16_t mV, void (*fn)(void));
+
+#endif /* SUPPLY_H_ */
@@ -3,62 +3,390 @@
  *
  * Provides hardware and software delay and alarm/scheduling functions
  *
+ * Timer_A2 free-runs in continuous mode from ACLK. The TAIFG overflow extends
+ *  it to a 32-bit time base, and CCR0 is always programmed to the earliest
+ *  alarm of a sorted list, so any number of one-shot and periodic alarms share
+ *  the single timer. This module owns TIMER2_A0_VECTOR and TIMER2_A1_VECTOR.
+ *
+ * @note ISR mode callbacks also run while WISP_doRFID() is receiving, where
+ *  they add latency to the RX state machine. Keep them short, or use deferred
+ *  mode and call Timer_dispatch() from the main loop.
+ *
  * @author Aaron Parks
  */
 
 #include "timer.h"
 #include "../globals.h"
 
-static BOOL wakeOnDelayTimer;       // A flag indicating we are waiting for a delay timer to expire
+/**
+ * State variables for the timer module
+ */
+static struct {
+    BOOL isRunning; // Has Timer_A2 been started?
+    volatile uint16_t overflows; // Upper 16 bits of the time base
+    Timer_alarm_t* head; // Sorted list of active alarms, earliest first
+    Timer_alarm_t* pendingHead; // Deferred callbacks waiting for Timer_dispatch()
+    Timer_alarm_t* pendingTail;
+    volatile uint8_t fired; // Incremented every time an alarm expires
+    volatile BOOL isSleeping; // Main loop sleeps in this module and wants a wakeup
+} TIMER_SM;
 
 //----------------------------------------------------------------------------
 
+/**
+ * Read TA2R. The counter runs from ACLK, which is asynchronous to MCLK, so
+ *  keep reading until two consecutive values agree.
+ */
+static uint16_t Timer_readTAR(void) {
+    uint16_t a, b;
+
+    b = TA2R;
+    do {
+        a = b;
+        b = TA2R;
+    } while (a != b);
+
+    return a;
+}
+
+/**
+ * Point CCR0 at the earliest alarm. If it is due already (or too close to
+ *  catch with a compare) the interrupt is forced. Alarms further away than
+ *  one counter period are picked up again from the overflow interrupt.
+ *
+ * @pre interrupts are disabled
+ */
+static void Timer_program(void) {
+    int32_t delta;
+
+    if (TIMER_SM.head == 0) {
+        TA2CCTL0 = 0;
+        return;
+    }
+
+    delta = (int32_t) (TIMER_SM.head->due - Timer_now());
+
+    if (delta <= 1) {
+        TA2CCTL0 = CCIE | CCIFG;
+    } else if (delta <= 0xFFFF) {
+        TA2CCR0 = (uint16_t) TIMER_SM.head->due;
+        TA2CCTL0 = CCIE;
+
+        // The counter may have passed CCR0 while it was being written.
+        if ((int32_t) (TIMER_SM.head->due - Timer_now()) <= 0)
+            TA2CCTL0 |= CCIFG;
+    } else {
+        TA2CCTL0 = 0;
+    }
+}
+
+/**
+ * Insert an alarm into the sorted list.
+ *
+ * @pre interrupts are disabled
+ */
+static void Timer_insert(Timer_alarm_t* alarm) {
+    Timer_alarm_t** link = &TIMER_SM.head;
+
+    while ((*link != 0) && ((int32_t) ((*link)->due - alarm->due) <= 0))
+        link = &((*link)->next);
+
+    alarm->next = *link;
+    *link = alarm;
+    alarm->flags |= TIMER_ALARM_ACTIVE;
+}
+
+/**
+ * Remove an alarm from the sorted list, if it is there.
+ *
+ * @pre interrupts are disabled
+ */
+static void Timer_remove(Timer_alarm_t* alarm) {
+    Timer_alarm_t** link = &TIMER_SM.head;
+
+    while (*link != 0) {
+        if (*link == alarm) {
+            *link = alarm->next;
+            break;
+        }
+        link = &((*link)->next);
+    }
+
+    alarm->next = 0;
+    alarm->flags &= ~TIMER_ALARM_ACTIVE;
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Start Timer_A2 in continuous mode from ACLK. Called automatically when the
+ *  first alarm is started.
+ */
+void Timer_init(void) {
+    if (TIMER_SM.isRunning)
+        return;
+
+    TA2CCTL0 = 0;
+    TA2CCTL1 = 0;
+    TA2CTL = TASSEL__ACLK | MC__CONTINUOUS | TACLR | TAIE; // ACLK, continuous, overflow interrupt
+
+    TIMER_SM.overflows = 0;
+    TIMER_SM.isRunning = TRUE;
+}
+
+/**
+ * @return the current time in ACLK ticks since Timer_init()
+ */
+uint32_t Timer_now(void) {
+    uint16_t state = __get_interrupt_state();
+    uint16_t hi, lo;
+
+    __disable_interrupt();
+
+    hi = TIMER_SM.overflows;
+    lo = Timer_readTAR();
+
+    // An overflow which is not serviced yet still belongs to this reading.
+    if (TA2CTL & TAIFG) {
+        lo = Timer_readTAR();
+        hi++;
+    }
+
+    __set_interrupt_state(state);
+
+    return ((uint32_t) hi << 16) | lo;
+}
+
+/**
+ * Prepare an alarm for use. Must be called before the alarm is started, and
+ *  not while it is active.
+ *
+ * @param alarm caller owned alarm
+ * @param callback function to call on expiry, may be NULL
+ * @param mode TIMER_ALARM_ISR or TIMER_ALARM_DEFERRED
+ */
+void Timer_initAlarm(Timer_alarm_t* alarm, void (*callback)(void), uint8_t mode) {
+    alarm->next = 0;
+    alarm->nextPending = 0;
+    alarm->due = 0;
+    alarm->period = 0;
+    alarm->callback = callback;
+    alarm->flags = mode & TIMER_ALARM_DEFERRED;
+}
+
+/**
+ * Start (or restart) an alarm.
+ *
+ * @param alarm alarm prepared with Timer_initAlarm()
+ * @param delay ticks until the first expiry
+ * @param period ticks between subsequent expiries, 0 for a one-shot alarm
+ */
+void Timer_startAlarm(Timer_alarm_t* alarm, uint32_t delay, uint32_t period) {
+    uint16_t state = __get_interrupt_state();
+
+    Timer_init();
+
+    __disable_interrupt();
+
+    Timer_remove(alarm);
+    alarm->due = Timer_now() + delay;
+    alarm->period = period;
+    Timer_insert(alarm);
+    Timer_program();
+
+    __set_interrupt_state(state);
+}
+
+/**
+ * Stop an alarm. A deferred callback which already expired is dropped too.
+ */
+void Timer_stopAlarm(Timer_alarm_t* alarm) {
+    uint16_t state = __get_interrupt_state();
+    Timer_alarm_t* prev = 0;
+    Timer_alarm_t* cur;
+
+    __disable_interrupt();
+
+    Timer_remove(alarm);
+    Timer_program();
+
+    if (alarm->flags & TIMER_ALARM_PENDING) {
+        for (cur = TIMER_SM.pendingHead; cur != 0; prev = cur, cur = cur->nextPending) {
+            if (cur == alarm) {
+                if (prev)
+                    prev->nextPending = cur->nextPending;
+                else
+                    TIMER_SM.pendingHead = cur->nextPending;
+
+                if (TIMER_SM.pendingTail == cur)
+                    TIMER_SM.pendingTail = prev;
+                break;
+            }
+        }
+        alarm->nextPending = 0;
+        alarm->flags &= ~TIMER_ALARM_PENDING;
+    }
+
+    __set_interrupt_state(state);
+}
+
+/**
+ * @return TRUE if the alarm is waiting to expire
+ */
+BOOL Timer_isActive(Timer_alarm_t* alarm) {
+    return (alarm->flags & TIMER_ALARM_ACTIVE) ? TRUE : FALSE;
+}
+
+/**
+ * Run the callbacks of all expired deferred alarms, oldest first.
+ *
+ * @return number of callbacks which were run
+ */
+uint8_t Timer_dispatch(void) {
+    uint8_t n = 0;
+    uint16_t state;
+    Timer_alarm_t* alarm;
+
+    while (TRUE) {
+        state = __get_interrupt_state();
+        __disable_interrupt();
+
+        alarm = TIMER_SM.pendingHead;
+        if (alarm != 0) {
+            TIMER_SM.pendingHead = alarm->nextPending;
+            if (TIMER_SM.pendingHead == 0)
+                TIMER_SM.pendingTail = 0;
+            alarm->nextPending = 0;
+            alarm->flags &= ~TIMER_ALARM_PENDING;
+        }
+
+        __set_interrupt_state(state);
+
+        if (alarm == 0)
+            break;
+
+        if (alarm->callback)
+            alarm->callback();
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * Sleep in LPM3 until the next alarm expires. Returns immediately if deferred
+ *  callbacks are already waiting for Timer_dispatch().
+ */
+void Timer_waitForEvent(void) {
+    uint8_t fired;
+
+    __disable_interrupt();
+
+    fired = TIMER_SM.fired;
+    while ((TIMER_SM.pendingHead == 0) && (fired == TIMER_SM.fired)) {
+        TIMER_SM.isSleeping = TRUE;
+        __bis_SR_register(LPM3_bits | GIE);
+        __disable_interrupt();
+    }
+    TIMER_SM.isSleeping = FALSE;
+
+    __enable_interrupt();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// Timer_LooseDelay
 ///
 /// This function uses the timer to generate delays that are at least as long as
-/// the specified duration
+/// the specified duration. Other alarms keep running meanwhile.
 ///
 /// \param usTime32kHz - The minimum amount of time to delay in ~30.5us units (1/32768Hz)
-/// @todo Move config register and value definitions to config.h
 /////////////////////////////////////////////////////////////////////////////
 void Timer_LooseDelay(uint16_t usTime32kHz)
 {
-    TA2CCTL0 = CCIE;                          // CCR0 interrupt enabled
-    TA2CCR0 = usTime32kHz;
-    TA2CTL = TASSEL_1 | MC_1 | TACLR;         // ACLK(=REFO), upmode, clear TAR
+    Timer_alarm_t delay;
 
-    wakeOnDelayTimer = TRUE;
+    Timer_initAlarm(&delay, 0, TIMER_ALARM_ISR);
+    Timer_startAlarm(&delay, usTime32kHz, 0);
 
-    while(wakeOnDelayTimer) {
+    __disable_interrupt();
+
+    while (delay.flags & TIMER_ALARM_ACTIVE) {
+        TIMER_SM.isSleeping = TRUE;
         __bis_SR_register(LPM3_bits | GIE);
+        __disable_interrupt();
     }
+    TIMER_SM.isSleeping = FALSE;
 
-    TA2CCTL0 = 0x00;
-    TA2CTL = 0;
-
+    __enable_interrupt();
 }
 
 //----------------------------------------------------------------------------
 
 ////////////////////////////////////////////////////////////////////////////
-// INT_TimerA1
+// INT_Timer2A0
 //
-// Interrupt 0 for timer A2 (CCR0). Used in low power ACLK delay routine.
+// Interrupt 0 for timer A2 (CCR0). Expires all due alarms and reprograms
+// CCR0 for the next one.
 //
 ////////////////////////////////////////////////////////////////////////////
-#pragma vector=TIMER2_A0_VECTOR //TCCR0 Interrupt Vector for TIMER A1
+#pragma vector=TIMER2_A0_VECTOR //TCCR0 Interrupt Vector for TIMER A2
 __interrupt void INT_Timer2A0(void)
 {
-    if(wakeOnDelayTimer) {
-        __bic_SR_register_on_exit(LPM3_bits);
-        wakeOnDelayTimer = FALSE;
-    }
+    Timer_alarm_t* alarm;
 
-}
+    while ((TIMER_SM.head != 0) && ((int32_t) (TIMER_SM.head->due - Timer_now()) <= 0)) {
+        alarm = TIMER_SM.head;
+        TIMER_SM.head = alarm->next;
+        alarm->next = 0;
+        alarm->flags &= ~TIMER_ALARM_ACTIVE;
 
-//----------------------------------------------------------------------------
+        if (alarm->period) {
+            alarm->due += alarm->period;
+            Timer_insert(alarm);
+        }
 
+        if (alarm->flags & TIMER_ALARM_DEFERRED) {
+            if (!(alarm->flags & TIMER_ALARM_PENDING)) { // an overrun callback runs only once
+                alarm->flags |= TIMER_ALARM_PENDING;
+                if (TIMER_SM.pendingTail)
+                    TIMER_SM.pendingTail->nextPending = alarm;
+                else
+                    TIMER_SM.pendingHead = alarm;
+                TIMER_SM.pendingTail = alarm;
+            }
+        } else if (alarm->callback) {
+            alarm->callback();
+        }
+
+        TIMER_SM.fired++;
+    }
 
+    Timer_program();
 
+    if (TIMER_SM.isSleeping) {
+        TIMER_SM.isSleeping = FALSE;
+        __bic_SR_register_on_exit(LPM4_bits);
+    }
+}
 
+////////////////////////////////////////////////////////////////////////////
+// INT_Timer2A1
+//
+// Interrupt 1 for timer A2 (CCR1 and overflow). Extends the time base and
+// arms CCR0 once a far away alarm comes within one counter period.
+//
+////////////////////////////////////////////////////////////////////////////
+#pragma vector=TIMER2_A1_VECTOR
+__interrupt void INT_Timer2A1(void)
+{
+    switch (__even_in_range(TA2IV, TA2IV_TAIFG)) {
+    case TA2IV_TAIFG:
+        TIMER_SM.overflows++;
+        Timer_program();
+        break;
+    default:
+        break;
+    }
+}
+
+//----------------------------------------------------------------------------
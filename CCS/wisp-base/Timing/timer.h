@@ -26,11 +26,49 @@
 #define LP_LSDLY_2MS    66      // ~2ms at 32.768kHz
 #define LP_LSDLY_1MS    33      // ~1ms at 32.768kHz
 
+/*
+ * Alarm modes
+ */
+#define TIMER_ALARM_ISR         (0x00)  // Callback runs inside the Timer_A2 ISR
+#define TIMER_ALARM_DEFERRED    (0x01)  // Callback is queued and runs from Timer_dispatch()
+
+/*
+ * Alarm state bits (owned by the timer module)
+ */
+#define TIMER_ALARM_ACTIVE      (0x10)  // Alarm is in the timer list
+#define TIMER_ALARM_PENDING     (0x20)  // Deferred callback waits for Timer_dispatch()
+
+/**
+ * A software alarm. The memory is owned by the caller and must stay valid
+ *  while the alarm is active or pending (i.e. don't use stack variables which
+ *  go out of scope before Timer_stopAlarm()).
+ *
+ * All times are in ACLK ticks of Timer_A2.
+ */
+typedef struct Timer_alarm {
+    struct Timer_alarm* next;           // Next alarm in the sorted timer list
+    struct Timer_alarm* nextPending;    // Next alarm in the deferred callback queue
+    uint32_t due;                       // Absolute expiry time
+    uint32_t period;                    // Reload interval, 0 for a one-shot alarm
+    void (*callback)(void);             // Called on expiry, may be NULL
+    volatile uint8_t flags;             // TIMER_ALARM_* mode and state bits
+} Timer_alarm_t;
 
 /*
  * Function prototypes
  */
 
+void Timer_init(void);
+uint32_t Timer_now(void);
+
+void Timer_initAlarm(Timer_alarm_t* alarm, void (*callback)(void), uint8_t mode);
+void Timer_startAlarm(Timer_alarm_t* alarm, uint32_t delay, uint32_t period);
+void Timer_stopAlarm(Timer_alarm_t* alarm);
+BOOL Timer_isActive(Timer_alarm_t* alarm);
+
+uint8_t Timer_dispatch(void);
+void Timer_waitForEvent(void);
+
 void Timer_LooseDelay(uint16_t usTime32kHz);
 
 
@@ -125,12 +125,20 @@
 #define 	PDIR_ACCEL_INT2			(P3DIR)
 #define		PACCEL_INT2SEL0			(P3SEL0)
 #define		PACCEL_INT2SEL1			(P3SEL1)
+#define		PACCEL_INT2IN			(P3IN)
+#define		PACCEL_INT2IES			(P3IES)
+#define		PACCEL_INT2IE			(P3IE)
+#define		PACCEL_INT2IFG			(P3IFG)
 
 // P3.7 - ACCEL_INT1 - INPUT
 #define 	PIN_ACCEL_INT1			(BIT7)
 #define 	PDIR_ACCEL_INT1			(P3DIR)
 #define		PACCEL_INT1SEL0			(P3SEL0)
 #define		PACCEL_INT1SEL1			(P3SEL1)
+#define		PACCEL_INT1IN			(P3IN)
+#define		PACCEL_INT1IES			(P3IES)
+#define		PACCEL_INT1IE			(P3IE)
+#define		PACCEL_INT1IFG			(P3IFG)
 
 /*
  * Port 4
@@ -17,4 +17,46 @@
 
 	#define NUM_RN16_2_STORE 32
 
+	#define RAND_POOL_SIZE		8		/* words in the FRAM entropy pool */
+	#define RAND_HARVEST_WORDS	4		/* words of ADC noise collected by one RAND_startHarvest() */
+
+	#define WISP_EVENT_QUEUE_SIZE 8		/* depth of the RFID event queue, must be a power of two */
+	#define WISP_EPC_QUEUE_SIZE	4		/* EPCs waiting to be sent by the EPC queue, must be a power of two */
+	#define WISP_EPC_QUEUE_WORDS 24		/* longest EPC (in words) the EPC queue takes, at most MAX_EPC_WORDS */
+	#define LINK_STREAM_SIZE	128		/* bytes of uplink data the link estimator buffers, must be a power of two */
+	#define LINK_WINDOW			16		/* RN16 replies per link estimator window */
+	#define LINK_OVERHEAD_WORDS	12		/* air time of an inventory round besides the EPC reply, in EPC words */
+	#define LINK_PROBE_SHIFT	3		/* unused EPC lengths regain 1/2^n of their lost success per window */
+	#define WISP_DOWNLINK_QUEUE_SIZE 16	/* Write/BlockWrite records the downlink queue holds, must be a power of two */
+	#define CUSTOM_MAX_READ		64		/* data bytes one custom read reply can carry, at most RFIDBUFF_SIZE - 6 */
+	#define CUSTOM_MAX_WRITE	32		/* data bytes one custom bulk write can carry, sizes the command buffer */
+
+	#define TASK_MAX_TASKS		4		/* number of protothread slots in the task table */
+	#define TASK_STEPS_PER_IDLE	1		/* task steps taken per gap between reader commands */
+
+	#define HIBERNATE_APP_SIZE	64		/* bytes of application RAM WISP_hibernate() can carry across LPM4.5 */
+
+	#define WISP_BOOT_PROFILE	0		/* 1: Timer_A3 counts cycles from reset to the first reply, see WISP_getBootCycles() */
+
+	#define CKPT_STACK_SIZE		256		/* deepest stack (bytes) a checkpoint can save */
+	#define CKPT_MAX_REGIONS	8		/* RAM regions which can be registered with CKPT_addRegion() */
+	#define CKPT_DATA_SIZE		128		/* total bytes of the registered RAM regions */
+
+	#define KV_REGION_SIZE		512		/* bytes per half of the key/value log, FRAM use is twice this; even */
+	#define KV_MAX_KEYS			16		/* distinct keys the key/value index holds, must be a power of two */
+
+	#define LOG_DATA_SIZE		8		/* bytes of sensor data per log record, even */
+	#define LOG_CAPACITY		32		/* records in the FRAM log; all must be in reach of an RFID Read */
+
+	#define SUPPLY_DIVIDER		2		/* measured supply = ADC voltage * this (AVCC/2 channel, MEAS divider) */
+	#define SUPPLY_POLL_TICKS	470		/* ACLK ticks between supply checks while waiting for energy (~50ms) */
+
+	#define UART_TX_BUFFER_SIZE	32		/* bytes queued for the UART TX ISR, must be a power of two */
+	#define UART_RX_BUFFER_SIZE	32		/* bytes buffered by the UART RX ISR, must be a power of two */
+	#define UART_RX_IDLE_TICKS	20		/* ACLK ticks without DMA received data before the line counts as idle (~2ms) */
+	#define FRAME_MAX_PAYLOAD	64		/* largest UART frame payload in bytes, at most 249 */
+	#define FRAM_DMA_MIN_SIZE	16		/* bytes from which FRAM_write()/FRAM_read() use a DMA block transfer */
+	#define ADC_SAMPLE_BUFFER_SIZE 8	/* samples buffered by ADC_queueRead(), must be a power of two */
+	#define ACCEL_FIFO_MAX_SETS	16		/* largest ADXL362 FIFO watermark in XYZ sets, sizes the burst buffer (at most 170) */
+
 #endif /* WISPGUTS_H_ */
@@ -31,7 +31,7 @@
 /** @todo write the comments for 4 below so I can actually read them... */
 #define MAX_EPC_WORDS   (24)                                            /* length of EPC value in words, 0 <= n <= 31           */
 
-#define CMDBUFF_SIZE    (30)                                            /* ? */
+#define CMDBUFF_SIZE    (3+2+CUSTOM_MAX_WRITE+4)                        /* longest command is a custom bulk write (at least 30) */
 #define DATABUFF_MIN_SIZE   (2+(0<<1)+2)                                /* first2/last2 are reserved. put data into B2..B13     */
 #define DATABUFF_MAX_SIZE   (2+(MAX_EPC_WORDS<<1)+2)                    /* first2/last2 are reserved. put data into B2..B13     */
 
@@ -59,13 +59,14 @@
 //Goal is 56.125/62.500/68.875us. Trying to shoot for the lower to save (a little) power.
 //Note: 1 is minVal here due to the way decrement timing loop works. 0 will act like (0xFFFF+1)!
 #define TX_TIMING_QUERY (24)/*53.5-60us (depends on which Q value is loaded). */
-#define TX_TIMING_ACK   (20)/*60.0us*/  //(14,58.6us)
+#define TX_TIMING_ACK   (20)/*60.1us, 13 cycle TxFM0 setup*/  //(14,58.6us)
 
 #define TX_TIMING_QR    (52)//58.8us
 #define TX_TIMING_QA    (48)//60.0us
 #define TX_TIMING_REQRN (33)//60.4us
 #define TX_TIMING_READ  (29)//58.0us
 #define TX_TIMING_WRITE (31)//60.4us
+#define TX_TIMING_CUSTOM (29)//same as Read
 
 #define QUERY_TIMEOUT_PERIOD (16383>>1)
 
@@ -109,6 +110,19 @@ typedef struct {
     uint16_t    edge_capture_prev_ccr;      /* Previous value of CCR register, used to compute delta in edge capture ISRs		*/
 
     uint8_t     epcSize;
+    uint8_t     epcDirty;                   /* set when the EPC changed inside the RFID loop; StoredPC/CRC16 get rebuilt        */
+    uint8_t     epcSwap;                    /* WISP_commitEPC() finished the back buffer; swapped in between reader commands    */
+    uint8_t     epcBuffered;                /* EPC is double buffered (WISP_commitEPC()), so StoredPC/CRC16 are prebuilt        */
+    uint8_t     epcQueued;                  /* EPC queue is on; a confirmed ACK swaps in the staged EPC                         */
+    uint8_t     epcStaged;                  /* next queued EPC is built in the back buffer and waits for the ACK of the current */
+    uint8_t     epcAckPending;              /* queued EPC was ACKed; confirmed once the reader moves on to another command      */
+    uint8_t     epcAcked;                   /* ACK was confirmed while nothing was staged: the last queued EPC is delivered     */
+    uint8_t     replied;                    /* the reader's next command is due right away (after a reply, or after Select)     */
+
+    uint16_t    rnCount;                    /* RN16 replies sent (free running), input of the link estimator                    */
+    uint16_t    ackCount;                   /* ACKs answered with the EPC (free running)                                        */
+    uint16_t    ackRepeats;                 /* ACKs which repeated the handle of the previous one, i.e. the EPC reply was lost  */
+    uint16_t    ackHandle;                  /* handle of the last ACK                                                           */
 
     /** @todo Add the following: CMD_enum latestCmd; */
 
@@ -131,12 +145,28 @@ typedef struct {
     void*       *wrHook;                    /* this function is called with no params or return after a write command response  */
     void*       *bwrHook;                   /* this function is called with no params or return after a write command response  */
     void*       *rdHook;                    /* this function is called with no params or return after a read command response   */
+    void*       *idleHook;                  /* this function is called with no params or return between commands (RX_SM halted) */
+    void*       *bootHook;                  /* called once, from the idle/exit path after the first ACK reply, then cleared     */
+    void*       *cuHook;                    /* this function is called with no params or return after a custom command response */
+    uint8_t     evtMask;                    /* WISP_EVENT_* ids which are posted to the event queue after their response        */
+    uint8_t     dlMask;                     /* CMD_ID_WRITE/CMD_ID_BLOCKWRITE: commands which are queued on the downlink queue  */
+    uint8_t     dlFull;                     /* dlMask while the downlink queue is full, else 0; those get an error code reply   */
 
     //Memory Map Bank Ptrs
     uint8_t*    RESBankPtr;                 /* for read command, this is a pointer to the virtual, mapped Reserved Bank         */
     uint8_t*    EPCBankPtr;                 /* "" mapped EPC Bank                                                               */
     uint8_t*    TIDBankPtr;                 /* "" mapped TID Bank                                                               */
     uint8_t*    USRBankPtr;                 /* "" mapped USR Bank                                                               */
+
+    //Custom Command (0xE0 xx)
+    uint8_t     cuSub;                      /* for Custom, this will hold the sub opcode (CUSTOM_SUB_*) when hook is called     */
+    uint8_t     cuLen;                      /* for Custom, this will hold the payload length in bytes                           */
+    uint8_t     cuCount;                    /* for Custom, this will hold the number of data bytes read or written              */
+    uint16_t    cuOffset;                   /* for Custom, this will hold the byte offset into the region                       */
+    uint8_t*    cuRdPtr;                    /* region custom reads are served from                                              */
+    uint16_t    cuRdSize;                   /* "" its size in bytes                                                             */
+    uint8_t*    cuWrPtr;                    /* region custom bulk writes go to                                                  */
+    uint16_t    cuWrSize;                   /* "" its size in bytes                                                             */
 }RWstruct;
 
 // Boolean type
@@ -147,6 +177,7 @@ extern RWstruct     RWData;
 //Memory Banks
 extern uint8_t cmd      [CMDBUFF_SIZE];
 extern uint8_t dataBuf  [DATABUFF_MAX_SIZE];
+extern uint8_t dataBufAlt[DATABUFF_MAX_SIZE];
 extern uint8_t rfidBuf  [RFIDBUFF_SIZE];
 
 
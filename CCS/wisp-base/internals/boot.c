@@ -0,0 +1,120 @@
+/**
+ * @file boot.c
+ *
+ * Fast-boot support. On harvested power the tag resets all the time, and
+ *  every cycle spent between reset and the first reply shrinks the range at
+ *  which it still answers a Query.
+ *
+ *  - The RFID buffers which are overwritten anyway (cmd, rfidBuf, dataBuf)
+ *    are NOINIT, so the C startup code doesn't clear them.
+ *  - The EPC is taken from a copy in FRAM (WISP_saveEPC()), so it is valid
+ *    without waiting for a sensor.
+ *  - Slow peripheral bring-up can be handed to WISP_deferInit(), which runs
+ *    it once the reader has received the EPC.
+ *  - With WISP_BOOT_PROFILE set, Timer_A3 counts the MCLK cycles from reset
+ *    to the first RN16 reply (WISP_getBootCycles()).
+ */
+
+#include <string.h>
+#include "boot.h"
+
+#define BOOT_MAGIC          (0xE9C0)    // marks a complete EPC copy; written last
+#define BOOT_CYCLES_PER_TICK (64)       // Timer_A3 runs from SMCLK /8 /8
+
+/**
+ * FRAM copy of the EPC, loaded on every cold boot
+ */
+#pragma PERSISTENT(BOOT_epcCache)
+static struct {
+    uint16_t valid; // BOOT_MAGIC if the copy may be loaded
+    uint8_t epcSize; // EPC length in words
+    uint8_t epc[DATABUFF_MAX_SIZE - DATABUFF_MIN_SIZE];
+} BOOT_epcCache = { 0 };
+
+#if WISP_BOOT_PROFILE
+/**
+ * Called by the C startup code before the variables are initialized. Starts
+ *  the boot profiler; the RN16 handles stop it after the first reply.
+ *
+ * @return 1, so the startup code does initialize the variables
+ */
+int _system_pre_init(void) {
+    WDTCTL = WDTPW | WDTHOLD; // Stop watchdog timer, cinit may outlast it
+
+    TA3CTL = TACLR;
+    TA3EX0 = TAIDEX_7; // /8
+    TA3CTL = TASSEL__SMCLK | ID__8 | MC__CONTINUOUS; // SMCLK is MCLK at any clock setting
+
+    return 1;
+}
+#endif
+
+/**
+ * Load the EPC from the FRAM copy, or clear it if there is none. dataBuf is
+ *  not initialized by the startup code, so this must run on every cold boot.
+ */
+void BOOT_loadEPC(void) {
+    if (BOOT_epcCache.valid == BOOT_MAGIC) {
+        rfid.epcSize = BOOT_epcCache.epcSize;
+        memcpy(&dataBuf[2], BOOT_epcCache.epc, sizeof(BOOT_epcCache.epc));
+    } else {
+        memset(dataBuf, 0, DATABUFF_MAX_SIZE);
+    }
+}
+
+/**
+ * Store the current EPC (and its size) in FRAM, so the next cold boot can
+ *  answer with it right away. Nothing is written if the copy is up to date.
+ */
+void WISP_saveEPC(void) {
+    if ((BOOT_epcCache.valid == BOOT_MAGIC) && (BOOT_epcCache.epcSize == rfid.epcSize)
+            && !memcmp(BOOT_epcCache.epc, &RWData.EPCBankPtr[2], sizeof(BOOT_epcCache.epc)))
+        return;
+
+    // Invalidate first, so a power loss halfway leaves no torn EPC behind.
+    BOOT_epcCache.valid = 0;
+    BOOT_epcCache.epcSize = rfid.epcSize;
+    memcpy(BOOT_epcCache.epc, &RWData.EPCBankPtr[2], sizeof(BOOT_epcCache.epc));
+    BOOT_epcCache.valid = BOOT_MAGIC;
+}
+
+/**
+ * Forget the FRAM copy of the EPC; the next cold boot starts with all zeros.
+ */
+void WISP_clearSavedEPC(void) {
+    BOOT_epcCache.valid = 0;
+}
+
+/**
+ * Register a function which is called once, after the tag's first successful
+ *  ACK reply. Use it for peripheral bring-up which would otherwise delay the
+ *  first reply after power-up.
+ *
+ * @note It runs inside WISP_doRFID() at the first point after that ACK where
+ *  no reader command is due: the idle path (same as the idle hook), or on
+ *  return from WISP_doRFID(). It runs on the RX clock with interrupts
+ *  disabled, so it must not sleep, wait on interrupts or change the clock
+ *  setup.
+ */
+void WISP_deferInit(void(*fnPtr)(void)) {
+    RWData.bootHook = ((void*)(fnPtr));
+}
+
+/**
+ * @return MCLK cycles from reset to the first RN16 reply (with a resolution
+ *  of 64 cycles), 0 while no reply was sent yet or if WISP_BOOT_PROFILE is
+ *  off, and 0xFFFFFFFF if the measurement overflowed.
+ */
+uint32_t WISP_getBootCycles(void) {
+#if WISP_BOOT_PROFILE
+    if (TA3CTL & MC_3)
+        return 0; // still counting
+
+    if (TA3CTL & TAIFG)
+        return 0xFFFFFFFF;
+
+    return (uint32_t) TA3R * BOOT_CYCLES_PER_TICK;
+#else
+    return 0;
+#endif
+}
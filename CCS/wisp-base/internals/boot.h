@@ -0,0 +1,14 @@
+/**
+ * @file boot.h
+ *
+ * Internal interface between WISP_init() and the fast-boot support
+ */
+
+#ifndef BOOT_H_
+#define BOOT_H_
+
+#include "../globals.h"
+
+void BOOT_loadEPC(void);
+
+#endif /* BOOT_H_ */
@@ -0,0 +1,189 @@
+/**
+ * @file hibernate.c
+ *
+ * LPM4.5 hibernation with an FRAM snapshot of the RFID state.
+ *
+ * In LPM4.5 the core regulator is off and all of RAM is lost, so the next wake
+ *  goes through reset and the C startup code. WISP_hibernate() first copies
+ *  the RFID state, the EPC/USR buffers and one optional application region
+ *  into FRAM. WISP_init() detects the LPMx.5 wakeup (SYSRSTIV) and copies it
+ *  all back instead of loading the defaults.
+ *
+ * The wake source is the receive comparator on PIN_RX: the first falling
+ *  edge of a reader's delimiter brings the tag back up. That command itself is
+ *  lost during boot, but the reader will repeat it.
+ */
+
+#include "hibernate.h"
+#include "../nvm/fram.h"
+
+#define HIB_MAGIC   (0xB0A7)    // marks a complete snapshot; written last
+
+/**
+ * FRAM copy of everything needed to resume after LPM4.5
+ */
+typedef struct {
+    uint16_t valid; // HIB_MAGIC if the snapshot may be restored
+    RFIDstruct rfid;
+    RWstruct RWData;
+    uint8_t dataBuf[DATABUFF_MAX_SIZE];
+    uint8_t usrBank[USRBANK_SIZE];
+    void* appPtr; // Application region to restore (RAM address, same on every boot)
+    uint16_t appSize;
+    uint8_t app[HIBERNATE_APP_SIZE];
+} HIB_snapshot_t;
+
+#pragma PERSISTENT(HIB_snapshot)
+static HIB_snapshot_t HIB_snapshot = { 0 };
+
+/**
+ * State variables for the hibernation module
+ */
+static struct {
+    void* appPtr; // Application region to save
+    uint16_t appSize;
+    BOOL isWarmBoot; // Did the last WISP_init() restore a snapshot?
+    uint16_t resetReason; // First SYSRSTIV value read by WISP_init()
+} HIB_SM;
+
+/**
+ * Register one block of application RAM (e.g. a struct of sensor state) to
+ *  be carried across hibernation. It is restored during WISP_init(), before
+ *  main() gets control back.
+ *
+ * @param ptr start of the region, must be a static/global object
+ * @param size length in bytes, at most HIBERNATE_APP_SIZE
+ * @return SUCCESS, or FAIL if the region is too large
+ */
+BOOL WISP_setHibernateRegion(void* ptr, uint16_t size) {
+    if (size > HIBERNATE_APP_SIZE)
+        return FAIL;
+
+    HIB_SM.appPtr = ptr;
+    HIB_SM.appSize = size;
+    return SUCCESS;
+}
+
+/**
+ * @return TRUE if WISP_init() resumed from a hibernation snapshot, in which
+ *  case callbacks, modes, EPC and the registered application region are
+ *  already set up again.
+ */
+BOOL WISP_isWarmBoot(void) {
+    return HIB_SM.isWarmBoot;
+}
+
+/**
+ * @return the highest priority reset cause which SYSRSTIV reported during
+ *  WISP_init() (one of the SYSRSTIV_* values, SYSRSTIV_NONE if none). Reading
+ *  SYSRSTIV clears the cause, so this is the only way for the application to
+ *  see it.
+ */
+uint16_t WISP_resetReason(void) {
+    return HIB_SM.resetReason;
+}
+
+/**
+ * Save the RFID state to FRAM and enter LPM4.5. Does not return; execution
+ *  resumes at reset (and WISP_init() restores the state) once the receive
+ *  comparator sees a reader.
+ *
+ * @note Peripheral state (timers, alarms, ADC, SPI, ...) does not survive and
+ *  has to be set up again after a warm boot.
+ */
+void WISP_hibernate(void) {
+    __disable_interrupt();
+
+    // Invalidate first, so a power loss halfway leaves no torn snapshot behind.
+    HIB_snapshot.valid = 0;
+
+    HIB_snapshot.rfid = rfid;
+    HIB_snapshot.RWData = RWData;
+    FRAM_write(HIB_snapshot.dataBuf, RWData.EPCBankPtr, DATABUFF_MAX_SIZE); // the EPC which is being sent
+    FRAM_write(HIB_snapshot.usrBank, usrBank, USRBANK_SIZE);
+
+    HIB_snapshot.appPtr = HIB_SM.appPtr;
+    HIB_snapshot.appSize = HIB_SM.appSize;
+    if (HIB_SM.appPtr)
+        FRAM_write(HIB_snapshot.app, HIB_SM.appPtr, HIB_SM.appSize);
+
+    HIB_snapshot.valid = HIB_MAGIC;
+
+    // Keep the receive comparator powered; its output on PIN_RX is the wake source.
+    BITSET(PDIR_RX_EN, PIN_RX_EN);
+    BITSET(PRXEOUT, PIN_RX_EN);
+    BITCLR(PDIR_RX, PIN_RX);
+    BITCLR(PRXSEL0, PIN_RX);
+    BITCLR(PRXSEL1, PIN_RX);
+
+    BITSET(PRXIES, PIN_RX); // falling edge, like the start of a delimiter
+    BITCLR(PRXIFG, PIN_RX); // writing IES may have set the flag
+    BITSET(PRXIE, PIN_RX);
+
+    // Turn the core regulator off on the next LPM4 entry (LPM4.5).
+    PMMCTL0_H = PMMPW_H;
+    PMMCTL0_L |= PMMREGOFF;
+    PMMCTL0_L &= ~(SVSHE);
+    PMMCTL0_H = 0x00;
+
+    while (FOREVER) {
+        __bis_SR_register(LPM4_bits | GIE);
+        __no_operation();
+    }
+}
+
+/**
+ * Called from WISP_init() once the default IO is set up and unlocked.
+ *
+ * @return TRUE if the device woke from LPM4.5 and the snapshot was restored
+ */
+BOOL HIB_restore(void) {
+    uint16_t reason;
+    BOOL isLPM5Wakeup = FALSE;
+
+    // Drain the reset vector generator; the LPMx.5 wakeup may not be the first cause listed.
+    // The first one is the highest priority cause, keep it for WISP_resetReason().
+    reason = SYSRSTIV;
+    HIB_SM.resetReason = reason;
+    while (reason != SYSRSTIV_NONE) {
+        if (reason == SYSRSTIV_LPM5WU)
+            isLPM5Wakeup = TRUE;
+        reason = SYSRSTIV;
+    }
+
+    HIB_SM.isWarmBoot = FALSE;
+
+    if (!isLPM5Wakeup || (HIB_snapshot.valid != HIB_MAGIC))
+        return FALSE;
+
+    rfid = HIB_snapshot.rfid;
+    RWData = HIB_snapshot.RWData;
+    FRAM_read(dataBuf, HIB_snapshot.dataBuf, DATABUFF_MAX_SIZE);
+    RWData.EPCBankPtr = &dataBuf[0];
+    FRAM_read(usrBank, HIB_snapshot.usrBank, USRBANK_SIZE);
+
+    HIB_SM.appPtr = HIB_snapshot.appPtr;
+    HIB_SM.appSize = HIB_snapshot.appSize;
+    if (HIB_SM.appPtr)
+        FRAM_read(HIB_SM.appPtr, HIB_snapshot.app, HIB_SM.appSize);
+
+    // One snapshot is good for one wakeup only.
+    HIB_snapshot.valid = 0;
+
+    // Wake flag is still set on the RX pin; nobody needs the interrupt.
+    BITCLR(PRXIE, PIN_RX);
+    BITCLR(PRXIFG, PIN_RX);
+
+    // Interrupted inventory round can't be resumed, start clean on the next command.
+    rfid.abortFlag = FALSE;
+    rfid.epcDirty = FALSE;
+    rfid.epcSwap = FALSE; // the back buffer is gone
+    rfid.epcQueued = FALSE; // and so is the EPC queue
+    rfid.epcStaged = FALSE;
+    rfid.epcAckPending = FALSE;
+    rfid.epcAcked = FALSE;
+    RWData.dlFull = 0; // the downlink queue is in RAM and comes back empty
+
+    HIB_SM.isWarmBoot = TRUE;
+    return TRUE;
+}
@@ -0,0 +1,14 @@
+/**
+ * @file hibernate.h
+ *
+ * Internal interface between WISP_init() and the LPM4.5 hibernation module
+ */
+
+#ifndef HIBERNATE_H_
+#define HIBERNATE_H_
+
+#include "../globals.h"
+
+BOOL HIB_restore(void);
+
+#endif /* HIBERNATE_H_ */
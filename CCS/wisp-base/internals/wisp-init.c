@@ -7,14 +7,23 @@
  */
 
 #include "../globals.h"
+#include "hibernate.h"
+#include "boot.h"
+#include "../rand/rand.h"
 
 // Gen2 state variables
 RFIDstruct  rfid;   // inventory state
 RWstruct    RWData; // tag-access state
 
-// Buffers for Gen2 protocol data
+// Buffers for Gen2 protocol data. These are always written before they are
+//  read (dataBuf by BOOT_loadEPC()), so the startup code doesn't clear them.
+#pragma NOINIT(cmd)
+#pragma NOINIT(dataBuf)
+#pragma NOINIT(dataBufAlt)
+#pragma NOINIT(rfidBuf)
 uint8_t cmd[CMDBUFF_SIZE];          // command from reader
 uint8_t dataBuf[DATABUFF_MAX_SIZE]; // tag's response to reader
+uint8_t dataBufAlt[DATABUFF_MAX_SIZE]; // other half of the double buffered EPC (WISP_commitEPC())
 uint8_t rfidBuf[RFIDBUFF_SIZE];     // internal buffer used by RFID handles
 
 /*
@@ -43,17 +52,17 @@ void WISP_init(void) {
 
 	WDTCTL = WDTPW | WDTHOLD;	// Stop watchdog timer
 
+	// Setup default IO (before unlocking, so pins go straight from their LPMx.5 state to these)
+	setupDflt_IO();
+
+    PRXEOUT |= PIN_RX_EN; /** TODO: enable PIN_RX_EN only when needed in the future */
+
 	// Disable the GPIO power-on default high-impedance mode to activate previously configured port settings.
 	PM5CTL0 &= ~LOCKLPM5;		// Lock LPM5.
 
 	// Disable FRAM wait cycles to allow clock operation over 8MHz
 	FRCTL0 = 0xA500 | ((1) << 4);  //FRCTLPW | NWAITS_1;
 
-	// Setup default IO
-	setupDflt_IO();
-
-    PRXEOUT |= PIN_RX_EN; /** TODO: enable PIN_RX_EN only when needed in the future */
-
     CSCTL0_H = 0xA5;
     CSCTL1 = DCOFSEL_0; //1MHz
     CSCTL2 = SELA__VLOCLK + SELS_3 + SELM_3;
@@ -61,6 +70,15 @@ void WISP_init(void) {
     //BITCLR(CSCTL6 , (MODCLKREQEN|SMCLKREQEN|MCLKREQEN));
     //BITSET(CSCTL6 , ACLKREQEN);
 
+    isDoingLowPwrSleep = FALSE;
+
+    // RN16 table is in RAM, so it is needed after a hibernation wakeup, too
+    RAND_init();
+
+    // Resuming from WISP_hibernate()? Then the RFID state is back already.
+    if (HIB_restore())
+        return;
+
     // Initialize Gen2 standard memory banks
     RWData.EPCBankPtr = &dataBuf[0];                    // volatile
     RWData.RESBankPtr = (uint8_t*) MEM_MAP_INFOC_START; // nonvolatile
@@ -71,14 +89,38 @@ void WISP_init(void) {
     rfid.isSelected = TRUE;
     rfid.abortOn    = 0x00;
     rfid.epcSize    = 6;                                // backwards compatible
-
-    isDoingLowPwrSleep = FALSE;
+    rfid.epcDirty   = FALSE;
+    rfid.epcSwap    = FALSE;
+    rfid.epcBuffered = FALSE;
+    rfid.epcQueued  = FALSE;
+    rfid.epcStaged  = FALSE;
+    rfid.epcAckPending = FALSE;
+    rfid.epcAcked   = FALSE;
+    rfid.replied    = FALSE;
+    rfid.rnCount    = 0;
+    rfid.ackCount   = 0;
+    rfid.ackRepeats = 0;
+    rfid.ackHandle  = 0;
+
+    // EPC from the last WISP_saveEPC(), if any (may override epcSize)
+    BOOT_loadEPC();
 
     // Initialize callbacks to null in case user doesn't configure them
+    RWData.rnHook =0;
     RWData.akHook =0;
     RWData.rdHook =0;
     RWData.wrHook =0;
     RWData.bwrHook=0;
+    RWData.idleHook=0;
+    RWData.bootHook=0;
+    RWData.cuHook=0;
+    RWData.evtMask=0;
+    RWData.dlMask=0;
+    RWData.dlFull=0;
+    RWData.cuRdPtr=0;
+    RWData.cuRdSize=0;
+    RWData.cuWrPtr=0;
+    RWData.cuWrSize=0;
 
     return;
 }
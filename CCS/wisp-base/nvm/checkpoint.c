@@ -0,0 +1,241 @@
+/**
+ * @file checkpoint.c
+ *
+ * Checkpoint/restore of application state in FRAM.
+ *
+ * A checkpoint holds the CPU registers, the used part of the stack and the
+ *  RAM regions registered with CKPT_addRegion(). There are two slots in FRAM
+ *  and a checkpoint always goes to the one which is not committed; a single
+ *  word write of the commit marker then switches over. A power failure at
+ *  any point thus leaves either the old or the new checkpoint behind, never a
+ *  torn one.
+ *
+ * After a reset, CKPT_restore() copies the committed checkpoint back and
+ *  continues right behind the CKPT_checkpoint() call which took it, which
+ *  then returns CKPT_RESTORED. Call it from main() once WISP_init() and the
+ *  peripheral setup are done; only RAM and CPU state are restored.
+ *
+ * Checkpoints are taken explicitly with CKPT_checkpoint(), or at a safe point
+ *  with CKPT_poll() after CKPT_request() (callable from any ISR, e.g. on a
+ *  low supply voltage) or a periodic CKPT_setInterval() alarm.
+ *
+ * @note Code between two checkpoints may run more than once. Writes to FRAM
+ *  variables (PERSISTENT) in that window must be idempotent.
+ */
+
+#include "checkpoint.h"
+#include "fram.h"
+#include "../Timing/timer.h"
+
+#define CKPT_MAGIC  (0xC4A0)    // commit marker, bit 0 selects the slot
+
+/**
+ * A registered RAM region
+ */
+typedef struct {
+    void* ptr;
+    uint16_t size;
+} CKPT_region_t;
+
+/**
+ * One checkpoint
+ */
+typedef struct {
+    CKPT_context_t ctx;
+    uint16_t stackSize; // Bytes from ctx.sp to the top of the stack
+    uint8_t stack[CKPT_STACK_SIZE];
+    uint8_t numRegions;
+    CKPT_region_t regions[CKPT_MAX_REGIONS];
+    uint8_t data[CKPT_DATA_SIZE]; // Contents of the regions, back to back
+} CKPT_slot_t;
+
+#pragma PERSISTENT(CKPT_slots)
+static CKPT_slot_t CKPT_slots[2] = { 0 };
+
+#pragma PERSISTENT(CKPT_commit)
+static uint16_t CKPT_commit = 0; // CKPT_MAGIC | slot index, or 0 if there is no checkpoint
+
+extern uint16_t __STACK_END; // Top of the stack, defined by the linker
+
+/**
+ * State variables for the checkpoint module
+ */
+static struct {
+    CKPT_region_t regions[CKPT_MAX_REGIONS]; // Regions saved by the next checkpoint
+    uint8_t numRegions;
+    uint16_t dataSize; // Sum of the region sizes
+    volatile BOOL isRequested; // Take a checkpoint on the next CKPT_poll()
+    Timer_alarm_t alarm; // Periodic request, see CKPT_setInterval()
+} CKPT_SM;
+
+//----------------------------------------------------------------------------
+
+/**
+ * @return the committed slot, or NULL if there is no checkpoint
+ */
+static CKPT_slot_t* CKPT_committed(void) {
+    if ((CKPT_commit & ~0x0001) != CKPT_MAGIC)
+        return 0;
+
+    return &CKPT_slots[CKPT_commit & 0x0001];
+}
+
+/**
+ * Fill a slot whose context was just saved, then commit it. Must not be
+ *  inlined: its frame has to lie below the saved stack pointer.
+ *
+ * @pre interrupts are disabled
+ */
+#pragma FUNC_CANNOT_INLINE(CKPT_commitSlot)
+static void CKPT_commitSlot(uint8_t idx) {
+    CKPT_slot_t* slot = &CKPT_slots[idx];
+    uint8_t* data = slot->data;
+    uint8_t i;
+
+    FRAM_write(slot->stack, (void*) (uint16_t) slot->ctx.sp, slot->stackSize);
+
+    slot->numRegions = CKPT_SM.numRegions;
+    for (i = 0; i < CKPT_SM.numRegions; i++) {
+        slot->regions[i] = CKPT_SM.regions[i];
+        FRAM_write(data, CKPT_SM.regions[i].ptr, CKPT_SM.regions[i].size);
+        data += CKPT_SM.regions[i].size;
+    }
+
+    CKPT_commit = CKPT_MAGIC | idx;
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Add a RAM region (e.g. a struct of application state) to every following
+ *  checkpoint.
+ *
+ * @param ptr start of the region, must be a static/global object
+ * @param size length in bytes
+ * @return SUCCESS, or FAIL if CKPT_MAX_REGIONS or CKPT_DATA_SIZE is exceeded
+ */
+BOOL CKPT_addRegion(void* ptr, uint16_t size) {
+    if ((CKPT_SM.numRegions >= CKPT_MAX_REGIONS) || (size > (CKPT_DATA_SIZE - CKPT_SM.dataSize)))
+        return FAIL;
+
+    CKPT_SM.regions[CKPT_SM.numRegions].ptr = ptr;
+    CKPT_SM.regions[CKPT_SM.numRegions].size = size;
+    CKPT_SM.numRegions++;
+    CKPT_SM.dataSize += size;
+    return SUCCESS;
+}
+
+/**
+ * Remove all registered regions.
+ */
+void CKPT_clearRegions(void) {
+    CKPT_SM.numRegions = 0;
+    CKPT_SM.dataSize = 0;
+}
+
+/**
+ * Take a checkpoint.
+ *
+ * @return CKPT_SAVED after the checkpoint was committed, CKPT_RESTORED when
+ *  CKPT_restore() resumed from it after a reset, or CKPT_FAILED if the stack
+ *  is deeper than CKPT_STACK_SIZE
+ */
+uint8_t CKPT_checkpoint(void) {
+    uint8_t idx = (CKPT_committed() == &CKPT_slots[0]) ? 1 : 0;
+    uint16_t state = __get_interrupt_state();
+
+    // An ISR must not change the stack between the context save and the commit.
+    __disable_interrupt();
+
+    if (CKPT_saveContext(&CKPT_slots[idx].ctx) != 0) {
+        __set_interrupt_state(state);
+        return CKPT_RESTORED;
+    }
+
+    CKPT_slots[idx].stackSize = (uint16_t) &__STACK_END - (uint16_t) CKPT_slots[idx].ctx.sp;
+    if (CKPT_slots[idx].stackSize > CKPT_STACK_SIZE) {
+        __set_interrupt_state(state);
+        return CKPT_FAILED;
+    }
+
+    CKPT_commitSlot(idx);
+
+    __set_interrupt_state(state);
+    return CKPT_SAVED;
+}
+
+/**
+ * Resume from the committed checkpoint, if there is one. Does not return in
+ *  that case; the CKPT_checkpoint() call which took it returns CKPT_RESTORED.
+ */
+void CKPT_restore(void) {
+    CKPT_slot_t* slot = CKPT_committed();
+    uint8_t* data;
+    uint8_t i;
+
+    if (slot == 0)
+        return;
+
+    __disable_interrupt();
+
+    // Later checkpoints save the same regions as the restored one.
+    CKPT_clearRegions();
+    data = slot->data;
+    for (i = 0; i < slot->numRegions; i++) {
+        FRAM_read(slot->regions[i].ptr, data, slot->regions[i].size);
+        CKPT_addRegion(slot->regions[i].ptr, slot->regions[i].size);
+        data += slot->regions[i].size;
+    }
+
+    CKPT_restoreContext(&slot->ctx, slot->stack, slot->stackSize);
+}
+
+/**
+ * Drop the committed checkpoint; the next boot starts from main() again.
+ */
+void CKPT_discard(void) {
+    CKPT_commit = 0;
+}
+
+/**
+ * @return TRUE if there is a checkpoint to restore
+ */
+BOOL CKPT_isValid(void) {
+    return (CKPT_committed() != 0) ? TRUE : FALSE;
+}
+
+/**
+ * Ask for a checkpoint at the next CKPT_poll(). Safe to call from an ISR.
+ */
+void CKPT_request(void) {
+    CKPT_SM.isRequested = TRUE;
+}
+
+/**
+ * Take a checkpoint if one was requested. Call at points where the
+ *  application state is consistent.
+ *
+ * @return CKPT_NONE if there was no request, else as CKPT_checkpoint()
+ */
+uint8_t CKPT_poll(void) {
+    if (!CKPT_SM.isRequested)
+        return CKPT_NONE;
+
+    CKPT_SM.isRequested = FALSE;
+    return CKPT_checkpoint();
+}
+
+/**
+ * Request a checkpoint periodically.
+ *
+ * @param ticks ACLK ticks between requests, 0 to stop
+ */
+void CKPT_setInterval(uint32_t ticks) {
+    Timer_stopAlarm(&CKPT_SM.alarm);
+
+    if (ticks == 0)
+        return;
+
+    Timer_initAlarm(&CKPT_SM.alarm, &CKPT_request, TIMER_ALARM_ISR);
+    Timer_startAlarm(&CKPT_SM.alarm, ticks, ticks);
+}
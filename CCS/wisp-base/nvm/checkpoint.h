@@ -0,0 +1,52 @@
+/**
+ * @file checkpoint.h
+ *
+ * Checkpoint/restore of application state in FRAM, for computations which
+ *  have to make progress across power failures.
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include "../globals.h"
+
+/*
+ * Return values of CKPT_checkpoint() and CKPT_poll()
+ */
+#define CKPT_NONE       (0)     // No checkpoint was requested
+#define CKPT_SAVED      (1)     // A checkpoint was taken, execution continues
+#define CKPT_RESTORED   (2)     // Execution resumed here after a power failure
+#define CKPT_FAILED     (3)     // Stack or registered regions don't fit, nothing was saved
+
+/**
+ * CPU context saved by CKPT_saveContext(). The field offsets are used by
+ *  checkpoint_ctx.asm and must not change.
+ */
+typedef struct {
+    uint32_t pc;        // 0: return address of CKPT_saveContext()
+    uint32_t sp;        // 4: stack pointer after that return
+    uint32_t r[7];      // 8: R4..R10 (callee-saved)
+    uint16_t sr;        // 36: status register
+} CKPT_context_t;
+
+/*
+ * Function prototypes
+ */
+
+BOOL CKPT_addRegion(void* ptr, uint16_t size);
+void CKPT_clearRegions(void);
+
+uint8_t CKPT_checkpoint(void);
+void CKPT_restore(void);
+void CKPT_discard(void);
+BOOL CKPT_isValid(void);
+
+void CKPT_request(void);
+uint8_t CKPT_poll(void);
+void CKPT_setInterval(uint32_t ticks);
+
+// Implemented in checkpoint_ctx.asm
+uint16_t CKPT_saveContext(CKPT_context_t* ctx);
+void CKPT_restoreContext(CKPT_context_t* ctx, uint8_t* stack, uint16_t numBytes);
+
+#endif /* CHECKPOINT_H_ */
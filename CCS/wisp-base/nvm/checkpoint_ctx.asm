@@ -0,0 +1,77 @@
+;/***********************************************************************************************************************************/
+;/**@file		checkpoint_ctx.asm
+;* 	@brief		CPU context save/restore for the FRAM checkpoints (see checkpoint.c)
+;* 	@details	CKPT_saveContext() works like setjmp(): it returns 0 after saving, and "returns" again with a non-zero value
+;*				when CKPT_restoreContext() resumes from the saved context.
+;*
+;* 	@notes		Offsets into CKPT_context_t: pc 0, sp 4, R4..R10 8..32, sr 36
+;*				Only R4..R10 are saved; R11..R15 are caller-saved and hold nothing across the call.
+;*/
+;/***********************************************************************************************************************************/
+
+	.def	CKPT_saveContext, CKPT_restoreContext
+
+R_ctx		.set	R12				; Entry: CKPT_context_t*
+R_src		.set	R13				; Entry (restore): saved stack image
+R_numBytes	.set	R14				; Entry (restore): length of the stack image
+R_scratch0	.set	R15
+
+;*************************************************************************************************************************************
+;	uint16_t CKPT_saveContext(CKPT_context_t* ctx)																					 *
+;*************************************************************************************************************************************
+CKPT_saveContext:
+	MOVA	@SP, R_scratch0			;[] return address (CALLA pushed 20 bits)
+	MOVA	R_scratch0, 0(R_ctx)	;[] ctx->pc
+	MOVA	SP, R_scratch0			;[]
+	ADDA	#4, R_scratch0			;[] SP as the caller sees it after RETA
+	MOVA	R_scratch0, 4(R_ctx)	;[] ctx->sp
+
+	MOVA	R4, 8(R_ctx)			;[] callee-saved registers
+	MOVA	R5, 12(R_ctx)			;[]
+	MOVA	R6, 16(R_ctx)			;[]
+	MOVA	R7, 20(R_ctx)			;[]
+	MOVA	R8, 24(R_ctx)			;[]
+	MOVA	R9, 28(R_ctx)			;[]
+	MOVA	R10, 32(R_ctx)			;[]
+	MOV		SR, 36(R_ctx)			;[] ctx->sr
+
+	CLR		R12						;[] return 0: context saved
+	RETA
+
+;*************************************************************************************************************************************
+;	void CKPT_restoreContext(CKPT_context_t* ctx, uint8_t* stack, uint16_t numBytes)												 *
+;	Does not return. The stack image is copied over the live stack, so nothing here may use the stack.								 *
+;*************************************************************************************************************************************
+CKPT_restoreContext:
+	DINT							;[]
+	NOP								;[]
+
+	MOVA	4(R_ctx), SP			;[] move to the saved stack pointer
+	MOVA	SP, R_scratch0			;[] destination of the stack image
+
+restoreStack:
+	TST		R_numBytes				;[]
+	JZ		restoreRegs				;[]
+	MOV		@R_src+, 0(R_scratch0)	;[] stack is word aligned
+	ADDA	#2, R_scratch0			;[]
+	SUB		#2, R_numBytes			;[]
+	JMP		restoreStack			;[]
+
+restoreRegs:
+	MOVA	8(R_ctx), R4			;[]
+	MOVA	12(R_ctx), R5			;[]
+	MOVA	16(R_ctx), R6			;[]
+	MOVA	20(R_ctx), R7			;[]
+	MOVA	24(R_ctx), R8			;[]
+	MOVA	28(R_ctx), R9			;[]
+	MOVA	32(R_ctx), R10			;[]
+
+	MOVA	0(R_ctx), R_scratch0	;[] resume address
+	MOV		36(R_ctx), R_src		;[] saved SR (with the interrupt state of the checkpoint)
+	MOV		#1, R12					;[] CKPT_saveContext() returns 1: context restored
+	NOP								;[]
+	MOV		R_src, SR				;[]
+	NOP								;[]
+	BRA		R_scratch0				;[] back into CKPT_saveContext()'s caller
+
+	.end
@@ -0,0 +1,225 @@
+/**
+ * @file datalog.c
+ *
+ * Power fail safe ring log in FRAM, readable as the RFID User bank.
+ *
+ * Head and tail share one FRAM word, so a single (atomic) word write commits
+ *  a new record, an acknowledgement or both. A record is written into its slot
+ *  before the head moves over it, so a power loss at any point leaves either
+ *  the old or the new state, never a half written record in view.
+ *
+ * Reads need no help from the CPU: the Read handle copies straight out of the
+ *  FRAM bank. Only acknowledgements (a Write to User bank word 0) run code,
+ *  from the write hook inside WISP_doRFID().
+ */
+
+#include "datalog.h"
+#include "../RFID/rfid.h"
+#include "../Timing/timer.h"
+#include "fram.h"
+
+#define LOG_RECORD_WORDS    (sizeof(LOG_record_t) / 2)
+#define LOG_WRAP            (2 * LOG_CAPACITY)  // head and tail count modulo this
+
+#if (LOG_DATA_SIZE & 1)
+#error LOG_DATA_SIZE must be even
+#endif
+
+#if (LOG_CAPACITY > 127)
+#error LOG_CAPACITY must fit head and tail into one byte each
+#endif
+
+// The Read handle takes an 8-bit word pointer
+#if (LOG_FIRST_WORD + (LOG_CAPACITY - 1) * ((LOG_DATA_SIZE + 6) / 2) > 255)
+#error The last log slot is out of reach of the Read command, lower LOG_CAPACITY
+#endif
+
+/**
+ * The FRAM image of the log, mapped as the User bank
+ */
+typedef struct {
+    uint16_t ptrs; // (head << 8) | tail, written as one word
+    uint8_t capacity;
+    uint8_t recWords;
+    uint16_t dropped;
+    uint16_t nextSeq;
+    LOG_record_t rec[LOG_CAPACITY];
+} LOG_bank_t;
+
+#pragma PERSISTENT(LOG_bank)
+static LOG_bank_t LOG_bank = { 0 };
+
+#define LOG_HEAD(ptrs)  ((uint8_t) ((ptrs) >> 8))
+#define LOG_TAIL(ptrs)  ((uint8_t) (ptrs))
+
+//----------------------------------------------------------------------------
+
+static uint8_t LOG_next(uint8_t idx) {
+    return (idx + 1 < LOG_WRAP) ? idx + 1 : 0;
+}
+
+static uint16_t LOG_used(uint16_t ptrs) {
+    int16_t n = (int16_t) LOG_HEAD(ptrs) - LOG_TAIL(ptrs);
+
+    return (n < 0) ? n + LOG_WRAP : n;
+}
+
+static uint8_t LOG_slot(uint8_t idx) {
+    return (idx < LOG_CAPACITY) ? idx : idx - LOG_CAPACITY;
+}
+
+/**
+ * Write hook for LOG_attachToRFID()
+ */
+static void LOG_writeHook(void) {
+    LOG_handleWrite();
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Check the FRAM log and start over if it was built with another
+ *  LOG_CAPACITY or LOG_DATA_SIZE (or never). Records survive resets and
+ *  power loss otherwise.
+ */
+void LOG_init(void) {
+    Timer_init();
+
+    if ((LOG_bank.capacity != LOG_CAPACITY) || (LOG_bank.recWords != LOG_RECORD_WORDS)) {
+        LOG_bank.ptrs = 0;
+        LOG_bank.dropped = 0;
+        LOG_bank.nextSeq = 0;
+        LOG_bank.recWords = LOG_RECORD_WORDS;
+        LOG_bank.capacity = LOG_CAPACITY;
+    }
+}
+
+/**
+ * Add a record, stamped with Timer_now(). A full log loses its oldest record.
+ *  Safe to call from an ISR.
+ *
+ * @param data LOG_DATA_SIZE bytes
+ * @return SUCCESS, or FAIL if the oldest record had to be dropped
+ */
+BOOL LOG_append(const void* data) {
+    uint16_t state = __get_interrupt_state();
+    BOOL result = SUCCESS;
+    uint16_t ptrs;
+    LOG_record_t* rec;
+
+    __disable_interrupt();
+
+    ptrs = LOG_bank.ptrs;
+
+    // Make room first; the slot to be written must be out of view
+    if (LOG_used(ptrs) >= LOG_CAPACITY) {
+        ptrs = (ptrs & 0xFF00) | LOG_next(LOG_TAIL(ptrs));
+        LOG_bank.ptrs = ptrs;
+        LOG_bank.dropped++;
+        result = FAIL;
+    }
+
+    rec = &LOG_bank.rec[LOG_slot(LOG_HEAD(ptrs))];
+    rec->seq = LOG_bank.nextSeq;
+    rec->time = Timer_now();
+    FRAM_write(rec->data, data, LOG_DATA_SIZE);
+
+    // A lost power here only skips a sequence number
+    LOG_bank.nextSeq++;
+
+    LOG_bank.ptrs = ((uint16_t) LOG_next(LOG_HEAD(ptrs)) << 8) | LOG_TAIL(ptrs);
+
+    __set_interrupt_state(state);
+    return result;
+}
+
+/**
+ * Drop all records up to and including a sequence number, because a reader
+ *  has them now.
+ *
+ * @param seq sequence number of the newest record the reader consumed
+ * @return SUCCESS, or FAIL if no such record is held
+ */
+BOOL LOG_acknowledge(uint16_t seq) {
+    uint16_t state = __get_interrupt_state();
+    uint16_t ptrs;
+    uint16_t n;
+    uint8_t tail;
+
+    __disable_interrupt();
+
+    ptrs = LOG_bank.ptrs;
+    n = LOG_used(ptrs);
+
+    if (n)
+        n = seq - LOG_bank.rec[LOG_slot(LOG_TAIL(ptrs))].seq + 1;
+
+    if ((n == 0) || (n > LOG_used(ptrs))) {
+        __set_interrupt_state(state);
+        return FAIL;
+    }
+
+    tail = LOG_TAIL(ptrs);
+    while (n--)
+        tail = LOG_next(tail);
+
+    LOG_bank.ptrs = (ptrs & 0xFF00) | tail;
+
+    __set_interrupt_state(state);
+    return SUCCESS;
+}
+
+/**
+ * Drop all records.
+ */
+void LOG_clear(void) {
+    uint16_t ptrs = LOG_bank.ptrs;
+
+    LOG_bank.ptrs = (ptrs & 0xFF00) | LOG_HEAD(ptrs);
+}
+
+/**
+ * @return number of records held
+ */
+uint16_t LOG_count(void) {
+    return LOG_used(LOG_bank.ptrs);
+}
+
+/**
+ * @return number of records lost because the log was full
+ */
+uint16_t LOG_dropped(void) {
+    return LOG_bank.dropped;
+}
+
+/**
+ * Serve the log as the User bank and take acknowledgements from Writes to its
+ *  word 0. Replaces the WRITE callback; an application which needs its own
+ *  should register it afterwards and call LOG_handleWrite() from it. The
+ *  reader also needs MODE_READ | MODE_WRITE (WISP_setMode()).
+ */
+void LOG_attachToRFID(void) {
+    RWData.USRBankPtr = (uint8_t*) &LOG_bank;
+    WISP_registerCallback_WRITE(&LOG_writeHook);
+}
+
+/**
+ * Give the User bank back to usrBank.
+ */
+void LOG_detachFromRFID(void) {
+    RWData.USRBankPtr = &usrBank[0];
+    WISP_registerCallback_WRITE(0);
+}
+
+/**
+ * Handle the last Write command if it was meant for the log.
+ *
+ * @return TRUE if it was an acknowledgement (User bank word 0)
+ */
+BOOL LOG_handleWrite(void) {
+    if ((RWData.memBank != 3) || (RWData.wordPtr != 0))
+        return FALSE;
+
+    LOG_acknowledge(RWData.wrData);
+    return TRUE;
+}
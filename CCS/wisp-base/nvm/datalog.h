@@ -0,0 +1,49 @@
+/**
+ * @file datalog.h
+ *
+ * Ring log of timestamped sensor records in FRAM, drained by a reader
+ *  through the RFID User memory bank.
+ *
+ * User bank layout (word addresses, words are little endian):
+ *  - 0: (head << 8) | tail. Both count modulo 2 * capacity; the oldest record
+ *       is in slot tail % capacity, and (head - tail) mod 2 * capacity
+ *       records are held. Writing a sequence number here acknowledges that
+ *       record and all older ones.
+ *  - 1: (record size in words << 8) | capacity
+ *  - 2: records lost because the log was full
+ *  - 3: sequence number of the next record
+ *  - LOG_FIRST_WORD + slot * record size: LOG_record_t of each slot
+ */
+
+#ifndef DATALOG_H_
+#define DATALOG_H_
+
+#include "../globals.h"
+
+#define LOG_FIRST_WORD  (4)     // User bank word of slot 0
+
+/**
+ * One log record
+ */
+typedef struct {
+    uint16_t seq; // Sequence number, counts up by one per record
+    uint32_t time; // Timer_now() when the record was added
+    uint8_t data[LOG_DATA_SIZE];
+} LOG_record_t;
+
+/*
+ * Function prototypes
+ */
+
+void LOG_init(void);
+BOOL LOG_append(const void* data);
+BOOL LOG_acknowledge(uint16_t seq);
+void LOG_clear(void);
+uint16_t LOG_count(void);
+uint16_t LOG_dropped(void);
+
+void LOG_attachToRFID(void);
+void LOG_detachFromRFID(void);
+BOOL LOG_handleWrite(void);
+
+#endif /* DATALOG_H_ */
@@ -3,311 +3,151 @@
  *
  * Provides access routines for FRAM non-volatile memory in the MSP430FR5xxx
  *
+ * Copies of FRAM_DMA_MIN_SIZE bytes and more are done as one DMA block
+ *  transfer, which halts the CPU until it is done and moves a word every two
+ *  MCLK cycles. Shorter copies, and all copies while a driver holds the DMA
+ *  channel, fall back to a CPU loop. Either way words are moved whenever
+ *  source and destination share their alignment, with single bytes only at an
+ *  odd start or end.
+ *
+ * FRAM_init() write protects the information memory (InfoA-D) with the MPU.
+ *  FRAM_write() lifts the protection only for the duration of its own copy.
+ *
  * @author Saman Naderiparizi, Aaron Parks
  */
 
-#include <msp430.h>
 #include "fram.h"
+#include "../wired/dma.h"
+
+#define MPU_ALL_WE  (MPUSEG1WE | MPUSEG2WE | MPUSEG3WE | MPUSEGIWE)
 
 /**
- * Call before writing anything to FRAM
+ * Move a block with the DMA.
+ *
+ * @param unit 0 for words, DMASRCBYTE | DMADSTBYTE for bytes
+ * @param size number of units
+ * @return SUCCESS, or FAIL if the channel is in use
  */
-void FRAM_init(void){
-
-	FRCTL0_H |= (FWPW) >> 8;
-	__delay_cycles(3);
-}
-
-////// Write functions with the physical address
-
-void FRAM_write_long_array(uint32_t *address, uint16_t numberOfLongs , uint32_t *writeData){
-
-	int i;
-
-	for(i = 0 ; i < numberOfLongs ; i++){
-		*address = *writeData;
-		writeData++;
-		address++;
-	}
-
-}
-
-void FRAM_write_int_array(uint16_t *address, uint16_t numberOfInts , uint16_t *writeData){
-
-	int i;
-
-	for(i = 0 ; i < numberOfInts ; i++){
-		*address = *writeData;
-		writeData++;
-		address++;
-	}
-
-}
-
-void FRAM_write_char_array(uint8_t *address, uint16_t numberOfChars , uint8_t *writeData){
-
-	int i;
-
-	for(i = 0 ; i < numberOfChars ; i++){
-		*address = *writeData;
-		writeData++;
-		address++;
-	}
-}
-
-///// Write to the offset address according to the specified segment.
-///// info segment A
-
-void FRAM_write_infoA_long(int addressOffset , uint16_t numberOfLongs , uint32_t *writeData){
-
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOA_START_ADX) + addressOffset;
-
-	FRAM_write_long_array(address , numberOfLongs , writeData);
-
-}
-
-void FRAM_write_infoA_int(int addressOffset , uint16_t numberOfInts , uint16_t *writeData){
-
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOA_START_ADX) + addressOffset;
-
-	FRAM_write_int_array(address , numberOfInts , writeData);
-
-}
-
-void FRAM_write_infoA_char(int addressOffset , uint16_t numberOfChars , uint8_t *writeData){
-
-	unsigned char *address;
-	address = ((unsigned char *) FRAM_INFOA_START_ADX) + addressOffset;
-
-	FRAM_write_char_array(address , numberOfChars , writeData);
-}
-
-///////////// info segment B
-
-void FRAM_write_infoB_long(int addressOffset , uint16_t numberOfLongs , uint32_t *writeData){
-
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOB_START_ADX) + addressOffset;
-
-	FRAM_write_long_array(address , numberOfLongs , writeData);
-
-}
-
-void FRAM_write_infoB_int(int addressOffset , uint16_t numberOfInts , uint16_t *writeData){
-
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOB_START_ADX) + addressOffset;
-
-	FRAM_write_int_array(address , numberOfInts , writeData);
-
-}
-
-void FRAM_write_infoB_char(int addressOffset , uint16_t numberOfChars , uint8_t *writeData){
-
-	unsigned char *address;
-	address = ((unsigned char *) FRAM_INFOB_START_ADX) + addressOffset;
-
-	FRAM_write_char_array(address , numberOfChars , writeData);
-}
-
-///////////// info segment C
-
-void FRAM_write_infoC_long(int addressOffset , uint16_t numberOfLongs , uint32_t *writeData){
-
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOC_START_ADX) + addressOffset;
-
-	FRAM_write_long_array(address , numberOfLongs , writeData);
-
-}
-
-void FRAM_write_infoC_int(int addressOffset , uint16_t numberOfInts , uint16_t *writeData){
-
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOC_START_ADX) + addressOffset;
-
-	FRAM_write_int_array(address , numberOfInts , writeData);
-
-}
-
-void FRAM_write_infoC_char(int addressOffset , uint16_t numberOfChars , uint8_t *writeData){
-
-	unsigned char *address;
-	address = ((unsigned char *) FRAM_INFOC_START_ADX) + addressOffset;
-
-	FRAM_write_char_array(address , numberOfChars , writeData);
-}
-
-///////////// info segment D
-
-void FRAM_write_infoD_long(int addressOffset , uint16_t numberOfLongs , uint32_t *writeData){
-
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOD_START_ADX) + addressOffset;
-
-	FRAM_write_long_array(address , numberOfLongs , writeData);
-
-}
-
-void FRAM_write_infoD_int(int addressOffset , uint16_t numberOfInts , uint16_t *writeData){
-
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOD_START_ADX) + addressOffset;
-
-	FRAM_write_int_array(address , numberOfInts , writeData);
+static BOOL FRAM_dmaCopy(void* dst, const void* src, uint16_t size, uint16_t unit) {
+    if (!DMA_claim(DMA_CH_FRAM, 0))
+        return FAIL;
 
-}
-
-void FRAM_write_infoD_char(int addressOffset , uint16_t numberOfChars , uint8_t *writeData){
-
-	unsigned char *address;
-	address = ((unsigned char *) FRAM_INFOD_START_ADX) + addressOffset;
-
-	FRAM_write_char_array(address , numberOfChars , writeData);
-}
-
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-////// Read functions with the physical address
-
-uint32_t FRAM_read_long(uint32_t *address){
-
-	return *address;
-
-}
-
-uint16_t FRAM_read_int(uint16_t *address){
-
-	return *address;
-
-}
-
-uint8_t FRAM_read_char(uint8_t *address){
-
-	return *address;
-}
+    DMA_init();
+    DMA_setTrigger(DMA_CH_FRAM, DMA_TRIG_DMAREQ);
 
-///// Write to the offset address according to the specified segment.
-///// info segment A
+    __data16_write_addr((unsigned short) &DMA0SA, (unsigned long) src);
+    __data16_write_addr((unsigned short) &DMA0DA, (unsigned long) dst);
+    DMA0SZ = size;
+    DMA0CTL = DMADT_1 | DMASRCINCR_3 | DMADSTINCR_3 | unit | DMAEN;
 
-uint32_t FRAM_read_infoA_long(int addressOffset){
+    DMA0CTL |= DMAREQ; // The CPU is held until the whole block has moved
 
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOA_START_ADX) + addressOffset;
-
-	return *address;
-}
-
-uint16_t FRAM_read_infoA_int(int addressOffset){
-
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOA_START_ADX) + addressOffset;
-
-	return *address;
+    DMA_release(DMA_CH_FRAM);
+    return SUCCESS;
 }
 
-uint8_t FRAM_read_infoA_char(int addressOffset){
-
-	unsigned char *address;
-	address = ((unsigned char *) FRAM_INFOA_START_ADX) + addressOffset;
-
-	return *address;
-}
-
-///////////// info segment B
-
-uint32_t FRAM_read_infoB_long(int addressOffset){
-
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOB_START_ADX) + addressOffset;
-
-	return *address;
-
-}
-
-uint16_t FRAM_read_infoB_int(int addressOffset){
-
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOB_START_ADX) + addressOffset;
-
-	return *address;
-
-}
-
-uint8_t FRAM_read_infoB_char(int addressOffset){
-
-	unsigned char *address;
-	address = ((unsigned char *) FRAM_INFOB_START_ADX) + addressOffset;
-
-	return *address;
-
-}
-
-///////////// info segment C
-
-uint32_t FRAM_read_infoC_long(int addressOffset){
-
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOC_START_ADX) + addressOffset;
-
-	return *address;
-
-}
-
-uint16_t FRAM_read_infoC_int(int addressOffset){
-
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOC_START_ADX) + addressOffset;
-
-	return *address;
-
+/**
+ * Copy between any two memory locations.
+ */
+static void FRAM_copy(void* dst, const void* src, uint16_t len) {
+    uint8_t* d = (uint8_t*) dst;
+    const uint8_t* s = (const uint8_t*) src;
+    uint16_t words;
+
+    if (len == 0)
+        return;
+
+    // Alignments differ, words can't be used at all
+    if (((uint16_t) d ^ (uint16_t) s) & 1) {
+        if ((len < FRAM_DMA_MIN_SIZE) || !FRAM_dmaCopy(d, s, len, DMASRCBYTE | DMADSTBYTE)) {
+            while (len--)
+                *d++ = *s++;
+        }
+        return;
+    }
+
+    if ((uint16_t) d & 1) {
+        *d++ = *s++;
+        len--;
+    }
+
+    words = len >> 1;
+    if (words) {
+        if ((len < FRAM_DMA_MIN_SIZE) || !FRAM_dmaCopy(d, s, words, 0)) {
+            uint16_t* dw = (uint16_t*) d;
+            const uint16_t* sw = (const uint16_t*) s;
+            uint16_t i;
+
+            for (i = 0; i < words; i++)
+                *dw++ = *sw++;
+        }
+        d += words << 1;
+        s += words << 1;
+    }
+
+    if (len & 1)
+        *d = *s;
 }
 
-uint8_t FRAM_read_infoC_char(int addressOffset){
-
-	unsigned char *address;
-	address = ((unsigned char *) FRAM_INFOC_START_ADX) + addressOffset;
-
-	return *address;
+/**
+ * Write protect the information memory. Everything else stays as it is, so
+ *  PERSISTENT variables in main FRAM can still be written directly.
+ */
+void FRAM_init(void) {
+    if (MPUCTL0 & MPULOCK)
+        return;
 
+    MPUCTL0_H = MPUPW_H;
+    MPUSAM &= ~MPUSEGIWE;
+    MPUCTL0 = MPUPW | MPUENA;
+    MPUCTL0_H = 0; // Lock the MPU registers again
 }
 
-///////////// info segment D
-
-uint32_t FRAM_read_infoD_long(int addressOffset){
+/**
+ * Copy into FRAM, lifting any MPU write protection around the copy.
+ *
+ * @param dst FRAM (or RAM) destination
+ * @param src source, anywhere
+ * @param len number of bytes
+ * @return SUCCESS, or FAIL if the MPU is locked and protects some segment
+ */
+BOOL FRAM_write(void* dst, const void* src, uint16_t len) {
+    uint16_t state = __get_interrupt_state();
+    uint16_t sam;
 
-	unsigned long *address;
-	address = ((unsigned long *)FRAM_INFOD_START_ADX) + addressOffset;
+    if (!(MPUCTL0 & MPUENA) || ((MPUSAM & MPU_ALL_WE) == MPU_ALL_WE)) {
+        FRAM_copy(dst, src, len);
+        return SUCCESS;
+    }
 
-	return *address;
+    if (MPUCTL0 & MPULOCK)
+        return FAIL;
 
-}
+    // No ISR may run (and write) while the protection is off
+    __disable_interrupt();
 
-uint16_t FRAM_read_infoD_int(int addressOffset){
+    sam = MPUSAM;
+    MPUCTL0_H = MPUPW_H;
+    MPUSAM = sam | MPU_ALL_WE;
+    MPUCTL0_H = 0;
 
-	unsigned int *address;
-	address = ((unsigned int *)FRAM_INFOD_START_ADX) + addressOffset;
+    FRAM_copy(dst, src, len);
 
-	return *address;
+    MPUCTL0_H = MPUPW_H;
+    MPUSAM = sam;
+    MPUCTL0_H = 0;
 
+    __set_interrupt_state(state);
+    return SUCCESS;
 }
 
-uint8_t FRAM_read_infoD_char(int addressOffset){
-
-	unsigned char *address;
-	address = ((unsigned char *)FRAM_INFOD_START_ADX) + addressOffset;
-
-	return *address;
-
+/**
+ * Copy out of FRAM (or between any two locations which need no unlocking).
+ *
+ * @param dst destination
+ * @param src source
+ * @param len number of bytes
+ */
+void FRAM_read(void* dst, const void* src, uint16_t len) {
+    FRAM_copy(dst, src, len);
 }
-
-
-
-
-
@@ -0,0 +1,362 @@
+/**
+ * @file kvstore.c
+ *
+ * Log structured key/value store in FRAM.
+ *
+ * The FRAM region is split into two halves, one of which holds the log. A put
+ *  appends a record, a delete appends a tombstone, and the newest record of a
+ *  key wins. KV_init() scans the log once and builds a RAM index (open
+ *  addressing, key to record offset), so lookups never scan FRAM. When the
+ *  log is full, the live records are compacted into the other half.
+ *
+ * Power loss safety:
+ *  - A record only counts once its marker word is written, which is the last
+ *    step; word writes are atomic. The word behind the record is cleared
+ *    before, so the scan stops there even if older data follows.
+ *  - A compacted half carries a newer generation than the old one, but only
+ *    becomes valid when its magic is written after all records. Until then
+ *    the old half stays in use.
+ *
+ * The index lives in RAM: call KV_init() after every boot, warm boots from
+ *  WISP_hibernate() included. Not for use from ISRs.
+ */
+
+#include <string.h>
+#include "kvstore.h"
+#include "fram.h"
+
+#define KV_MAGIC        (0x4B56)    // marks a complete half; written last
+#define KV_MARK_VALUE   (0xA55A)    // committed record
+#define KV_MARK_DELETE  (0xA5DE)    // committed tombstone
+#define KV_MARK_END     (0x0000)    // anything but the two above ends the log
+
+#define KV_INDEX_SIZE   (KV_MAX_KEYS * 2)   // keeps probe sequences short
+
+/**
+ * Start of each half
+ */
+typedef struct {
+    uint16_t magic; // KV_MAGIC if the half may be used
+    uint16_t generation; // The newer of two valid halves wins
+} KV_header_t;
+
+/**
+ * Start of each record, followed by the value padded to a whole word
+ */
+typedef struct {
+    uint16_t mark; // KV_MARK_*
+    uint16_t key;
+    uint16_t len; // Bytes of value
+} KV_record_t;
+
+#pragma PERSISTENT(KV_region)
+static uint16_t KV_region[2][KV_REGION_SIZE / 2] = { 0 }; // Words, so records stay aligned
+
+/**
+ * State variables for the key/value store
+ */
+static struct {
+    BOOL isReady; // Has KV_init() found or formatted a half?
+    uint8_t active; // Half holding the log
+    uint16_t generation; // Generation of the active half
+    uint16_t end; // Offset of the first free byte in the active half
+    uint8_t numKeys; // Used index entries
+    struct {
+        uint16_t key; // 0 if the entry is free
+        uint16_t offset; // Newest record of the key in the active half
+    } index[KV_INDEX_SIZE];
+} KV_SM;
+
+//----------------------------------------------------------------------------
+
+static KV_header_t* KV_header(uint8_t half) {
+    return (KV_header_t*) KV_region[half];
+}
+
+static KV_record_t* KV_record(uint16_t offset) {
+    return (KV_record_t*) ((uint8_t*) KV_region[KV_SM.active] + offset);
+}
+
+static uint16_t KV_recordSize(uint16_t len) {
+    return sizeof(KV_record_t) + ((len + 1) & ~1);
+}
+
+/**
+ * @return index entry of the key, or the free entry where it would go
+ */
+static uint8_t KV_find(uint16_t key) {
+    uint8_t i = (uint8_t) (key ^ (key >> 8)) & (KV_INDEX_SIZE - 1);
+
+    while ((KV_SM.index[i].key != key) && (KV_SM.index[i].key != 0))
+        i = (i + 1) & (KV_INDEX_SIZE - 1);
+
+    return i;
+}
+
+/**
+ * Point the index at a new record of the key.
+ *
+ * @return SUCCESS, or FAIL if it is a new key and KV_MAX_KEYS are in use
+ */
+static BOOL KV_indexSet(uint16_t key, uint16_t offset) {
+    uint8_t i = KV_find(key);
+
+    if (KV_SM.index[i].key == 0) {
+        if (KV_SM.numKeys >= KV_MAX_KEYS)
+            return FAIL;
+        KV_SM.numKeys++;
+        KV_SM.index[i].key = key;
+    }
+
+    KV_SM.index[i].offset = offset;
+    return SUCCESS;
+}
+
+/**
+ * @return newest record of the key, or NULL if there is none
+ */
+static KV_record_t* KV_lookup(uint16_t key) {
+    uint8_t i = KV_find(key);
+
+    if (KV_SM.index[i].key == 0)
+        return 0;
+
+    return KV_record(KV_SM.index[i].offset);
+}
+
+/**
+ * Rebuild the index and find the end of the log of the active half.
+ */
+static void KV_scan(void) {
+    uint16_t offset = sizeof(KV_header_t);
+    uint16_t size;
+    KV_record_t* rec;
+
+    memset(KV_SM.index, 0, sizeof(KV_SM.index));
+    KV_SM.numKeys = 0;
+
+    while (offset + sizeof(KV_record_t) <= KV_REGION_SIZE) {
+        rec = KV_record(offset);
+
+        if ((rec->mark != KV_MARK_VALUE) && (rec->mark != KV_MARK_DELETE))
+            break;
+
+        size = KV_recordSize(rec->len);
+        if ((rec->len > KV_REGION_SIZE) || (offset + size > KV_REGION_SIZE))
+            break;
+
+        if (!KV_indexSet(rec->key, offset))
+            break;
+
+        offset += size;
+    }
+
+    KV_SM.end = offset;
+}
+
+/**
+ * Clear the marker word at an offset of a half, if there is room for one.
+ */
+static void KV_terminate(uint8_t half, uint16_t offset) {
+    if (offset + sizeof(uint16_t) <= KV_REGION_SIZE)
+        KV_region[half][offset / 2] = KV_MARK_END;
+}
+
+/**
+ * Append a record to the log and index it.
+ *
+ * @return SUCCESS, or FAIL if it doesn't fit
+ */
+static BOOL KV_append(uint16_t mark, uint16_t key, const void* data, uint16_t len) {
+    uint16_t size = KV_recordSize(len);
+    KV_record_t* rec;
+
+    if (KV_SM.end + size > KV_REGION_SIZE) {
+        KV_compact();
+        if (KV_SM.end + size > KV_REGION_SIZE)
+            return FAIL;
+    }
+
+    rec = KV_record(KV_SM.end);
+
+    // The marker at the end of the log is not a commit, so this is not visible yet
+    rec->key = key;
+    rec->len = len;
+    FRAM_write(rec + 1, data, len);
+    KV_terminate(KV_SM.active, KV_SM.end + size);
+    rec->mark = mark;
+
+    KV_indexSet(key, KV_SM.end);
+    KV_SM.end += size;
+    return SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Find the valid half with the newest generation and index it, or format
+ *  the region if neither half is valid (first boot).
+ *
+ * @return SUCCESS
+ */
+BOOL KV_init(void) {
+    KV_header_t* h0 = KV_header(0);
+    KV_header_t* h1 = KV_header(1);
+    BOOL isValid0 = (h0->magic == KV_MAGIC);
+    BOOL isValid1 = (h1->magic == KV_MAGIC);
+
+    if (isValid0 && isValid1)
+        KV_SM.active = ((int16_t) (h1->generation - h0->generation) > 0) ? 1 : 0;
+    else if (isValid1)
+        KV_SM.active = 1;
+    else
+        KV_SM.active = 0;
+
+    if (!isValid0 && !isValid1) {
+        KV_terminate(0, sizeof(KV_header_t));
+        h0->generation = 0;
+        h0->magic = KV_MAGIC;
+    }
+
+    KV_SM.generation = KV_header(KV_SM.active)->generation;
+    KV_scan();
+
+    KV_SM.isReady = TRUE;
+    return SUCCESS;
+}
+
+/**
+ * Store a value. Writing the value which is stored already costs nothing.
+ *
+ * @param key KV_KEY_MIN to KV_KEY_MAX
+ * @param data value
+ * @param len bytes of value
+ * @return SUCCESS, or FAIL if the store is full (after compaction) or
+ *  KV_MAX_KEYS other keys are stored
+ */
+BOOL KV_put(uint16_t key, const void* data, uint16_t len) {
+    KV_record_t* rec;
+
+    if (!KV_SM.isReady || (key < KV_KEY_MIN) || (key > KV_KEY_MAX))
+        return FAIL;
+
+    rec = KV_lookup(key);
+    if (rec) {
+        if ((rec->mark == KV_MARK_VALUE) && (rec->len == len) && !memcmp(rec + 1, data, len))
+            return SUCCESS;
+    } else if (KV_SM.numKeys >= KV_MAX_KEYS) {
+        KV_compact(); // Deleted keys may still take up index entries
+        if (KV_SM.numKeys >= KV_MAX_KEYS)
+            return FAIL;
+    }
+
+    return KV_append(KV_MARK_VALUE, key, data, len);
+}
+
+/**
+ * Read a value.
+ *
+ * @param key key of the value
+ * @param buf destination
+ * @param size room in buf; a longer value is cut short
+ * @return SUCCESS, or FAIL if the key is not stored
+ */
+BOOL KV_get(uint16_t key, void* buf, uint16_t size) {
+    KV_record_t* rec;
+
+    if (!KV_SM.isReady)
+        return FAIL;
+
+    rec = KV_lookup(key);
+    if ((rec == 0) || (rec->mark != KV_MARK_VALUE))
+        return FAIL;
+
+    FRAM_read(buf, rec + 1, (rec->len < size) ? rec->len : size);
+    return SUCCESS;
+}
+
+/**
+ * @return length of the stored value, 0 if the key is not stored
+ */
+uint16_t KV_length(uint16_t key) {
+    KV_record_t* rec;
+
+    if (!KV_SM.isReady)
+        return 0;
+
+    rec = KV_lookup(key);
+    if ((rec == 0) || (rec->mark != KV_MARK_VALUE))
+        return 0;
+
+    return rec->len;
+}
+
+/**
+ * Remove a value.
+ *
+ * @return SUCCESS, or FAIL if the key is not stored or the log is full
+ */
+BOOL KV_delete(uint16_t key) {
+    KV_record_t* rec;
+
+    if (!KV_SM.isReady)
+        return FAIL;
+
+    rec = KV_lookup(key);
+    if ((rec == 0) || (rec->mark != KV_MARK_VALUE))
+        return FAIL;
+
+    return KV_append(KV_MARK_DELETE, key, 0, 0);
+}
+
+/**
+ * Copy the newest value of every stored key into the other half and switch
+ *  over to it. Deleted keys are dropped. Called by KV_put() and KV_delete()
+ *  when the log is full; calling it earlier (e.g. while the supply is good)
+ *  keeps the compaction out of time critical writes.
+ *
+ * @return SUCCESS, or FAIL if KV_init() was not called
+ */
+BOOL KV_compact(void) {
+    uint8_t dst = KV_SM.active ^ 1;
+    KV_header_t* hdr = KV_header(dst);
+    uint16_t offset = sizeof(KV_header_t);
+    uint16_t size;
+    uint8_t i;
+    KV_record_t* rec;
+
+    if (!KV_SM.isReady)
+        return FAIL;
+
+    hdr->magic = 0; // Not valid until complete
+
+    for (i = 0; i < KV_INDEX_SIZE; i++) {
+        if (KV_SM.index[i].key == 0)
+            continue;
+
+        rec = KV_record(KV_SM.index[i].offset);
+        if (rec->mark != KV_MARK_VALUE)
+            continue;
+
+        size = KV_recordSize(rec->len);
+        FRAM_write((uint8_t*) KV_region[dst] + offset, rec, size);
+        offset += size;
+    }
+    KV_terminate(dst, offset);
+
+    hdr->generation = KV_SM.generation + 1;
+    hdr->magic = KV_MAGIC; // Commit: the newer generation wins from now on
+
+    KV_SM.active = dst;
+    KV_SM.generation++;
+    KV_scan();
+
+    return SUCCESS;
+}
+
+/**
+ * @return bytes left in the log before the next compaction
+ */
+uint16_t KV_free(void) {
+    return KV_REGION_SIZE - KV_SM.end;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file kvstore.h
+ *
+ * Small key/value store in FRAM for application data (calibration, counters,
+ *  configuration) which changes at run time.
+ */
+
+#ifndef KVSTORE_H_
+#define KVSTORE_H_
+
+#include "../globals.h"
+
+/*
+ * Keys 0x0000 and 0xFFFF are reserved
+ */
+#define KV_KEY_MIN      (0x0001)
+#define KV_KEY_MAX      (0xFFFE)
+
+/*
+ * Function prototypes
+ */
+
+BOOL KV_init(void);
+BOOL KV_put(uint16_t key, const void* data, uint16_t len);
+BOOL KV_get(uint16_t key, void* buf, uint16_t size);
+uint16_t KV_length(uint16_t key);
+BOOL KV_delete(uint16_t key);
+BOOL KV_compact(void);
+uint16_t KV_free(void);
+
+#endif /* KVSTORE_H_ */
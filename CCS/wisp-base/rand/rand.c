@@ -1,24 +1,216 @@
 /**
  * rand.c
  *
- * Random number generator using noisy LSb from the ADC12
+ * Random number generator: an xorshift generator in FRAM, stirred with noise
+ *  from the ADC12
+ *
+ * Values come from a 16-bit xorshift generator, which takes a handful of
+ *  cycles per call. It runs in RAM and is written back to FRAM every
+ *  RAND_SAVE_INTERVAL values, so the sequence carries on across power loss
+ *  instead of starting over on every boot. After a reset the generator first
+ *  skips the values which may have been drawn since the last write-back. It is seeded from the
+ *  table stored by run-once and stirred with ADC noise collected in background
+ *  bursts (RAND_startHarvest()). The first WISP_init() after programming reads
+ *  the same amount of noise with polled conversions, so the pool never starts
+ *  out empty; applications may run harvests whenever the ADC is free.
  *
  * @author Aaron Parks, Justin Reina
  */
 
-#include "../globals.h"
+#include "rand.h"
+#include "../Sensors/adc.h"
+
+#define RAND_SEED           (0xACE1)    // used if everything else is zero
+#define RAND_BURST          (16)        // conversions per harvested word, one bit each
+#define RAND_BURST_PERIOD   (4)         // ACLK ticks between bursts, more than 16 conversions take
+#define RAND_SAVE_INTERVAL  (32)        // values drawn between write-backs of the state to FRAM
+
+/**
+ * Generator state and entropy pool, persisted in FRAM
+ */
+typedef struct {
+    uint16_t state; // xorshift16 state as of the last write-back, never 0 once seeded
+    uint16_t pool[RAND_POOL_SIZE]; // Harvested ADC noise
+    uint8_t poolIdx; // Pool word the next harvested word goes into
+} RAND_persist_t;
+
+#pragma PERSISTENT(RAND_nv)
+static RAND_persist_t RAND_nv = { 0 };
+
+uint16_t RAND_table[RAND_TABLE_SIZE]; // RN16s for the RFID handles, see RAND_refill()
+
+/**
+ * State variables for the random number module
+ */
+static struct {
+    uint16_t state; // Working copy of RAND_nv.state
+    uint8_t untilSave; // Values left until the next write-back
+    uint16_t raw[RAND_BURST]; // Results of the running burst
+    volatile uint8_t harvestLeft; // Bursts still to go, 0 while no harvest runs
+} RAND_SM;
+
+/**
+ * Fold one harvested word into the pool and the generator state.
+ */
+static void RAND_mix(uint16_t word) {
+    uint16_t* p = &RAND_nv.pool[RAND_nv.poolIdx];
+
+    *p = ((*p << 1) | (*p >> 15)) ^ word;
+    if (++RAND_nv.poolIdx >= RAND_POOL_SIZE)
+        RAND_nv.poolIdx = 0;
+
+    RAND_SM.state ^= *p;
+    if (RAND_SM.state == 0)
+        RAND_SM.state = RAND_SEED;
+
+    RAND_nv.state = RAND_SM.state; // keep the entropy
+}
+
+/**
+ * @return the xorshift16 successor of x
+ */
+static uint16_t RAND_step(uint16_t x) {
+    x ^= x << 7;
+    x ^= x >> 9;
+    x ^= x << 8;
+
+    return x;
+}
+
+/**
+ * Seed the generator and fill the RN16 table. Called from WISP_init().
+ *
+ * On the first boot after programming this also reads RAND_HARVEST_WORDS
+ *  words of ADC noise (over 1ms each, mostly the reference settling at the
+ *  1MHz boot clock) before the first RN16 is drawn.
+ */
+void RAND_init(void) {
+    uint8_t i;
+    const uint16_t* stored = (const uint16_t*) INFO_WISP_RAND_TBL;
+
+    // First boot: start from the values run-once stored for this tag, and
+    //  stir in ADC noise. Polled, so interrupts stay off during WISP_init().
+    if (RAND_nv.state == 0) {
+        for (i = 0; i < NUM_RN16_2_STORE; i++)
+            RAND_nv.state ^= stored[i];
+
+        if (RAND_nv.state == 0)
+            RAND_nv.state = RAND_SEED;
+
+        RAND_SM.state = RAND_nv.state;
+        for (i = 0; i < RAND_HARVEST_WORDS; i++)
+            RAND_mix(RAND_adcRand16());
+    }
+
+    // Up to RAND_SAVE_INTERVAL values were drawn after the last write-back
+    //  and may be on the air already. Skip them, and save the new position.
+    RAND_SM.state = RAND_nv.state;
+    for (i = 0; i < RAND_SAVE_INTERVAL; i++)
+        RAND_SM.state = RAND_step(RAND_SM.state);
+
+    RAND_nv.state = RAND_SM.state;
+    RAND_SM.untilSave = RAND_SAVE_INTERVAL;
+
+    for (i = 0; i < RAND_TABLE_SIZE; i++)
+        RAND_table[i] = RAND_next16();
+}
+
+/**
+ * @return the next pseudo-random value (xorshift16, period 2^16 - 1)
+ */
+uint16_t RAND_next16(void) {
+    uint16_t x = RAND_step(RAND_SM.state);
+
+    RAND_SM.state = x;
+
+    if (--RAND_SM.untilSave == 0) {
+        RAND_SM.untilSave = RAND_SAVE_INTERVAL;
+        RAND_nv.state = x;
+    }
+
+    return x;
+}
+
+/**
+ * Replace the table word which the next Query, QueryAdjust or ReqRN will pick
+ *  up, so every one of them gets a fresh value. Called by WISP_doRFID() after
+ *  each command, while the RX state machine is halted.
+ */
+void RAND_refill(void) {
+    RAND_table[((rfid.rn8_ind + 1) >> 1) & (RAND_TABLE_SIZE - 1)] = RAND_next16();
+}
+
+/**
+ * ADC block callback: one burst is in, keep its LSbs.
+ */
+static void RAND_harvestStep(void) {
+    uint8_t i;
+    uint16_t word = 0;
+
+    for (i = 0; i < RAND_BURST; i++)
+        word = (word << 1) | (RAND_SM.raw[i] & BIT0);
+
+    RAND_mix(word);
+
+    if (--RAND_SM.harvestLeft == 0) {
+        ADC_stopSequence();
+        ADC_disable();
+    }
+}
+
+/**
+ * Collect RAND_HARVEST_WORDS words of temperature sensor noise in the
+ *  background. Each word is one timer triggered burst of 16 conversions,
+ *  moved by the DMA, so the CPU may sleep meanwhile (LPM3 is fine).
+ *
+ * @note This takes over the ADC; the single channel functions need
+ *  ADC_initCustom() again afterwards.
+ *
+ * @return SUCCESS, or FAIL if a harvest, sequence or window monitor is running
+ */
+BOOL RAND_startHarvest(void) {
+    uint8_t i;
+    ADC_inputSelect inputs[RAND_BURST];
+
+    if (RAND_SM.harvestLeft)
+        return FAIL;
+
+    for (i = 0; i < RAND_BURST; i++)
+        inputs[i] = ADC_input_temperature;
+
+    if (ADC_setSequence(inputs, RAND_BURST) != SUCCESS)
+        return FAIL;
+
+    RAND_SM.harvestLeft = RAND_HARVEST_WORDS;
+
+    if (ADC_startSequence(RAND_SM.raw, 1, RAND_BURST_PERIOD, TRUE, &RAND_harvestStep) != SUCCESS) {
+        RAND_SM.harvestLeft = 0;
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @return TRUE until the last RAND_startHarvest() has filled the pool
+ */
+BOOL RAND_isHarvesting(void) {
+    return (RAND_SM.harvestLeft != 0);
+}
 
 /**	@fcn		adc12_genRN16 (void)
  *  @brief		generate a random 16-bit value by sampling b0 of the temperature sensor.
  *
- * 		Use the 10-bit ADC in repeat-single-sample mode to read the ADC 16 times, keeping each samples' b0 and assembling a full word
- * 		from them at the end. Use the WISPs recently acquired ADC_clk setting, just cause its available.
+ * 		Use the 10-bit ADC in sequence-of-channels mode to convert the same input into MEM0-15 off a single trigger, keeping each
+ * 		samples' b0 and assembling a full word from them at the end. Use the WISPs recently acquired ADC_clk setting, just cause its available.
  *
  *  @return		(int16_t)	a random 16 bit value.
  *
  */
 uint16_t RAND_adcRand16 (void) {
 	uint8_t 	 i;
+	volatile uint16_t* mctl = &ADC12MCTL0;					/* MCTL0-15 and MEM0-15 are consecutive registers						*/
+	volatile uint16_t* mem  = &ADC12MEM0;
 	uint16_t 	 returnVal;									/* the final RN16 value to return										*/
 
 	//------------------------------Turn on reference module's VREF and Temp Sense--------------------------------------------------//
@@ -41,18 +233,19 @@ uint16_t RAND_adcRand16 (void) {
 	ADC12CTL1 |= ADC12DIV_0;								/* ADC Clk is /1 off source												*/
 
 	//---------S&H Config---------------//
-	//ADC12CTL0 |= ADC12MSC;								/* setup for repeated samples off first SHI pulse						*/
+	ADC12CTL0 |= ADC12MSC;									/* setup for repeated samples off first SHI pulse						*/
 //	ADC12CTL1 |= ADC12SHS0;									/* S&H source comes directly from ADC12SC								*/
 	ADC12CTL1 |= ADC12SHP;									/* enable using the S&H Sampling Timer (longer sample time (SHT00)		*/
 	ADC12CTL0 |= ADC12SHT0_2;								/* 16 S&H Cycle cause we need min 13 for the 12-bit res sample			*/
 
 	//--------Msrmnt Source-------------//
 	ADC12CTL2 |= ADC12RES_2;								/* 10 bit sample res to max noise res in msr							*/
-	ADC12MCTL0|= ADC12VRSEL_1;								/* reference is VREF and AVSS											*/
-	ADC12MCTL0|= ADC12INCH_10;								/* setup to A10															*/
+	for(i=0;i<16;i++)
+		mctl[i] = ADC12VRSEL_1 + ADC12INCH_10;				/* reference is VREF and AVSS, setup to A10								*/
+	mctl[15] |= ADC12EOS;									/* MEM15 ends the sequence												*/
 
 	//-----Conversion Sequence----------//
-	ADC12CTL1 |= ADC12CONSEQ_0;								/* mode is single-sample on single-channel										*/
+	ADC12CTL1 |= ADC12CONSEQ_1;								/* mode is sequence-of-channels, all 16 on the same channel				*/
 
 	//-----Turn On the ADC--------------//
 	ADC12CTL0 |= ADC12ON;									/* turn that sucker on!													*/
@@ -64,19 +257,15 @@ uint16_t RAND_adcRand16 (void) {
 
 	returnVal = 0;
 
-	for(i=0;i<15;i++) {
-
-		returnVal = (returnVal<<1) | (ADC12MEM0 & BIT0);
-
-		ADC12CTL0 |= ADC12SC;
-		while (ADC12CTL1 & ADC12BUSY);               			/* Wait for it to complete all 16 samples into MEM0-15				*/
-	}
+	for(i=0;i<16;i++)
+		returnVal = (returnVal<<1) | (mem[i] & BIT0);
 
 	//--------------------------------------Turn off the ADC------------------------------------------------------------------------//
 	ADC12CTL0  = 0;
 	ADC12CTL1  = 0;
 	ADC12CTL2  = 0;
-	ADC12MCTL0 = 0;
+	for(i=0;i<16;i++)
+		mctl[i] = 0;
 	ADC12IER0  = 0;
 
 	//--------------------------------------Turn off the REF------------------------------------------------------------------------//
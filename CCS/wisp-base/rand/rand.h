@@ -9,6 +9,22 @@
 #ifndef RAND_H_
 #define RAND_H_
 
+#include "../globals.h"
+
+/*
+ * RN16 table read by the Query/QueryAdjust/ReqRN handles. They walk it with
+ *  rfid.rn8_ind modulo 32 (a byte index), so it holds 16 words.
+ */
+#define RAND_TABLE_SIZE     16
+
+extern uint16_t RAND_table[RAND_TABLE_SIZE];
+
+void RAND_init(void);
+uint16_t RAND_next16(void);
+void RAND_refill(void);
+
+BOOL RAND_startHarvest(void);
+BOOL RAND_isHarvesting(void);
 
 uint16_t RAND_adcRand16 (void);
 
@@ -0,0 +1,49 @@
+/**
+ * @file pt.h
+ *
+ * Stackless protothreads. A protothread is a plain C function which keeps
+ *  its resume point in a pt_t, so it can block on a condition without owning
+ *  a stack. Locals do not survive a blocking statement; keep state in static
+ *  or global variables.
+ *
+ * Based on the local-continuation trick from Adam Dunkels' protothreads. Do
+ *  not use switch statements inside a protothread body.
+ */
+
+#ifndef PT_H_
+#define PT_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint16_t lc; // Resume point (source line) of the thread
+} pt_t;
+
+// Protothread return values
+#define PT_WAITING  (0)     /* blocked on a condition                                                                           */
+#define PT_YIELDED  (1)     /* gave up the CPU voluntarily                                                                      */
+#define PT_EXITED   (2)     /* left through PT_EXIT                                                                             */
+#define PT_ENDED    (3)     /* ran off the end of the thread body                                                               */
+
+#define PT_INIT(pt)             ((pt)->lc = 0)
+
+#define PT_BEGIN(pt)            { uint8_t PT_YIELD_FLAG = 1; (void)PT_YIELD_FLAG; switch((pt)->lc) { case 0:
+
+#define PT_END(pt)              } PT_YIELD_FLAG = 0; PT_INIT(pt); return PT_ENDED; }
+
+#define PT_WAIT_UNTIL(pt, cond) do { (pt)->lc = __LINE__; case __LINE__: \
+                                    if(!(cond)) return PT_WAITING; } while(0)
+
+#define PT_WAIT_WHILE(pt, cond) PT_WAIT_UNTIL((pt), !(cond))
+
+#define PT_YIELD(pt)            do { PT_YIELD_FLAG = 0; (pt)->lc = __LINE__; case __LINE__: \
+                                    if(PT_YIELD_FLAG == 0) return PT_YIELDED; } while(0)
+
+#define PT_YIELD_UNTIL(pt, cond) do { PT_YIELD_FLAG = 0; (pt)->lc = __LINE__; case __LINE__: \
+                                    if((PT_YIELD_FLAG == 0) || !(cond)) return PT_YIELDED; } while(0)
+
+#define PT_RESTART(pt)          do { PT_INIT(pt); return PT_WAITING; } while(0)
+
+#define PT_EXIT(pt)             do { PT_INIT(pt); return PT_EXITED; } while(0)
+
+#endif /* PT_H_ */
@@ -0,0 +1,145 @@
+/**
+ * @file task.c
+ *
+ * Round-robin scheduler for protothread tasks.
+ *
+ * When attached to the RFID loop, tasks are stepped from the idle hook of
+ *  WISP_doRFID(). That hook runs with the RX state machine halted and the
+ *  CPU still on the fast RX clock, so each task step should be short: a
+ *  reader command arriving meanwhile is missed and has to be repeated. At most
+ *  TASK_STEPS_PER_IDLE steps are taken per gap, and only in gaps after a
+ *  command the tag did not answer (other than Select) or a receive timeout.
+ *
+ * Tasks which change the EPC buffer from the RFID loop must call
+ *  WISP_refreshEPC() so the StoredPC and CRC16 are rebuilt.
+ */
+
+#include "task.h"
+#include "../RFID/rfid.h"
+
+/**
+ * State variables for the task scheduler
+ */
+static struct {
+    TASK_fn_t fn[TASK_MAX_TASKS]; // Task bodies, NULL for free slots
+    pt_t pt[TASK_MAX_TASKS]; // Resume point of each task
+    uint8_t next; // Slot to be stepped next
+} TASK_SM;
+
+/**
+ * Add a task to the table. It starts from the top of its body on its first step.
+ *
+ * @param fn task body
+ * @return SUCCESS, or FAIL if the table is full
+ */
+BOOL TASK_create(TASK_fn_t fn) {
+    uint8_t i;
+
+    for (i = 0; i < TASK_MAX_TASKS; i++) {
+        if (TASK_SM.fn[i] == 0) {
+            PT_INIT(&TASK_SM.pt[i]);
+            TASK_SM.fn[i] = fn;
+            return SUCCESS;
+        }
+    }
+
+    return FAIL;
+}
+
+/**
+ * Remove a task from the table.
+ *
+ * @param fn task body which was passed to TASK_create()
+ * @return SUCCESS, or FAIL if no such task was running
+ */
+BOOL TASK_kill(TASK_fn_t fn) {
+    uint8_t i;
+
+    for (i = 0; i < TASK_MAX_TASKS; i++) {
+        if (TASK_SM.fn[i] == fn) {
+            TASK_SM.fn[i] = 0;
+            return SUCCESS;
+        }
+    }
+
+    return FAIL;
+}
+
+/**
+ * @return number of live tasks
+ */
+uint8_t TASK_count(void) {
+    uint8_t i;
+    uint8_t n = 0;
+
+    for (i = 0; i < TASK_MAX_TASKS; i++) {
+        if (TASK_SM.fn[i] != 0)
+            n++;
+    }
+
+    return n;
+}
+
+/**
+ * Step the next live task once (round-robin).
+ *
+ * @return TRUE if a task was stepped, FALSE if the table is empty
+ */
+BOOL TASK_step(void) {
+    uint8_t i;
+
+    for (i = 0; i < TASK_MAX_TASKS; i++) {
+        uint8_t cur = TASK_SM.next;
+
+        if (++TASK_SM.next >= TASK_MAX_TASKS)
+            TASK_SM.next = 0;
+
+        if (TASK_SM.fn[cur] != 0) {
+            if (TASK_SM.fn[cur](&TASK_SM.pt[cur]) >= PT_EXITED)
+                TASK_SM.fn[cur] = 0;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Step every live task once.
+ */
+void TASK_runAll(void) {
+    uint8_t i;
+
+    for (i = 0; i < TASK_MAX_TASKS; i++) {
+        if (TASK_SM.fn[i] != 0) {
+            if (TASK_SM.fn[i](&TASK_SM.pt[i]) >= PT_EXITED)
+                TASK_SM.fn[i] = 0;
+        }
+    }
+}
+
+/**
+ * Idle hook for WISP_doRFID()
+ */
+static void TASK_idle(void) {
+    uint8_t n;
+
+    for (n = 0; n < TASK_STEPS_PER_IDLE; n++) {
+        if (!TASK_step())
+            break;
+    }
+}
+
+/**
+ * Run tasks between reader commands while inside WISP_doRFID().
+ */
+void TASK_attachToRFID(void) {
+    WISP_registerCallback_IDLE(&TASK_idle);
+}
+
+/**
+ * Stop running tasks from inside WISP_doRFID().
+ */
+void TASK_detachFromRFID(void) {
+    WISP_registerCallback_IDLE(0);
+}
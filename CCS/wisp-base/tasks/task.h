@@ -0,0 +1,29 @@
+/**
+ * @file task.h
+ *
+ * A small cooperative scheduler for protothreads. Tasks can be stepped from
+ *  the application's own loop, or attached to the RFID loop so they run in
+ *  the gaps between reader commands without leaving WISP_doRFID().
+ */
+
+#ifndef TASK_H_
+#define TASK_H_
+
+#include "../globals.h"
+#include "pt.h"
+
+/**
+ * A task body. Return the PT_* value from the protothread macros; the task
+ *  is removed from the table once it returns PT_EXITED or PT_ENDED.
+ */
+typedef uint8_t (*TASK_fn_t)(pt_t* pt);
+
+BOOL TASK_create(TASK_fn_t fn);
+BOOL TASK_kill(TASK_fn_t fn);
+uint8_t TASK_count(void);
+BOOL TASK_step(void);
+void TASK_runAll(void);
+void TASK_attachToRFID(void);
+void TASK_detachFromRFID(void);
+
+#endif /* TASK_H_ */
@@ -0,0 +1,202 @@
+/**
+ * @file ringbuf.c
+ *
+ * Lock-free single-producer/single-consumer ring buffer.
+ *
+ * The producer fills a slot before it publishes it by advancing head, and the
+ *  consumer copies a slot out before it frees it by advancing tail. The
+ *  storage is accessed as volatile, so the compiler can't move those copies
+ *  across the index updates.
+ */
+
+#include "ringbuf.h"
+
+/**
+ * Set up a ring buffer.
+ *
+ * @param rb control block
+ * @param storage capacity * recSize bytes, owned by the caller
+ * @param capacity number of records, must be a power of two
+ * @param recSize bytes per record, 1 for a byte buffer
+ * @return SUCCESS, or FAIL if capacity is not a power of two
+ */
+BOOL RINGBUF_init(RINGBUF_t* rb, void* storage, uint16_t capacity, uint8_t recSize) {
+    if ((capacity == 0) || (capacity & (capacity - 1)) || (recSize == 0))
+        return FAIL;
+
+    rb->buf = (volatile uint8_t*) storage;
+    rb->mask = capacity - 1;
+    rb->recSize = recSize;
+    rb->head = 0;
+    rb->tail = 0;
+    return SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Append one byte (producer).
+ *
+ * @return SUCCESS, or FAIL if the buffer is full
+ */
+BOOL RINGBUF_putByte(RINGBUF_t* rb, uint8_t byte) {
+    uint16_t head = rb->head;
+
+    if ((uint16_t) (head - rb->tail) > rb->mask)
+        return FAIL;
+
+    rb->buf[head & rb->mask] = byte;
+    rb->head = head + 1;
+    return SUCCESS;
+}
+
+/**
+ * Take the oldest byte (consumer).
+ *
+ * @return SUCCESS, or FAIL if the buffer is empty
+ */
+BOOL RINGBUF_getByte(RINGBUF_t* rb, uint8_t* byte) {
+    uint16_t tail = rb->tail;
+
+    if (tail == rb->head)
+        return FAIL;
+
+    *byte = rb->buf[tail & rb->mask];
+    rb->tail = tail + 1;
+    return SUCCESS;
+}
+
+/**
+ * Append as many bytes as fit (producer). Publishes them all at once.
+ *
+ * @return number of bytes appended
+ */
+uint16_t RINGBUF_write(RINGBUF_t* rb, const uint8_t* data, uint16_t size) {
+    uint16_t head = rb->head;
+    uint16_t space = (rb->mask + 1) - (uint16_t) (head - rb->tail);
+    uint16_t i;
+
+    if (size > space)
+        size = space;
+
+    for (i = 0; i < size; i++)
+        rb->buf[(head + i) & rb->mask] = data[i];
+
+    rb->head = head + size;
+    return size;
+}
+
+/**
+ * Take up to size of the oldest bytes (consumer).
+ *
+ * @return number of bytes copied out
+ */
+uint16_t RINGBUF_read(RINGBUF_t* rb, uint8_t* data, uint16_t size) {
+    uint16_t tail = rb->tail;
+    uint16_t count = rb->head - tail;
+    uint16_t i;
+
+    if (size > count)
+        size = count;
+
+    for (i = 0; i < size; i++)
+        data[i] = rb->buf[(tail + i) & rb->mask];
+
+    rb->tail = tail + size;
+    return size;
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * Append one record of recSize bytes (producer).
+ *
+ * @return SUCCESS, or FAIL if the buffer is full
+ */
+BOOL RINGBUF_put(RINGBUF_t* rb, const void* rec) {
+    uint16_t head = rb->head;
+    volatile uint8_t* slot;
+    const uint8_t* src = (const uint8_t*) rec;
+    uint8_t i;
+
+    if ((uint16_t) (head - rb->tail) > rb->mask)
+        return FAIL;
+
+    slot = &rb->buf[(head & rb->mask) * rb->recSize];
+    for (i = 0; i < rb->recSize; i++)
+        slot[i] = src[i];
+
+    rb->head = head + 1;
+    return SUCCESS;
+}
+
+/**
+ * Copy the oldest record out without removing it (consumer).
+ *
+ * @return SUCCESS, or FAIL if the buffer is empty
+ */
+BOOL RINGBUF_peek(RINGBUF_t* rb, void* rec) {
+    uint16_t tail = rb->tail;
+    volatile uint8_t* slot;
+    uint8_t* dst = (uint8_t*) rec;
+    uint8_t i;
+
+    if (tail == rb->head)
+        return FAIL;
+
+    slot = &rb->buf[(tail & rb->mask) * rb->recSize];
+    for (i = 0; i < rb->recSize; i++)
+        dst[i] = slot[i];
+
+    return SUCCESS;
+}
+
+/**
+ * Take the oldest record (consumer).
+ *
+ * @return SUCCESS, or FAIL if the buffer is empty
+ */
+BOOL RINGBUF_get(RINGBUF_t* rb, void* rec) {
+    if (!RINGBUF_peek(rb, rec))
+        return FAIL;
+
+    rb->tail++; // only the consumer writes tail
+    return SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * @return number of records waiting
+ */
+uint16_t RINGBUF_count(RINGBUF_t* rb) {
+    return rb->head - rb->tail;
+}
+
+/**
+ * @return number of records which can still be appended
+ */
+uint16_t RINGBUF_space(RINGBUF_t* rb) {
+    return (rb->mask + 1) - (uint16_t) (rb->head - rb->tail);
+}
+
+/**
+ * @return TRUE if no records are waiting
+ */
+BOOL RINGBUF_isEmpty(RINGBUF_t* rb) {
+    return (rb->head == rb->tail) ? TRUE : FALSE;
+}
+
+/**
+ * @return TRUE if no record can be appended
+ */
+BOOL RINGBUF_isFull(RINGBUF_t* rb) {
+    return ((uint16_t) (rb->head - rb->tail) > rb->mask) ? TRUE : FALSE;
+}
+
+/**
+ * Drop everything which is waiting (consumer).
+ */
+void RINGBUF_flush(RINGBUF_t* rb) {
+    rb->tail = rb->head;
+}
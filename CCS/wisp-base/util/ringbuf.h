@@ -0,0 +1,62 @@
+/**
+ * @file ringbuf.h
+ *
+ * Lock-free single-producer/single-consumer ring buffer, for handing data
+ *  between an ISR and the main loop (in either direction).
+ */
+
+#ifndef RINGBUF_H_
+#define RINGBUF_H_
+
+#include "../globals.h"
+
+/**
+ * Ring buffer control block. The storage is owned by the caller.
+ *
+ * head is only written by the producer and tail only by the consumer. Both
+ *  run freely and are masked on access; 16-bit accesses are atomic on the
+ *  MSP430, so no critical sections are needed as long as there is exactly one
+ *  producer and one consumer.
+ */
+typedef struct {
+    volatile uint8_t* buf;  // Storage, capacity * recSize bytes
+    uint16_t mask;          // Capacity in records - 1
+    uint8_t recSize;        // Bytes per record, 1 for byte buffers
+    volatile uint16_t head; // Records written so far (producer)
+    volatile uint16_t tail; // Records read so far (consumer)
+} RINGBUF_t;
+
+/**
+ * Static initializer, for buffers which need to work before any init code
+ *  runs. capacity must be a power of two.
+ */
+#define RINGBUF_STATIC(storage, capacity, recSize) \
+    { (volatile uint8_t*) (storage), (capacity) - 1, (recSize), 0, 0 }
+
+/*
+ * Function prototypes
+ */
+
+BOOL RINGBUF_init(RINGBUF_t* rb, void* storage, uint16_t capacity, uint8_t recSize);
+
+// Byte variant (recSize 1)
+BOOL RINGBUF_putByte(RINGBUF_t* rb, uint8_t byte);
+BOOL RINGBUF_getByte(RINGBUF_t* rb, uint8_t* byte);
+uint16_t RINGBUF_write(RINGBUF_t* rb, const uint8_t* data, uint16_t size);
+uint16_t RINGBUF_read(RINGBUF_t* rb, uint8_t* data, uint16_t size);
+
+// Record variant (any recSize)
+BOOL RINGBUF_put(RINGBUF_t* rb, const void* rec);
+BOOL RINGBUF_get(RINGBUF_t* rb, void* rec);
+BOOL RINGBUF_peek(RINGBUF_t* rb, void* rec);
+
+// Status (either side)
+uint16_t RINGBUF_count(RINGBUF_t* rb);
+uint16_t RINGBUF_space(RINGBUF_t* rb);
+BOOL RINGBUF_isEmpty(RINGBUF_t* rb);
+BOOL RINGBUF_isFull(RINGBUF_t* rb);
+
+// Consumer side
+void RINGBUF_flush(RINGBUF_t* rb);
+
+#endif /* RINGBUF_H_ */
@@ -0,0 +1,164 @@
+/**
+ * @file dma.c
+ *
+ * Owner of the DMA_VECTOR interrupt. A driver claims a channel for the
+ *  duration of a transfer (see DMA_CH_* in dma.h for which driver uses which
+ *  channel), together with a completion callback. The callback is called from
+ *  the DMA ISR when the channel's DMAxSZ counts down to zero.
+ */
+
+#include "dma.h"
+
+/**
+ * State variables for the DMA module
+ */
+static struct {
+    void (*callback[DMA_NUM_CHANNELS])(void); // Completion callback per channel, may be NULL
+    uint8_t claimed; // One bit per claimed channel
+    BOOL isWakeRequested; // Leave LPM when the ISR returns
+} DMA_SM;
+
+/**
+ * Common DMA controller setup, safe to call more than once.
+ *
+ * DMARMWDIS makes the controller wait for read-modify-write instructions to
+ *  finish. Without it, a transfer which starts halfway through a BIS/BIC on a
+ *  peripheral register can lose a flag.
+ */
+void DMA_init(void) {
+    DMACTL4 = DMARMWDIS;
+}
+
+/**
+ * Select the trigger source of a channel. The channel must be disabled.
+ *
+ * @param channel DMA_CH_*
+ * @param trigger DMA_TRIG_*
+ */
+void DMA_setTrigger(uint8_t channel, uint8_t trigger) {
+    trigger &= 0x1F;
+
+    switch (channel) {
+    case 0:
+        DMACTL0 = (DMACTL0 & 0xFF00) | trigger;
+        break;
+    case 1:
+        DMACTL0 = (DMACTL0 & 0x00FF) | ((uint16_t) trigger << 8);
+        break;
+    case 2:
+        DMACTL1 = (DMACTL1 & 0xFF00) | trigger;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Take a channel for a transfer. Safe to call from an ISR.
+ *
+ * @param channel DMA_CH_*
+ * @param callback function called from the DMA ISR when the channel
+ *  completes (if its DMAIE bit is set), may be NULL
+ * @return SUCCESS, or FAIL if the channel is in use
+ */
+BOOL DMA_claim(uint8_t channel, void (*callback)(void)) {
+    uint16_t state = __get_interrupt_state();
+    BOOL result = FAIL;
+
+    if (channel >= DMA_NUM_CHANNELS)
+        return FAIL;
+
+    __disable_interrupt();
+
+    if (!(DMA_SM.claimed & (1 << channel))) {
+        DMA_SM.claimed |= (1 << channel);
+        DMA_SM.callback[channel] = callback;
+        result = SUCCESS;
+    }
+
+    __set_interrupt_state(state);
+
+    return result;
+}
+
+/**
+ * Stop a channel and give it back.
+ *
+ * @param channel DMA_CH_*, claimed by the caller
+ */
+void DMA_release(uint8_t channel) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+
+    switch (channel) {
+    case 0:
+        DMA0CTL &= ~(DMAEN | DMAIE | DMAIFG);
+        break;
+    case 1:
+        DMA1CTL &= ~(DMAEN | DMAIE | DMAIFG);
+        break;
+    case 2:
+        DMA2CTL &= ~(DMAEN | DMAIE | DMAIFG);
+        break;
+    default:
+        break;
+    }
+
+    if (channel < DMA_NUM_CHANNELS) {
+        DMA_SM.callback[channel] = 0;
+        DMA_SM.claimed &= ~(1 << channel);
+    }
+
+    __set_interrupt_state(state);
+}
+
+/**
+ * Called from a completion callback: leave the low power mode when the DMA
+ *  ISR returns, e.g. because the main loop sleeps until the transfer is done.
+ */
+void DMA_wakeOnExit(void) {
+    DMA_SM.isWakeRequested = TRUE;
+}
+
+/**
+ * @return TRUE if a driver holds the channel
+ */
+BOOL DMA_isClaimed(uint8_t channel) {
+    return (DMA_SM.claimed & (1 << channel)) ? TRUE : FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// INT_DMA
+//
+// Shared interrupt of all DMA channels. Reading DMAIV clears the flag of the
+// channel being serviced.
+//
+////////////////////////////////////////////////////////////////////////////
+#pragma vector=DMA_VECTOR
+__interrupt void INT_DMA(void)
+{
+    uint8_t channel;
+
+    switch (__even_in_range(DMAIV, DMAIV_DMA2IFG)) {
+    case DMAIV_DMA0IFG:
+        channel = 0;
+        break;
+    case DMAIV_DMA1IFG:
+        channel = 1;
+        break;
+    case DMAIV_DMA2IFG:
+        channel = 2;
+        break;
+    default:
+        return;
+    }
+
+    if (DMA_SM.callback[channel])
+        DMA_SM.callback[channel]();
+
+    if (DMA_SM.isWakeRequested) {
+        DMA_SM.isWakeRequested = FALSE;
+        __bic_SR_register_on_exit(LPM4_bits);
+    }
+}
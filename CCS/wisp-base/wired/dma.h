@@ -0,0 +1,52 @@
+/**
+ * @file dma.h
+ *
+ * Shared access to the three DMA channels and the DMA interrupt vector
+ */
+
+#ifndef DMA_H_
+#define DMA_H_
+
+#include "../globals.h"
+
+/*
+ * Channel assignment. Channel 0 has the highest priority, which SPI receive
+ *  needs to keep up with SPI transmit. UART and SPI transmit share channel 1,
+ *  UART receive and ADC sequences share channel 2; whoever finds a channel
+ *  claimed falls back to interrupt driven transfers. FRAM block copies
+ *  borrow channel 0 for as long as they take, or use the CPU.
+ *
+ * The drivers use the DMAx registers of these channels by name.
+ */
+#define DMA_CH_SPI_RX       (0)     // SPI job receive
+#define DMA_CH_FRAM         (0)     // FRAM block copy (software triggered)
+#define DMA_CH_UART_TX      (1)     // UART transmit
+#define DMA_CH_SPI_TX       (1)     // SPI job transmit
+#define DMA_CH_UART_RX      (2)     // UART receive into a circular buffer
+#define DMA_CH_ADC          (2)     // ADC sequence results
+#define DMA_NUM_CHANNELS    (3)
+
+/*
+ * Trigger sources (see the MSP430FR5969 datasheet, DMA trigger assignments)
+ */
+#define DMA_TRIG_DMAREQ     (0)     // Software trigger (DMAREQ)
+#define DMA_TRIG_UCA0RX     (14)    // eUSCI_A0 UCRXIFG
+#define DMA_TRIG_UCA0TX     (15)    // eUSCI_A0 UCTXIFG
+#define DMA_TRIG_UCA1RX     (16)    // eUSCI_A1 UCRXIFG
+#define DMA_TRIG_UCA1TX     (17)    // eUSCI_A1 UCTXIFG
+#define DMA_TRIG_UCB0RX     (18)    // eUSCI_B0 UCRXIFG0
+#define DMA_TRIG_UCB0TX     (19)    // eUSCI_B0 UCTXIFG0
+#define DMA_TRIG_ADC12      (26)    // ADC12 end of conversion (of the sequence)
+
+/*
+ * Function prototypes
+ */
+
+void DMA_init(void);
+void DMA_setTrigger(uint8_t channel, uint8_t trigger);
+BOOL DMA_claim(uint8_t channel, void (*callback)(void));
+void DMA_release(uint8_t channel);
+BOOL DMA_isClaimed(uint8_t channel);
+void DMA_wakeOnExit(void);
+
+#endif /* DMA_H_ */
@@ -0,0 +1,212 @@
+/**
+ * @file frame.c
+ *
+ * COBS framing with a length, a sequence number and a CRC16 (see frame.h).
+ *
+ * The CRC comes from crc16_ccitt(), i.e. the CRC16 peripheral. It is the
+ *  same module the RFID handlers use from WISP_doRFID(), so don't encode or
+ *  decode frames from an ISR or a WISP_doRFID() hook.
+ */
+
+#include "frame.h"
+#include "uart.h"
+#include "../Math/crc16.h"
+
+#if (FRAME_MAX_PAYLOAD > 249)
+#error "FRAME_MAX_PAYLOAD must be at most 249, so a frame needs only one COBS code byte"
+#endif
+
+/**
+ * State variables for the framing module
+ */
+static struct {
+    uint8_t txSeq; // Sequence number of the next frame sent with FRAME_send()
+} FRAME_SM;
+
+/**
+ * CRC16 of len, seq and the payload of a frame buffer
+ */
+static uint16_t FRAME_crc(uint8_t* buf, uint8_t len) {
+    return crc16_ccitt(CRC_NO_PRELOAD, buf + 1, 2 + len); // numBytes is never 0
+}
+
+/**
+ * Turn a buffer with len payload bytes at FRAME_PAYLOAD(buf) into a frame,
+ *  ready to go out on the wire.
+ *
+ * @param buf frame buffer of FRAME_BUF_SIZE bytes
+ * @param len payload length, at most FRAME_MAX_PAYLOAD
+ * @param seq sequence number
+ * @return the number of bytes to send from buf, including the delimiter, or
+ *  0 if len is too long
+ */
+uint16_t FRAME_encode(uint8_t* buf, uint8_t len, uint8_t seq) {
+    uint16_t crc;
+    uint16_t n; // Unencoded bytes after the COBS code
+    uint16_t code;
+    uint16_t i;
+
+    if (len > FRAME_MAX_PAYLOAD)
+        return 0;
+
+    buf[1] = len;
+    buf[2] = seq;
+
+    crc = FRAME_crc(buf, len);
+    buf[FRAME_HEADER_SIZE + len] = (uint8_t) (crc >> 8);
+    buf[FRAME_HEADER_SIZE + len + 1] = (uint8_t) crc;
+
+    // Every 0x00 becomes the distance to the next one (or to the end); the
+    //  first distance goes in the COBS code byte at buf[0].
+    n = 2 + len + 2;
+    code = 0;
+    for (i = 1; i <= n; i++) {
+        if (buf[i] == 0) {
+            buf[code] = (uint8_t) (i - code);
+            code = i;
+        }
+    }
+    buf[code] = (uint8_t) (n + 1 - code);
+
+    buf[n + 1] = FRAME_DELIMITER;
+
+    return n + 2;
+}
+
+/**
+ * Decode a received frame in place and check it.
+ *
+ * @param buf frame buffer, the bytes received before the delimiter
+ * @param size number of bytes in buf
+ * @param len receives the payload length; the payload is at FRAME_PAYLOAD(buf)
+ * @param seq receives the sequence number
+ * @return SUCCESS, or FAIL if the frame is malformed or the CRC is wrong
+ */
+BOOL FRAME_decode(uint8_t* buf, uint16_t size, uint8_t* len, uint8_t* seq) {
+    uint16_t pos = 0;
+    uint16_t next;
+    uint8_t code;
+    uint16_t crc;
+
+    if ((size < FRAME_HEADER_SIZE + 2) || (size > FRAME_BUF_SIZE - 1))
+        return FAIL;
+
+    // Follow the chain of COBS codes, putting the 0x00 bytes back.
+    code = buf[0];
+    while (TRUE) {
+        if (code == 0)
+            return FAIL;
+
+        next = pos + code;
+        if (next > size)
+            return FAIL;
+        if (next == size)
+            break;
+
+        code = buf[next];
+        buf[next] = 0;
+        pos = next;
+    }
+
+    if (buf[1] != size - (FRAME_HEADER_SIZE + 2))
+        return FAIL;
+
+    crc = ((uint16_t) buf[size - 2] << 8) | buf[size - 1];
+    if (crc != FRAME_crc(buf, buf[1]))
+        return FAIL;
+
+    *len = buf[1];
+    *seq = buf[2];
+    return SUCCESS;
+}
+
+/**
+ * Reset a frame receiver. It discards everything up to the first delimiter.
+ */
+void FRAME_initRx(FRAME_rx_t* rx) {
+    rx->size = 0;
+    rx->len = 0;
+    rx->seq = 0;
+    rx->isSynced = FALSE;
+    rx->hasSeq = FALSE;
+    rx->expectedSeq = 0;
+    rx->errors = 0;
+    rx->lost = 0;
+}
+
+/**
+ * Feed one received byte to a frame receiver.
+ *
+ * @return SUCCESS when the byte completed a good frame; its payload is at
+ *  FRAME_PAYLOAD(rx->buf) with rx->len bytes, valid until the next push
+ */
+BOOL FRAME_push(FRAME_rx_t* rx, uint8_t byte) {
+    uint16_t size;
+
+    if (byte != FRAME_DELIMITER) {
+        if (rx->size < FRAME_BUF_SIZE)
+            rx->buf[rx->size] = byte;
+        if (rx->size < 0xFFFF)
+            rx->size++;
+        return FAIL;
+    }
+
+    size = rx->size;
+    rx->size = 0;
+
+    if (!rx->isSynced) {
+        rx->isSynced = TRUE; // Bytes before the first delimiter may be a partial frame
+        return FAIL;
+    }
+
+    if (size == 0)
+        return FAIL; // Back-to-back delimiters are allowed as padding
+
+    if ((size > FRAME_BUF_SIZE - 1)
+            || !FRAME_decode(rx->buf, size, &rx->len, &rx->seq)) {
+        rx->errors++;
+        return FAIL;
+    }
+
+    if (rx->hasSeq)
+        rx->lost += (uint8_t) (rx->seq - rx->expectedSeq);
+    rx->hasSeq = TRUE;
+    rx->expectedSeq = rx->seq + 1;
+
+    return SUCCESS;
+}
+
+/**
+ * Encode and queue a frame on the UART, with the next sequence number. Only
+ *  blocks while the UART TX buffer is full (see UART_asyncSend()).
+ *
+ * @param buf frame buffer with the payload at FRAME_PAYLOAD(buf); it is
+ *  encoded in place and may be reused on return
+ * @param len payload length, at most FRAME_MAX_PAYLOAD
+ */
+void FRAME_send(uint8_t* buf, uint8_t len) {
+    uint16_t size = FRAME_encode(buf, len, FRAME_SM.txSeq);
+
+    if (size == 0)
+        return;
+
+    FRAME_SM.txSeq++;
+    UART_asyncSend(buf, size);
+}
+
+/**
+ * Feed bytes buffered by the UART RX ISR (see UART_startListening()) to a
+ *  frame receiver, up to the end of the first good frame.
+ *
+ * @return SUCCESS if a good frame is ready in rx
+ */
+BOOL FRAME_poll(FRAME_rx_t* rx) {
+    uint8_t byte;
+
+    while (UART_read(&byte, 1)) {
+        if (FRAME_push(rx, byte))
+            return SUCCESS;
+    }
+
+    return FAIL;
+}
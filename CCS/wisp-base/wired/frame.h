@@ -0,0 +1,64 @@
+/**
+ * @file frame.h
+ *
+ * Binary framing for the UART link
+ *
+ * Wire format, one frame:
+ *
+ *   COBS( len | seq | payload[len] | crc16 ) 0x00
+ *
+ * len is the payload length, seq counts frames per direction (mod 256) and
+ *  crc16 is crc16_ccitt() over len, seq and the payload, MSB first. COBS
+ *  removes every 0x00 from the frame, so the 0x00 delimiter always marks a
+ *  frame boundary: a receiver which drops or corrupts a byte loses only the
+ *  frame it was in.
+ *
+ * Encoding and decoding work in place in a buffer of FRAME_BUF_SIZE bytes;
+ *  the payload always sits at FRAME_PAYLOAD(buf).
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include "../globals.h"
+
+#define FRAME_HEADER_SIZE   (3)     // COBS code + len + seq
+#define FRAME_TRAILER_SIZE  (3)     // crc16 + delimiter
+#define FRAME_BUF_SIZE      (FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD + FRAME_TRAILER_SIZE)
+
+#define FRAME_DELIMITER     (0x00)
+
+/**
+ * Payload of an encoded or decoded frame buffer
+ */
+#define FRAME_PAYLOAD(buf)  ((buf) + FRAME_HEADER_SIZE)
+
+/**
+ * Frame receiver state. Bytes are collected and decoded in buf.
+ */
+typedef struct {
+    uint8_t buf[FRAME_BUF_SIZE];
+    uint16_t size; // Bytes collected since the last delimiter
+    uint8_t len; // Payload length of the last good frame
+    uint8_t seq; // Sequence number of the last good frame
+    uint8_t isSynced; // Has a delimiter been seen yet?
+    uint8_t hasSeq; // Is expectedSeq known yet?
+    uint8_t expectedSeq;
+    uint16_t errors; // Frames dropped for bad COBS, length or CRC
+    uint16_t lost; // Frames missing according to the sequence numbers
+} FRAME_rx_t;
+
+/*
+ * Function prototypes
+ */
+
+uint16_t FRAME_encode(uint8_t* buf, uint8_t len, uint8_t seq);
+BOOL FRAME_decode(uint8_t* buf, uint16_t size, uint8_t* len, uint8_t* seq);
+
+void FRAME_initRx(FRAME_rx_t* rx);
+BOOL FRAME_push(FRAME_rx_t* rx, uint8_t byte);
+
+void FRAME_send(uint8_t* buf, uint8_t len);
+BOOL FRAME_poll(FRAME_rx_t* rx);
+
+#endif /* FRAME_H_ */
@@ -1,6 +1,12 @@
 /**
  * sensor_spi.c
  *
+ * Besides the blocking SPI_transaction(), the bus runs a queue of jobs. Each
+ *  job brings its own chip select, buffers and completion callback; jobs run
+ *  back to back, moved by the DMA controller (or by the USCI_A1 ISR while the
+ *  shared DMA transmit channel is busy with the UART). This module owns
+ *  USCI_A1_VECTOR.
+ *
  * @author Aaron Parks
  * @date Aug 2013
  *
@@ -10,9 +16,12 @@
 #include <msp430.h>
 #include "../globals.h"
 #include "spi.h"
+#include "dma.h"
 
 uint8_t gpRxBuf[SPI_GP_RXBUF_SIZE];
 
+static const uint8_t SPI_fill = SPI_FILL_BYTE; // DMA source for jobs without txBuf
+
 /**
  * Description of state of the SPI module.
  */
@@ -24,8 +33,157 @@ static struct {
     unsigned int uiBytesToSend;
     uint8_t *pcRxBuffer;
     uint8_t *pcTxBuffer;
+
+    SPI_job_t* head; // Job queue, the running job first
+    SPI_job_t* tail;
+    BOOL isRunning; // Is the head job on the bus?
+    BOOL isDma; // Does the running job use the DMA channels?
+    uint16_t idx; // Bytes done by the ISR, when not using DMA
+    uint8_t sink; // DMA destination for jobs without rxBuf
+    volatile BOOL isSleeping; // Main loop sleeps in SPI_waitForJob()
+    BOOL isWakeRequested; // Leave LPM when the ISR returns
 } spiSM;
 
+static void SPI_dmaDone(void);
+
+/**
+ * Put the job at the head of the queue on the bus, if the bus is free.
+ *
+ * @pre interrupts are disabled
+ */
+static void SPI_startJob(void) {
+    SPI_job_t* job = spiSM.head;
+
+    if ((job == 0) || spiSM.isRunning || spiSM.bPortInUse)
+        return;
+
+    spiSM.isRunning = TRUE;
+
+    if (job->csPort)
+        BITCLR(*job->csPort, job->csPin);
+
+    UCA1IFG &= ~UCRXIFG;
+
+    // DMA needs both channels, the transmit one is shared with the UART
+    spiSM.isDma = FALSE;
+    if (DMA_claim(DMA_CH_SPI_RX, &SPI_dmaDone)) {
+        if (DMA_claim(DMA_CH_SPI_TX, 0))
+            spiSM.isDma = TRUE;
+        else
+            DMA_release(DMA_CH_SPI_RX);
+    }
+
+    if (spiSM.isDma) {
+        DMA_init();
+        DMA_setTrigger(DMA_CH_SPI_RX, DMA_TRIG_UCA1RX);
+        DMA_setTrigger(DMA_CH_SPI_TX, DMA_TRIG_UCA1TX);
+
+        __data16_write_addr((unsigned short) &DMA0SA, (unsigned long) &UCA1RXBUF);
+        __data16_write_addr((unsigned short) &DMA0DA,
+                (unsigned long) (job->rxBuf ? job->rxBuf : &spiSM.sink));
+        DMA0SZ = job->size;
+        DMA0CTL = DMADT_0 | DMASRCINCR_0 | (job->rxBuf ? DMADSTINCR_3 : DMADSTINCR_0)
+                | DMASRCBYTE | DMADSTBYTE | DMAIE | DMAEN;
+
+        // The trigger is the rising edge of UCTXIFG; the first byte goes by hand
+        if (job->size > 1) {
+            __data16_write_addr((unsigned short) &DMA1SA,
+                    (unsigned long) (job->txBuf ? job->txBuf + 1 : &SPI_fill));
+            __data16_write_addr((unsigned short) &DMA1DA, (unsigned long) &UCA1TXBUF);
+            DMA1SZ = job->size - 1;
+            DMA1CTL = DMADT_0 | (job->txBuf ? DMASRCINCR_3 : DMASRCINCR_0) | DMADSTINCR_0
+                    | DMASRCBYTE | DMADSTBYTE | DMAEN;
+        }
+    } else {
+        spiSM.idx = 0;
+        UCA1IE |= UCRXIE;
+    }
+
+    UCA1TXBUF = job->txBuf ? job->txBuf[0] : SPI_FILL_BYTE;
+}
+
+/**
+ * The last byte of the running job has been received: release the bus and
+ *  start the next job.
+ */
+static void SPI_finishJob(void) {
+    SPI_job_t* job = spiSM.head;
+
+    if (spiSM.isDma) {
+        DMA_release(DMA_CH_SPI_RX);
+        DMA_release(DMA_CH_SPI_TX);
+    } else {
+        UCA1IE &= ~UCRXIE;
+    }
+
+    if (job->csPort)
+        BITSET(*job->csPort, job->csPin);
+
+    spiSM.head = job->next;
+    if (spiSM.head == 0)
+        spiSM.tail = 0;
+    job->next = 0;
+    spiSM.isRunning = FALSE;
+
+    job->flags = SPI_JOB_DONE;
+
+    if (job->callback)
+        job->callback();
+
+    SPI_startJob();
+
+    if (spiSM.isSleeping) {
+        spiSM.isSleeping = FALSE;
+        spiSM.isWakeRequested = TRUE;
+    }
+}
+
+/**
+ * DMA completion callback of the receive channel
+ */
+static void SPI_dmaDone(void) {
+    SPI_finishJob();
+
+    if (spiSM.isWakeRequested) {
+        spiSM.isWakeRequested = FALSE;
+        DMA_wakeOnExit();
+    }
+}
+
+/**
+ * A byte of the running job has been received (when not using DMA).
+ */
+static void SPI_stepByte(void) {
+    SPI_job_t* job = spiSM.head;
+    uint8_t rec = UCA1RXBUF;
+
+    if (job->rxBuf)
+        job->rxBuf[spiSM.idx] = rec;
+
+    if (++spiSM.idx < job->size)
+        UCA1TXBUF = job->txBuf ? job->txBuf[spiSM.idx] : SPI_FILL_BYTE;
+    else
+        SPI_finishJob();
+}
+
+/**
+ * Move the queue forward without interrupts.
+ *
+ * @pre interrupts are disabled
+ */
+static void SPI_poll(void) {
+    if (!spiSM.isRunning) {
+        SPI_startJob();
+    } else if (spiSM.isDma) {
+        if (DMA0CTL & DMAIFG) {
+            DMA0CTL &= ~DMAIFG;
+            SPI_finishJob();
+        }
+    } else if (UCA1IFG & UCRXIFG) {
+        SPI_stepByte();
+    }
+}
+
 
 /**
  *
@@ -51,6 +209,10 @@ BOOL SPI_initialize() {
     BITCLR(UCA1CTL1, UCSWRST);
 
     // State variable initialization
+    UCA1IE = 0;
+    spiSM.head = 0;
+    spiSM.tail = 0;
+    spiSM.isRunning = FALSE;
     spiSM.bPortInUse = FALSE;
     spiSM.bNewDataReceived = FALSE;
     spiSM.uiCurRx = 0;
@@ -66,14 +228,22 @@ BOOL SPI_initialize() {
  * @return Success - you were able to get the port. Fail - you don't have the port, so don't use it.
  */
 BOOL SPI_acquirePort() {
+    uint16_t state = __get_interrupt_state();
+    BOOL result;
 
-    if(spiSM.bPortInUse) {
-        return FAIL;
+    __disable_interrupt();
+
+    // Queued jobs go first
+    if(spiSM.bPortInUse || spiSM.head) {
+        result = FAIL;
     } else {
         spiSM.bPortInUse=TRUE;
-        return SUCCESS;
+        result = SUCCESS;
     }
 
+    __set_interrupt_state(state);
+
+    return result;
 }
 
 /**
@@ -82,8 +252,16 @@ BOOL SPI_acquirePort() {
  * @todo Make this more robust (don't allow release of port if we don't have it)
  */
 BOOL SPI_releasePort() {
+    uint16_t state;
+
     if(spiSM.bPortInUse) {
+        state = __get_interrupt_state();
+        __disable_interrupt();
+
         spiSM.bPortInUse = FALSE;
+        SPI_startJob(); // Jobs submitted meanwhile
+
+        __set_interrupt_state(state);
         return SUCCESS;
     }
     return FAIL;
@@ -139,6 +317,120 @@ BOOL SPI_transaction(uint8_t* rxBuf, uint8_t* txBuf, uint16_t size) {
     return SUCCESS;
 }
 
+/**
+ * Prepare a job. The chip select pin must already be an output, high.
+ *
+ * @param job caller owned job
+ * @param csPort PxOUT register of the chip select (e.g. &POUT_ACCEL_CS), NULL for none
+ * @param csPin chip select bit
+ * @param txBuf bytes to send, NULL to send SPI_FILL_BYTE
+ * @param rxBuf buffer for the received bytes, NULL to drop them
+ * @param size transfer length in bytes
+ * @param callback called from the ISR when the job is done, may be NULL
+ */
+void SPI_initJob(SPI_job_t* job, volatile uint8_t* csPort, uint8_t csPin,
+        uint8_t* txBuf, uint8_t* rxBuf, uint16_t size, void (*callback)(void)) {
+    job->next = 0;
+    job->csPort = csPort;
+    job->csPin = csPin;
+    job->txBuf = txBuf;
+    job->rxBuf = rxBuf;
+    job->size = size;
+    job->callback = callback;
+    job->flags = 0;
+}
+
+/**
+ * Queue a job. It starts right away if the bus is free. Safe to call from an
+ *  ISR or a job callback.
+ *
+ * @return SUCCESS, or FAIL if the job is empty or still queued
+ */
+BOOL SPI_submit(SPI_job_t* job) {
+    uint16_t state;
+
+    if ((job->size == 0) || (job->flags & SPI_JOB_QUEUED))
+        return FAIL;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+
+    job->next = 0;
+    job->flags = SPI_JOB_QUEUED;
+
+    if (spiSM.tail)
+        spiSM.tail->next = job;
+    else
+        spiSM.head = job;
+    spiSM.tail = job;
+
+    SPI_startJob();
+
+    __set_interrupt_state(state);
+
+    return SUCCESS;
+}
+
+/**
+ * @return TRUE once the job has completed
+ */
+BOOL SPI_isJobDone(SPI_job_t* job) {
+    return (job->flags & SPI_JOB_DONE) ? TRUE : FALSE;
+}
+
+/**
+ * Wait for a submitted job to complete. Sleeps in LPM0 if interrupts are
+ *  enabled; otherwise (in an ISR or a WISP_doRFID() hook) the transfer is
+ *  moved along by polling.
+ */
+void SPI_waitForJob(SPI_job_t* job) {
+    if (!(__get_interrupt_state() & GIE)) {
+        while (job->flags & SPI_JOB_QUEUED)
+            SPI_poll();
+        return;
+    }
+
+    __disable_interrupt();
+
+    while (job->flags & SPI_JOB_QUEUED) {
+        spiSM.isSleeping = TRUE;
+        __bis_SR_register(LPM0_bits | GIE); // SMCLK keeps the USCI running
+        __disable_interrupt();
+    }
+    spiSM.isSleeping = FALSE;
+
+    __enable_interrupt();
+}
+
+/**
+ * @return TRUE if no job is queued or running
+ */
+BOOL SPI_isIdle(void) {
+    return (spiSM.head == 0) ? TRUE : FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// SPI_ISR
+//
+// Receive interrupt of eUSCI_A1, only enabled while a job runs without DMA.
+//
+////////////////////////////////////////////////////////////////////////////
+#pragma vector=USCI_A1_VECTOR
+__interrupt void SPI_ISR(void) {
+    switch (__even_in_range(UCA1IV, USCI_SPI_UCTXIFG)) {
+    case USCI_SPI_UCRXIFG:
+        SPI_stepByte();
+        break;
+    default:
+        break;
+    }
+
+    if (spiSM.isWakeRequested) {
+        spiSM.isWakeRequested = FALSE;
+        __bic_SR_register_on_exit(LPM4_bits);
+    }
+}
+
 
 /// Be careful that FR5969 has 16 bits UCA1RXBUF and UCA1TXBUF other than F5310 that had 8 bits.
 //#pragma vector=USCI_A1_VECTOR
@@ -8,14 +8,47 @@
 #ifndef SPI_H_
 #define SPI_H_
 
+#include "../globals.h"
+
 #define SPI_GP_RXBUF_SIZE 20
 extern uint8_t gpRxBuf[SPI_GP_RXBUF_SIZE];
 
+/*
+ * Job state bits (owned by the SPI module)
+ */
+#define SPI_JOB_QUEUED  (0x01)  // Job waits in the queue or is running
+#define SPI_JOB_DONE    (0x02)  // Job has completed
+
+#define SPI_FILL_BYTE   (0x00)  // Sent by jobs without a TX buffer
+
+/**
+ * One chip-select framed transfer on the eUSCI_A1 SPI bus. The memory
+ *  (including the buffers) is owned by the caller and must stay valid until
+ *  the job is done.
+ */
+typedef struct SPI_job {
+    struct SPI_job* next;               // Next job in the queue
+    volatile uint8_t* csPort;           // PxOUT of the active low chip select, NULL for none
+    uint8_t csPin;                      // Chip select bit in csPort
+    uint8_t* txBuf;                     // Bytes to send, NULL to send SPI_FILL_BYTE
+    uint8_t* rxBuf;                     // Bytes received, NULL to drop them
+    uint16_t size;                      // Transfer length in bytes
+    void (*callback)(void);             // Called from the ISR when done, may be NULL
+    volatile uint8_t flags;             // SPI_JOB_* state bits
+} SPI_job_t;
+
 BOOL SPI_initialize();
 BOOL SPI_acquirePort();
 BOOL SPI_releasePort();
 BOOL SPI_transaction(uint8_t* rxBuf, uint8_t* txBuf, uint16_t size);
 
+void SPI_initJob(SPI_job_t* job, volatile uint8_t* csPort, uint8_t csPin,
+        uint8_t* txBuf, uint8_t* rxBuf, uint16_t size, void (*callback)(void));
+BOOL SPI_submit(SPI_job_t* job);
+BOOL SPI_isJobDone(SPI_job_t* job);
+void SPI_waitForJob(SPI_job_t* job);
+BOOL SPI_isIdle(void);
+
 #ifdef __MSPGCC__
 #define USCI_UCRXIFG UCRXIFG
 #define USCI_UCTXIFG UCTXIFG
@@ -7,20 +7,130 @@
 
 #include "uart.h"
 #include "../globals.h"
+#include "../util/ringbuf.h"
+#include "../Timing/timer.h"
+#include "dma.h"
+
+static uint8_t UART_txBuf[UART_TX_BUFFER_SIZE]; // Storage of UART_SM.txRing
+static uint8_t UART_rxBuf[UART_RX_BUFFER_SIZE]; // Storage of UART_SM.rxRing
 
 /**
  * State variables for the UART module
  */
 static struct {
-    uint8_t isTxBusy; // Is the module currently in the middle of a transmit operation?
-    uint8_t* txPtr; // Pointer to the next byte to be transmitted
-    uint16_t txBytesRemaining; // Number of bytes left to send
+    RINGBUF_t txRing; // Bytes queued for the TX ISR
+    volatile uint8_t isTxBusy; // Is the module currently in the middle of a transmit operation?
+
+    RINGBUF_t rxRing; // Bytes received while no receive request was open
+    volatile uint16_t rxDropped; // Bytes lost because rxRing was full
+    uint8_t isListening; // Keep the RX interrupt on between receive requests?
 
-    uint8_t isRxBusy; // Is the module currently in the middle of a receive operation?
+    volatile uint8_t isRxBusy; // Is the module currently in the middle of a receive operation?
     uint8_t* rxPtr; // Pointer to the next byte to be received
     uint16_t rxBytesRemaining; // Maximum number of bytes left to receive
     uint8_t rxTermChar; // Stop receiving on this char.
-} UART_SM;
+
+    void (*txCallback)(void); // Called when a UART_dmaSend() transmission is on the line
+    uint8_t* txPtr; // Next byte of a UART_dmaSend() buffer sent by the TX ISR
+    uint16_t txBytesRemaining; // Bytes of that buffer left for the TX ISR
+    uint8_t isTxDma; // Does the UART hold the TX DMA channel?
+    volatile uint8_t isSleeping; // Main loop sleeps in UART_waitForTx()
+
+    uint8_t* dmaRxBuf; // Circular buffer filled by the RX DMA channel
+    uint16_t dmaRxSize; // Its size, 0 when DMA reception is off
+    uint16_t dmaRxTail; // Next byte for UART_dmaRead()
+    uint16_t dmaRxLastHead; // Write index seen by the last idle check
+    uint8_t isRxActive; // Did bytes arrive since the last idle check?
+    volatile uint8_t isRxIdle; // Line went idle after a burst
+    void (*rxIdleCallback)(void); // Called when the line goes idle
+    Timer_alarm_t rxIdleAlarm; // Periodic idle check
+} UART_SM = {
+    RINGBUF_STATIC(UART_txBuf, UART_TX_BUFFER_SIZE, 1), FALSE,
+    RINGBUF_STATIC(UART_rxBuf, UART_RX_BUFFER_SIZE, 1), 0, FALSE,
+};
+
+/**
+ * Hand the next queued byte to the USCI and let the TX ISR send the rest.
+ *  Does nothing while the TX ISR is running.
+ *
+ * The TX ISR is the consumer of txRing; this takes its place only while the
+ *  TX interrupt is off.
+ */
+static void UART_startTx(void) {
+    uint8_t byte;
+
+    if (UART_SM.isTxBusy || !RINGBUF_getByte(&UART_SM.txRing, &byte))
+        return;
+
+    UART_SM.isTxBusy = TRUE;
+
+    UCA0IFG &= ~(USCI_UART_UCTXIFG); // Clear byte completion flag
+
+    UCA0IE |= UCTXIE; // Enable USCI_A0 TX interrupt
+    UCA0TXBUF = byte; // Load in first byte
+}
+
+/**
+ * DMA completion of a transmission: the last byte is in UCA0TXBUF. Let the
+ *  UART ISR finish once it has been shifted out.
+ */
+static void UART_dmaTxDone(void) {
+    DMA_release(DMA_CH_UART_TX);
+    UART_SM.isTxDma = FALSE;
+
+    UCA0IFG &= ~(UCTXCPTIFG);
+    UCA0IE |= UCTXCPTIE;
+}
+
+/**
+ * @return index in dmaRxBuf the RX DMA channel writes next
+ */
+static uint16_t UART_dmaRxHead(void) {
+    uint16_t head = UART_SM.dmaRxSize - DMA2SZ; // DMA2SZ counts down and reloads
+
+    return (head >= UART_SM.dmaRxSize) ? 0 : head;
+}
+
+/**
+ * Idle-line detection for DMA reception, runs from the Timer_A2 ISR. The
+ *  eUSCI has no idle-line interrupt in plain UART mode, so the line counts as
+ *  idle when the DMA write index stands still for one check period after it
+ *  moved.
+ */
+static void UART_dmaIdleCheck(void) {
+    uint16_t head = UART_dmaRxHead();
+
+    if (head != UART_SM.dmaRxLastHead) {
+        UART_SM.dmaRxLastHead = head;
+        UART_SM.isRxActive = TRUE;
+    } else if (UART_SM.isRxActive) {
+        UART_SM.isRxActive = FALSE;
+        UART_SM.isRxIdle = TRUE;
+
+        if (UART_SM.rxIdleCallback)
+            UART_SM.rxIdleCallback();
+    }
+}
+
+/**
+ * Move bytes which arrived before a receive request into the request.
+ *
+ * @pre the RX interrupt is off
+ * @return TRUE if that completed the request
+ */
+static uint8_t UART_takeBuffered(void) {
+    uint8_t rec;
+
+    while (UART_SM.rxBytesRemaining && RINGBUF_getByte(&UART_SM.rxRing, &rec)) {
+        *(UART_SM.rxPtr++) = rec;
+        UART_SM.rxBytesRemaining--;
+
+        if (rec == UART_SM.rxTermChar)
+            return TRUE;
+    }
+
+    return (0 == UART_SM.rxBytesRemaining);
+}
 
 /**
  * Configure the internal clocks for UART transmission.
@@ -85,39 +195,58 @@ void UART_initCustom(uint32_t fsmclk, uint32_t baudrate) {
     UCA0CTLW0 &= ~UCSWRST;
 
     // Initialize module state
+    RINGBUF_flush(&UART_SM.txRing);
     UART_SM.isTxBusy = FALSE;
-    UART_SM.txBytesRemaining = 0;
+    RINGBUF_flush(&UART_SM.rxRing);
+    UART_SM.rxDropped = 0;
+    UART_SM.isListening = FALSE;
     UART_SM.isRxBusy = FALSE;
     UART_SM.rxBytesRemaining = 0;
     UART_SM.rxTermChar = '\0';
 
+    if (UART_SM.isTxDma) {
+        DMA_release(DMA_CH_UART_TX);
+        UART_SM.isTxDma = FALSE;
+    }
+    UART_SM.txCallback = 0;
+    UART_SM.txBytesRemaining = 0;
+    UART_dmaStopReceiving();
+
 }
 
 /**
- * Transmit the contents of the given character buffer. Do not block.
+ * Queue as much of the given bytes as fits in the TX buffer. Never blocks.
  *
- * @param txBuf the character buffer to be transmitted
+ * @param txBuf the bytes to be transmitted
  * @param size the number of bytes to send
+ * @return the number of bytes queued
  */
-void UART_asyncSend(uint8_t* txBuf, uint16_t size) {
-
-    // Block until prior transmission has completed
-    while (UART_SM.isTxBusy)
-        ;
+uint16_t UART_write(uint8_t* txBuf, uint16_t size) {
+    uint16_t n = RINGBUF_write(&UART_SM.txRing, txBuf, size);
 
-    // Set up for start of transmission
-    UART_SM.isTxBusy = TRUE;
-    UART_SM.txPtr = txBuf;
-    UART_SM.txBytesRemaining = size - 1;
+    UART_startTx();
+    return n;
+}
 
-    UCA0IFG &= ~(USCI_UART_UCTXIFG); // Clear byte completion flag
+/**
+ * Transmit the contents of the given character buffer. Only blocks while the
+ *  TX buffer is full; the buffer may be reused as soon as this returns.
+ *
+ * @param txBuf the character buffer to be transmitted
+ * @param size the number of bytes to send
+ */
+void UART_asyncSend(uint8_t* txBuf, uint16_t size) {
+    uint16_t n;
 
-    UCA0IE |= UCTXIE; // Enable USCI_A0 TX interrupt
-    UCA0TXBUF = *(UART_SM.txPtr++); // Load in first byte
+    while (size) {
+        n = UART_write(txBuf, size);
+        txBuf += n;
+        size -= n;
+    }
 
     // The rest of the transmission will be completed by the TX ISR (which
     //  will wake after each byte has been transmitted), and the isBusy flag
-    //  will be cleared when done.
+    //  will be cleared when the buffer is empty.
 }
 
 /**
@@ -170,13 +299,11 @@ void UART_critSend(uint8_t* txBuf, uint16_t size) {
 
     // Set up for start of transmission
     UART_SM.isTxBusy = TRUE;
-    UART_SM.txPtr = txBuf;
-    UART_SM.txBytesRemaining = size;
 
     UCA0IV &= ~(USCI_UART_UCTXIFG); // Clear byte completion flag
 
-    while (UART_SM.txBytesRemaining--) {
-        UCA0TXBUF = *(UART_SM.txPtr++); // Load in next byte
+    while (size--) {
+        UCA0TXBUF = *(txBuf++); // Load in next byte
         while (!(UCA0IFG & UCTXIFG))
             ; // Wait for byte transmission to complete
         UCA0IFG &= ~(UCTXIFG); // Clear byte completion flag
@@ -185,6 +312,85 @@ void UART_critSend(uint8_t* txBuf, uint16_t size) {
     UART_SM.isTxBusy = FALSE;
 }
 
+/**
+ * Transmit the contents of the given character buffer with DMA. Do not block.
+ *
+ * The DMA controller moves every byte but the first into UCA0TXBUF, so the
+ *  CPU takes one interrupt per transmission instead of one per byte. The
+ *  buffer must not change until UART_isTxBusy() returns false.
+ *
+ * If an SPI job holds the shared DMA channel, the TX ISR sends the buffer
+ *  instead, with the same completion semantics.
+ *
+ * @param txBuf the character buffer to be transmitted
+ * @param size the number of bytes to send
+ * @param callback called from the UART ISR once the last byte is on the
+ *  line, may be NULL
+ */
+void UART_dmaSend(uint8_t* txBuf, uint16_t size, void (*callback)(void)) {
+
+    // Block until prior transmission has completed
+    while (UART_SM.isTxBusy)
+        ;
+
+    if (0 == size)
+        return;
+
+    // Set up for start of transmission
+    UART_SM.isTxBusy = TRUE;
+    UART_SM.txCallback = callback;
+
+    if (!DMA_claim(DMA_CH_UART_TX, &UART_dmaTxDone)) {
+        UART_SM.txPtr = txBuf + 1;
+        UART_SM.txBytesRemaining = size - 1;
+
+        UCA0IFG &= ~(USCI_UART_UCTXIFG | UCTXCPTIFG);
+        UCA0IE |= UCTXIE; // Enable USCI_A0 TX interrupt
+        UCA0TXBUF = *txBuf; // Load in first byte
+        return;
+    }
+
+    UART_SM.isTxDma = TRUE;
+
+    DMA_init();
+
+    DMA1CTL &= ~(DMAEN);
+    DMA_setTrigger(DMA_CH_UART_TX, DMA_TRIG_UCA0TX);
+    __data16_write_addr((unsigned short) &DMA1SA, (unsigned long) (txBuf + 1));
+    __data16_write_addr((unsigned short) &DMA1DA, (unsigned long) &UCA0TXBUF);
+    DMA1SZ = size - 1;
+    DMA1CTL = DMADT_0 | DMASRCINCR_3 | DMADSTINCR_0 | DMASRCBYTE | DMADSTBYTE | DMAIE;
+
+    if (size > 1)
+        DMA1CTL |= DMAEN;
+
+    // The trigger is the rising edge of UCTXIFG, which is already high while
+    //  the USCI is idle. Load the first byte by hand; UCTXIFG rises again when
+    //  it moves on to the shift register.
+    UCA0IFG &= ~(UCTXCPTIFG);
+    UCA0TXBUF = *txBuf;
+
+    if (1 == size)
+        UART_dmaTxDone();
+}
+
+/**
+ * Sleep in LPM0 until the current transmission is done. Must not be called
+ *  from an ISR.
+ */
+void UART_waitForTx(void) {
+    __disable_interrupt();
+
+    while (UART_SM.isTxBusy) {
+        UART_SM.isSleeping = TRUE;
+        __bis_SR_register(LPM0_bits | GIE); // SMCLK keeps the USCI running
+        __disable_interrupt();
+    }
+    UART_SM.isSleeping = FALSE;
+
+    __enable_interrupt();
+}
+
 /**
  * Return true if UART TX module is in the middle of an operation, false if not.
  */
@@ -192,9 +398,56 @@ uint8_t UART_isTxBusy() {
     return UART_SM.isTxBusy;
 }
 
+/**
+ * Keep receiving into the RX buffer between receive requests, so no byte is
+ *  lost while the main loop is busy. Read them with UART_read().
+ */
+void UART_startListening(void) {
+    UART_SM.isListening = TRUE;
+    UCA0IE |= UCRXIE; // Enable USCI_A0 RX interrupt
+}
+
+/**
+ * Stop receiving between receive requests. Buffered bytes are kept.
+ */
+void UART_stopListening(void) {
+    UART_SM.isListening = FALSE;
+    if (!UART_SM.isRxBusy)
+        UCA0IE &= ~(UCRXIE); // Disable USCI_A0 RX interrupt
+}
+
+/**
+ * Take up to size buffered bytes. Never blocks. Don't mix with an open
+ *  receive request.
+ *
+ * @param rxBuf destination
+ * @param size maximum number of bytes to take
+ * @return the number of bytes copied
+ */
+uint16_t UART_read(uint8_t* rxBuf, uint16_t size) {
+    return RINGBUF_read(&UART_SM.rxRing, rxBuf, size);
+}
+
+/**
+ * Return the number of buffered bytes which UART_read() can take.
+ */
+uint16_t UART_rxAvailable() {
+    return RINGBUF_count(&UART_SM.rxRing);
+}
+
+/**
+ * Return the number of received bytes lost because the RX buffer was full.
+ */
+uint16_t UART_rxDropped() {
+    return UART_SM.rxDropped;
+}
+
 /**
  * Receive character buffer. Do not block.
  *
+ * Bytes which are already buffered (see UART_startListening()) are taken
+ *  first.
+ *
  * @param rxBuf the character buffer to be received to
  * @param size the number of bytes to receive
  */
@@ -204,13 +457,23 @@ void UART_asyncReceive(uint8_t* rxBuf, uint16_t size, uint8_t terminate) {
     while (UART_SM.isRxBusy)
         ;
 
+    UCA0IE &= ~(UCRXIE); // Hold the RX ISR off while the buffer is drained
+
     // Set up for start of reception
-    UART_SM.isRxBusy = TRUE;
     UART_SM.rxPtr = rxBuf;
     UART_SM.rxBytesRemaining = size;
     UART_SM.rxTermChar = terminate;
 
-    UCA0IFG &= ~(UCRXIFG); // Clear byte completion flag
+    if (UART_takeBuffered()) {
+        if (UART_SM.isListening)
+            UCA0IE |= UCRXIE;
+        return;
+    }
+
+    UART_SM.isRxBusy = TRUE;
+
+    if (!UART_SM.isListening)
+        UCA0IFG &= ~(UCRXIFG); // Clear byte completion flag
 
     UCA0IE |= UCRXIE; // Enable USCI_A0 RX interrupt
 
@@ -245,13 +508,23 @@ void UART_critReceive(uint8_t* rxBuf, uint16_t size, uint8_t terminate) {
     while (UART_SM.isRxBusy)
         ;
 
+    UCA0IE &= ~(UCRXIE); // No RX ISR while polling
+
     // Set up for start of reception
-    UART_SM.isRxBusy = TRUE;
     UART_SM.rxPtr = rxBuf;
     UART_SM.rxBytesRemaining = size;
     UART_SM.rxTermChar = terminate;
 
-    UCA0IFG &= ~(UCRXIFG); // Clear byte completion flag
+    if (UART_takeBuffered()) {
+        if (UART_SM.isListening)
+            UCA0IE |= UCRXIE;
+        return;
+    }
+
+    UART_SM.isRxBusy = TRUE;
+
+    if (!UART_SM.isListening)
+        UCA0IFG &= ~(UCRXIFG); // Clear byte completion flag
 
     while (UART_SM.rxBytesRemaining--) {
         while (!(UCA0IFG & UCRXIFG))
@@ -266,6 +539,132 @@ void UART_critReceive(uint8_t* rxBuf, uint16_t size, uint8_t terminate) {
     }
 
     UART_SM.isRxBusy = FALSE;
+
+    if (UART_SM.isListening)
+        UCA0IE |= UCRXIE;
+}
+
+/**
+ * Receive continuously into a circular buffer with DMA. Do not block.
+ *
+ * Takes over from the RX interrupt (see UART_startListening()) until
+ *  UART_dmaStopReceiving(). Read the data with UART_dmaRead().
+ *
+ * @note The DMA controller cannot tell when it laps the reader, so data is
+ *  lost silently if more than size bytes arrive between two reads. Pick size
+ *  above the longest expected burst.
+ *
+ * @param rxBuf circular buffer, owned by the UART until reception stops
+ * @param size size of rxBuf in bytes
+ * @param idleCallback called from the Timer_A2 ISR when the line goes idle
+ *  after a burst of data, may be NULL
+ * @return SUCCESS, or FAIL if the DMA channel is in use
+ */
+BOOL UART_dmaStartReceiving(uint8_t* rxBuf, uint16_t size,
+        void (*idleCallback)(void)) {
+
+    if (UART_SM.dmaRxSize)
+        UART_dmaStopReceiving();
+
+    if ((0 == size) || !DMA_claim(DMA_CH_UART_RX, 0))
+        return FAIL;
+
+    // Bytes go to the DMA channel, not to the ISR
+    UART_SM.isListening = FALSE;
+    UCA0IE &= ~(UCRXIE);
+
+    DMA_init();
+
+    DMA2CTL &= ~(DMAEN);
+    DMA_setTrigger(DMA_CH_UART_RX, DMA_TRIG_UCA0RX);
+    __data16_write_addr((unsigned short) &DMA2SA, (unsigned long) &UCA0RXBUF);
+    __data16_write_addr((unsigned short) &DMA2DA, (unsigned long) rxBuf);
+    DMA2SZ = size;
+
+    UART_SM.dmaRxBuf = rxBuf;
+    UART_SM.dmaRxSize = size;
+    UART_SM.dmaRxTail = 0;
+    UART_SM.dmaRxLastHead = 0;
+    UART_SM.isRxActive = FALSE;
+    UART_SM.isRxIdle = FALSE;
+    UART_SM.rxIdleCallback = idleCallback;
+
+    // The trigger is the rising edge of UCRXIFG, a byte which is already
+    //  waiting would block the channel.
+    UCA0IFG &= ~(UCRXIFG);
+
+    // Repeated single transfers, the destination wraps when DMA2SZ reloads
+    DMA2CTL = DMADT_4 | DMASRCINCR_0 | DMADSTINCR_3 | DMASRCBYTE | DMADSTBYTE | DMAEN;
+
+    Timer_initAlarm(&UART_SM.rxIdleAlarm, &UART_dmaIdleCheck, TIMER_ALARM_ISR);
+    Timer_startAlarm(&UART_SM.rxIdleAlarm, UART_RX_IDLE_TICKS, UART_RX_IDLE_TICKS);
+
+    return SUCCESS;
+}
+
+/**
+ * Stop DMA reception. Bytes which were not read yet are lost.
+ */
+void UART_dmaStopReceiving(void) {
+    if (0 == UART_SM.dmaRxSize)
+        return;
+
+    DMA_release(DMA_CH_UART_RX);
+    Timer_stopAlarm(&UART_SM.rxIdleAlarm);
+
+    UART_SM.dmaRxSize = 0;
+    UART_SM.isRxIdle = FALSE;
+}
+
+/**
+ * Return the number of bytes in the DMA receive buffer not read yet.
+ */
+uint16_t UART_dmaRxAvailable(void) {
+    uint16_t head;
+
+    if (0 == UART_SM.dmaRxSize)
+        return 0;
+
+    head = UART_dmaRxHead();
+
+    if (head >= UART_SM.dmaRxTail)
+        return head - UART_SM.dmaRxTail;
+
+    return UART_SM.dmaRxSize - UART_SM.dmaRxTail + head;
+}
+
+/**
+ * Take up to size bytes from the DMA receive buffer. Never blocks.
+ *
+ * @param rxBuf destination
+ * @param size maximum number of bytes to take
+ * @return the number of bytes copied
+ */
+uint16_t UART_dmaRead(uint8_t* rxBuf, uint16_t size) {
+    uint16_t n = UART_dmaRxAvailable();
+    uint16_t i;
+
+    if (n > size)
+        n = size;
+
+    for (i = 0; i < n; i++) {
+        rxBuf[i] = UART_SM.dmaRxBuf[UART_SM.dmaRxTail];
+        if (++UART_SM.dmaRxTail >= UART_SM.dmaRxSize)
+            UART_SM.dmaRxTail = 0;
+    }
+
+    return n;
+}
+
+/**
+ * Return true once after each burst of DMA received data when the line has
+ *  gone idle again, e.g. at the end of a message.
+ */
+uint8_t UART_dmaRxIdle(void) {
+    uint8_t idle = UART_SM.isRxIdle;
+
+    UART_SM.isRxIdle = FALSE;
+    return idle;
 }
 
 /**
@@ -290,38 +689,70 @@ uint8_t UART_isRxDone() {
  */
 #pragma vector=USCI_A0_VECTOR
 __interrupt void USCI_A0_ISR(void) {
-    BITTOG(PLED2OUT, PIN_LED2);
     uint8_t rec;
 
     switch (__even_in_range(UCA0IV, USCI_UART_UCTXCPTIFG)) {
     case USCI_NONE:
         break;
     case USCI_UART_UCRXIFG:
-        if (UART_SM.rxBytesRemaining--) {
-            rec = UCA0RXBUF; // Read next byte
-            *(UART_SM.rxPtr++) = rec; // Store byte
-        } else {
-            rec = ~UART_SM.rxTermChar;
+        rec = UCA0RXBUF; // Read next byte
+
+        if (!UART_SM.isRxBusy) {
+            // No request open, keep it for UART_read()
+            if (!RINGBUF_putByte(&UART_SM.rxRing, rec))
+                UART_SM.rxDropped++;
+            break;
         }
 
+        *(UART_SM.rxPtr++) = rec; // Store byte
+        UART_SM.rxBytesRemaining--;
+
         if ((0 == UART_SM.rxBytesRemaining) || (rec == UART_SM.rxTermChar)) {
-            UCA0IE &= ~(UCRXIE); // Disable USCI_A0 RX interrupt
+            if (!UART_SM.isListening)
+                UCA0IE &= ~(UCRXIE); // Disable USCI_A0 RX interrupt
             UART_SM.isRxBusy = FALSE;
         }
 
         break;
     case USCI_UART_UCTXIFG:
-        if (UART_SM.txBytesRemaining--) {
+        if (UART_SM.txBytesRemaining) {
+            UART_SM.txBytesRemaining--;
             UCA0TXBUF = *(UART_SM.txPtr++);
+        } else if (RINGBUF_getByte(&UART_SM.txRing, &rec)) {
+            UCA0TXBUF = rec;
         } else {
             UCA0IE &= ~(UCTXIE); // Disable USCI_A0 TX interrupt
-            UART_SM.isTxBusy = FALSE;
+
+            if (UART_SM.txCallback) {
+                // UART_dmaSend() without DMA, finish once the byte is out
+                UCA0IFG &= ~(UCTXCPTIFG);
+                UCA0IE |= UCTXCPTIE;
+            } else {
+                UART_SM.isTxBusy = FALSE;
+            }
         }
         break;
     case USCI_UART_UCSTTIFG:
         break;
     case USCI_UART_UCTXCPTIFG:
+        // End of a UART_dmaSend() transmission
+        UCA0IE &= ~(UCTXCPTIE);
+        UART_SM.isTxBusy = FALSE;
+
+        if (UART_SM.txCallback) {
+            void (*callback)(void) = UART_SM.txCallback;
+
+            UART_SM.txCallback = 0;
+            callback();
+        }
+
+        UART_startTx(); // Bytes written meanwhile wait in txRing
         break;
     }
+
+    if (UART_SM.isSleeping && !UART_SM.isTxBusy) {
+        UART_SM.isSleeping = FALSE;
+        __bic_SR_register_on_exit(LPM4_bits);
+    }
 }
 
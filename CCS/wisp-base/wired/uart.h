@@ -15,12 +15,27 @@ void UART_setClock(void);
 void UART_init(void);
 void UART_initCustom(uint32_t fsmclk, uint32_t baudrate);
 
+uint16_t UART_write(uint8_t* txBuf, uint16_t size);
 void UART_asyncSend(uint8_t* txBuf, uint16_t size);
 void UART_send(uint8_t* txBuf, uint16_t size);
 void UART_flowControlSend(uint8_t* txBuf, uint16_t size);
 void UART_critSend(uint8_t* txBuf, uint16_t size);
+void UART_dmaSend(uint8_t* txBuf, uint16_t size, void (*callback)(void));
+void UART_waitForTx(void);
 uint8_t UART_isTxBusy();
 
+void UART_startListening(void);
+void UART_stopListening(void);
+uint16_t UART_read(uint8_t* rxBuf, uint16_t size);
+uint16_t UART_rxAvailable();
+uint16_t UART_rxDropped();
+
+uint8_t UART_dmaStartReceiving(uint8_t* rxBuf, uint16_t size, void (*idleCallback)(void));
+void UART_dmaStopReceiving(void);
+uint16_t UART_dmaRxAvailable(void);
+uint16_t UART_dmaRead(uint8_t* rxBuf, uint16_t size);
+uint8_t UART_dmaRxIdle(void);
+
 void UART_asyncReceive(uint8_t* rxBuf, uint16_t size, uint8_t terminate);
 void UART_receive(uint8_t* rxBuf, uint16_t size, uint8_t terminate);
 void UART_critReceive(uint8_t* rxBuf, uint16_t size, uint8_t terminate);
@@ -14,15 +14,33 @@
 #include "globals.h" // Get these outta here (breaks encapsulation barrier)
 #include "wired/spi.h"
 #include "wired/uart.h"
+#include "wired/dma.h"
+#include "wired/frame.h"
 #include "Sensors/accel.h"
 #include "Sensors/adc.h"
+#include "Sensors/supply.h"
 #include "nvm/fram.h"
+#include "nvm/checkpoint.h"
+#include "nvm/kvstore.h"
+#include "nvm/datalog.h"
 #include "RFID/rfid.h"
+#include "RFID/link.h"
 #include "config/wispGuts.h"
 #include "Timing/timer.h"
 #include "rand/rand.h"
+#include "util/ringbuf.h"
+#include "tasks/task.h"
 
 void WISP_init(void);
+void WISP_hibernate(void);
+BOOL WISP_isWarmBoot(void);
+uint16_t WISP_resetReason(void);
+BOOL WISP_setHibernateRegion(void* ptr, uint16_t size);
+void WISP_deferInit(void(*fnPtr)(void));
+void WISP_saveEPC(void);
+void WISP_clearSavedEPC(void);
+uint32_t WISP_getBootCycles(void);
+BOOL WISP_waitForMotion(void);
 void WISP_getDataBuffers(WISP_dataStructInterface_t* clientStruct);
 
 #endif /* WISP_BASE_H_ */
@@ -0,0 +1,152 @@
+/**
+ * @file frame_codec.cpp
+ *
+ * Host side of the WISP UART framing, see frame_codec.hpp
+ */
+
+#include "frame_codec.hpp"
+
+#include <stdexcept>
+
+namespace wisp {
+
+namespace {
+
+const std::size_t kHeaderSize = 3;  // COBS code + len + seq
+const std::size_t kCrcSize = 2;
+
+} // namespace
+
+uint16_t crc16(const uint8_t* data, std::size_t size) {
+    uint16_t crc = 0xFFFF;
+
+    for (std::size_t i = 0; i < size; i++) {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021)
+                                 : static_cast<uint16_t>(crc << 1);
+    }
+
+    return static_cast<uint16_t>(~crc);
+}
+
+std::vector<uint8_t> encodeFrame(uint8_t seq, const uint8_t* payload,
+        std::size_t size, std::size_t maxPayload) {
+    if (size > maxPayload || size > kFrameMaxPayload)
+        throw std::length_error("frame payload too long");
+
+    // Same layout as FRAME_encode(): code byte, then the raw frame
+    std::vector<uint8_t> out(kHeaderSize + size + kCrcSize + 1);
+    out[1] = static_cast<uint8_t>(size);
+    out[2] = seq;
+    for (std::size_t i = 0; i < size; i++)
+        out[kHeaderSize + i] = payload[i];
+
+    uint16_t crc = crc16(&out[1], 2 + size);
+    out[kHeaderSize + size] = static_cast<uint8_t>(crc >> 8);
+    out[kHeaderSize + size + 1] = static_cast<uint8_t>(crc);
+
+    const std::size_t n = 2 + size + kCrcSize;
+    std::size_t code = 0;
+    for (std::size_t i = 1; i <= n; i++) {
+        if (out[i] == 0) {
+            out[code] = static_cast<uint8_t>(i - code);
+            code = i;
+        }
+    }
+    out[code] = static_cast<uint8_t>(n + 1 - code);
+    out[n + 1] = kFrameDelimiter;
+
+    return out;
+}
+
+bool decodeFrame(const uint8_t* data, std::size_t size, Frame& out) {
+    if (size < kHeaderSize + kCrcSize || size > kHeaderSize + kFrameMaxPayload + kCrcSize)
+        return false;
+
+    std::vector<uint8_t> buf(data, data + size);
+
+    std::size_t pos = 0;
+    uint8_t code = buf[0];
+    for (;;) {
+        if (code == 0)
+            return false;
+
+        std::size_t next = pos + code;
+        if (next > size)
+            return false;
+        if (next == size)
+            break;
+
+        code = buf[next];
+        buf[next] = 0;
+        pos = next;
+    }
+
+    const std::size_t len = buf[1];
+    if (len != size - (kHeaderSize + kCrcSize))
+        return false;
+
+    uint16_t crc = static_cast<uint16_t>((buf[size - 2] << 8) | buf[size - 1]);
+    if (crc != crc16(&buf[1], 2 + len))
+        return false;
+
+    out.seq = buf[2];
+    out.payload.assign(buf.begin() + kHeaderSize, buf.begin() + kHeaderSize + len);
+    return true;
+}
+
+FrameDecoder::FrameDecoder(std::size_t maxPayload)
+    : maxEncoded_(kHeaderSize + (maxPayload < kFrameMaxPayload ? maxPayload : kFrameMaxPayload) + kCrcSize) {
+    buf_.reserve(maxEncoded_);
+    reset();
+}
+
+void FrameDecoder::reset() {
+    buf_.clear();
+    isSynced_ = false;
+    isOverflow_ = false;
+    hasSeq_ = false;
+    expectedSeq_ = 0;
+    errors_ = 0;
+    lost_ = 0;
+}
+
+bool FrameDecoder::push(uint8_t byte) {
+    if (byte != kFrameDelimiter) {
+        if (buf_.size() < maxEncoded_)
+            buf_.push_back(byte);
+        else
+            isOverflow_ = true;
+        return false;
+    }
+
+    const bool wasOverflow = isOverflow_;
+    isOverflow_ = false;
+
+    if (!isSynced_) {
+        isSynced_ = true;   // Bytes before the first delimiter may be a partial frame
+        buf_.clear();
+        return false;
+    }
+
+    if (buf_.empty())
+        return false;       // Back-to-back delimiters are allowed as padding
+
+    bool ok = !wasOverflow && decodeFrame(buf_.data(), buf_.size(), frame_);
+    buf_.clear();
+
+    if (!ok) {
+        errors_++;
+        return false;
+    }
+
+    if (hasSeq_)
+        lost_ += static_cast<uint8_t>(frame_.seq - expectedSeq_);
+    hasSeq_ = true;
+    expectedSeq_ = static_cast<uint8_t>(frame_.seq + 1);
+
+    return true;
+}
+
+} // namespace wisp
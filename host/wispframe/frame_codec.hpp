@@ -0,0 +1,92 @@
+/**
+ * @file frame_codec.hpp
+ *
+ * Host side of the WISP UART framing (see CCS/wisp-base/wired/frame.h).
+ *
+ * Wire format, one frame:
+ *
+ *   COBS( len | seq | payload[len] | crc16 ) 0x00
+ *
+ * crc16 is the Gen2 CRC-16 the WISP CRC module computes with crc16_ccitt()
+ *  (poly 0x1021, preset 0xFFFF, inverted), over len, seq and the payload,
+ *  sent MSB first.
+ */
+
+#ifndef WISPFRAME_FRAME_CODEC_HPP_
+#define WISPFRAME_FRAME_CODEC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wisp {
+
+const std::size_t kFrameMaxPayload = 249;   // One COBS code byte per frame
+const uint8_t kFrameDelimiter = 0x00;
+
+/**
+ * CRC-16 as computed by crc16_ccitt(CRC_NO_PRELOAD, ...) on the WISP
+ */
+uint16_t crc16(const uint8_t* data, std::size_t size);
+
+/**
+ * A decoded frame
+ */
+struct Frame {
+    uint8_t seq;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * Encode one frame, including the trailing delimiter.
+ *
+ * @throws std::length_error if the payload is longer than maxPayload
+ */
+std::vector<uint8_t> encodeFrame(uint8_t seq, const uint8_t* payload,
+        std::size_t size, std::size_t maxPayload = kFrameMaxPayload);
+
+/**
+ * Decode the bytes of one frame, without the delimiter.
+ *
+ * @return true and the frame in out if it is well-formed and the CRC matches
+ */
+bool decodeFrame(const uint8_t* data, std::size_t size, Frame& out);
+
+/**
+ * Streaming decoder, with the same resynchronisation rules as FRAME_push()
+ *  on the WISP: everything up to the first delimiter is dropped, and a bad
+ *  frame costs only itself.
+ */
+class FrameDecoder {
+public:
+    explicit FrameDecoder(std::size_t maxPayload = kFrameMaxPayload);
+
+    /**
+     * Feed one received byte.
+     *
+     * @return true when the byte completed a good frame, see frame()
+     */
+    bool push(uint8_t byte);
+
+    const Frame& frame() const { return frame_; }
+
+    unsigned long errors() const { return errors_; }   // Bad COBS, length or CRC
+    unsigned long lost() const { return lost_; }       // Gaps in the sequence numbers
+
+    void reset();
+
+private:
+    std::size_t maxEncoded_;
+    std::vector<uint8_t> buf_;
+    bool isSynced_;
+    bool isOverflow_;
+    bool hasSeq_;
+    uint8_t expectedSeq_;
+    Frame frame_;
+    unsigned long errors_;
+    unsigned long lost_;
+};
+
+} // namespace wisp
+
+#endif /* WISPFRAME_FRAME_CODEC_HPP_ */
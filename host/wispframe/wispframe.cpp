@@ -0,0 +1,246 @@
+/**
+ * @file wispframe.cpp
+ *
+ * Talk to a WISP over a framed UART link (see frame_codec.hpp).
+ *
+ *   wispframe DEVICE [BAUD]            print every frame received on DEVICE
+ *   wispframe DEVICE BAUD -s TEXT      send TEXT as one frame, then print
+ *   wispframe --loopback [FRAMES]      check the codec over a pty pair,
+ *                                      with corrupted and dropped bytes
+ */
+
+#include "frame_codec.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+speed_t toSpeed(long baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return 0;
+    }
+}
+
+bool makeRaw(int fd, speed_t speed) {
+    termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+        return false;
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (speed) {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+bool writeAll(int fd, const uint8_t* data, std::size_t size) {
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+void printFrame(const wisp::Frame& frame) {
+    std::printf("seq %3u len %3zu:", frame.seq, frame.payload.size());
+    for (uint8_t b : frame.payload)
+        std::printf(" %02x", b);
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+int dump(const char* device, long baud, const char* text) {
+    speed_t speed = toSpeed(baud);
+    if (!speed) {
+        std::fprintf(stderr, "unsupported baud rate %ld\n", baud);
+        return 2;
+    }
+
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    if (fd < 0 || !makeRaw(fd, speed)) {
+        std::fprintf(stderr, "%s: %s\n", device, std::strerror(errno));
+        return 1;
+    }
+
+    if (text) {
+        std::vector<uint8_t> wire = wisp::encodeFrame(0,
+                reinterpret_cast<const uint8_t*>(text), std::strlen(text));
+        // A leading delimiter resynchronises the WISP if it saw line noise
+        uint8_t delimiter = wisp::kFrameDelimiter;
+        if (!writeAll(fd, &delimiter, 1) || !writeAll(fd, wire.data(), wire.size())) {
+            std::fprintf(stderr, "%s: %s\n", device, std::strerror(errno));
+            return 1;
+        }
+    }
+
+    wisp::FrameDecoder decoder;
+    uint8_t buf[256];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        for (ssize_t i = 0; i < n; i++) {
+            if (decoder.push(buf[i]))
+                printFrame(decoder.frame());
+        }
+    }
+
+    std::fprintf(stderr, "%lu bad, %lu lost\n", decoder.errors(), decoder.lost());
+    close(fd);
+    return 0;
+}
+
+/**
+ * Send frames through a pty pair and check what comes out. Every 7th frame
+ *  gets one byte flipped and every 11th loses one byte; each of those must
+ *  cost exactly that frame.
+ */
+int loopback(unsigned long frames) {
+    int master, slave;
+
+    if (openpty(&master, &slave, 0, 0, 0) != 0 || !makeRaw(slave, 0) || !makeRaw(master, 0)) {
+        std::fprintf(stderr, "openpty: %s\n", std::strerror(errno));
+        return 1;
+    }
+
+    unsigned long expectGood = 0;
+    unsigned long expectBad = 0;
+    unsigned long expectLost = 0; // Bad frames followed by a good one
+    unsigned long pendingBad = 0;
+    unsigned long good = 0;
+    unsigned long mismatches = 0;
+    std::vector<std::vector<uint8_t> > sent;
+    wisp::FrameDecoder decoder;
+
+    std::srand(1);
+    for (unsigned long f = 0; f < frames; f++) {
+        std::vector<uint8_t> payload(static_cast<std::size_t>(std::rand()) % (wisp::kFrameMaxPayload + 1));
+        for (uint8_t& b : payload)
+            b = static_cast<uint8_t>((std::rand() & 1) ? 0 : std::rand()); // plenty of zeros for COBS
+        sent.push_back(payload);
+
+        std::vector<uint8_t> wire = wisp::encodeFrame(static_cast<uint8_t>(f), payload.data(), payload.size());
+        if (f == 0)
+            wire.insert(wire.begin(), wisp::kFrameDelimiter); // decoder syncs on the first delimiter
+
+        // Damage one byte between the delimiters, without making a new delimiter
+        std::size_t first = (f == 0) ? 1 : 0;
+        std::size_t at = first + static_cast<std::size_t>(std::rand()) % (wire.size() - 1 - first);
+        if (f % 7 == 3) {
+            wire[at] ^= (wire[at] == 0x5A) ? 0xA5 : 0x5A;
+            expectBad++;
+            pendingBad++;
+        } else if (f % 11 == 5) {
+            wire.erase(wire.begin() + static_cast<long>(at));
+            expectBad++;
+            pendingBad++;
+        } else {
+            expectGood++;
+            expectLost += pendingBad;
+            pendingBad = 0;
+        }
+
+        if (!writeAll(master, wire.data(), wire.size())) {
+            std::fprintf(stderr, "write: %s\n", std::strerror(errno));
+            return 1;
+        }
+
+        // Read back what is there; the pty buffer is far larger than one frame
+        std::size_t got = 0;
+        uint8_t buf[512];
+        while (got < wire.size()) {
+            ssize_t n = read(slave, buf, sizeof(buf));
+            if (n <= 0) {
+                std::fprintf(stderr, "read: %s\n", std::strerror(errno));
+                return 1;
+            }
+            got += static_cast<std::size_t>(n);
+            for (ssize_t i = 0; i < n; i++) {
+                if (decoder.push(buf[i])) {
+                    good++;
+                    const wisp::Frame& fr = decoder.frame();
+                    if (fr.seq != static_cast<uint8_t>(f) || fr.payload != sent[f])
+                        mismatches++;
+                }
+            }
+        }
+    }
+
+    close(master);
+    close(slave);
+
+    std::printf("%lu frames: %lu good (expected %lu), %lu bad (expected %lu), "
+            "%lu lost (expected %lu), %lu mismatched\n",
+            frames, good, expectGood, decoder.errors(), expectBad,
+            decoder.lost(), expectLost, mismatches);
+
+    bool ok = good == expectGood && decoder.errors() == expectBad
+            && decoder.lost() == expectLost && mismatches == 0;
+    return ok ? 0 : 1;
+}
+
+void usage() {
+    std::fprintf(stderr,
+            "usage: wispframe DEVICE [BAUD] [-s TEXT]\n"
+            "       wispframe --loopback [FRAMES]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::strcmp(argv[1], "--loopback") == 0)
+        return loopback(argc >= 3 ? std::strtoul(argv[2], 0, 0) : 1000);
+
+    if (argc < 2 || argv[1][0] == '-') {
+        usage();
+        return 2;
+    }
+
+    long baud = 115200;
+    const char* text = 0;
+    for (int i = 2; i < argc; i++) {
+        if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            text = argv[++i];
+        else if (argv[i][0] != '-')
+            baud = std::strtol(argv[i], 0, 10);
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    return dump(argv[1], baud, text);
+}